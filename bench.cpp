@@ -0,0 +1,1230 @@
+// Microbenchmarks for the trading simulator.
+// Build: g++ -std=c++17 -O2 -pthread -o bench bench.cpp
+// Usage: bench [--format table|csv|json] [--out <file>] [--filter <substring>] [--quick]
+//
+// Every case is swept over a range of sizes and reported as ns per operation
+// (memory cases report bytes or allocations per item instead), so results from
+// two releases can be diffed directly. Cases run inside a
+// scratch directory so the simulator's data files are untouched.
+
+#define CRYPTO_SIM_NO_MAIN
+#include "main.cpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+
+namespace fs = std::filesystem;
+
+// Heap accounting for the memory cases. Each block carries its size in a
+// small header so frees can be subtracted from the live total.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+std::atomic<std::size_t> heapAllocs{0};
+std::atomic<std::size_t> heapLiveBytes{0};
+
+void* operator new(std::size_t n) {
+    void* p = std::malloc(n + 16);
+    if (!p) throw std::bad_alloc();
+    *static_cast<std::size_t*>(p) = n;
+    heapAllocs.fetch_add(1, std::memory_order_relaxed);
+    heapLiveBytes.fetch_add(n, std::memory_order_relaxed);
+    return static_cast<char*>(p) + 16;
+}
+
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    char* block = static_cast<char*>(p) - 16;
+    heapLiveBytes.fetch_sub(*reinterpret_cast<std::size_t*>(block), std::memory_order_relaxed);
+    std::free(block);
+}
+
+void* operator new[](std::size_t n) { return operator new(n); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { operator delete(p); }
+#pragma GCC diagnostic pop
+
+// Heap counters captured before a build step; `since` gives the delta.
+struct HeapMark {
+    std::size_t allocs = heapAllocs.load();
+    std::size_t bytes = heapLiveBytes.load();
+
+    double allocsSince(std::size_t items) const { return double(heapAllocs.load() - allocs) / items; }
+    double bytesSince(std::size_t items) const { return double(heapLiveBytes.load() - bytes) / items; }
+};
+
+using BenchClock = std::chrono::steady_clock;
+
+// Results of timed loops land here so the optimiser cannot drop them.
+volatile std::uint64_t benchSink = 0;
+
+// Silences the simulator's console narration while a case is timed.
+struct QuietCout {
+    NullBuffer discard;
+    std::streambuf* original;
+    QuietCout() : original(std::cout.rdbuf(&discard)) {}
+    ~QuietCout() { std::cout.rdbuf(original); }
+};
+
+// Accumulates time across resume/pause pairs so per-op setup can be excluded.
+struct Stopwatch {
+    BenchClock::time_point started;
+    double elapsedNs = 0;
+
+    void resume() { started = BenchClock::now(); }
+    void pause() { elapsedNs += std::chrono::duration<double, std::nano>(BenchClock::now() - started).count(); }
+};
+
+struct BenchResult {
+    std::string name;
+    std::string param;
+    std::size_t size;
+    std::size_t ops;
+    double value;
+    std::string unit;
+};
+
+class BenchSuite {
+private:
+    std::vector<BenchResult> results;
+    std::string filter;
+    bool quick;
+
+public:
+    BenchSuite(const std::string& filter, bool quick) : filter(filter), quick(quick) {}
+
+    bool enabled(const std::string& name) const { return filter.empty() || name.find(filter) != std::string::npos; }
+
+    // Quick runs drop the largest size of every sweep.
+    std::vector<std::size_t> sizes(std::initializer_list<std::size_t> full) const {
+        std::vector<std::size_t> out(full);
+        if (quick && out.size() > 1) out.pop_back();
+        return out;
+    }
+
+    void record(const std::string& name, const std::string& param, std::size_t size, std::size_t ops, double elapsedNs) {
+        recordValue(name, param, size, ops, elapsedNs / ops, "ns/op");
+    }
+
+    void recordValue(const std::string& name, const std::string& param, std::size_t size, std::size_t ops,
+                     double value, const std::string& unit) {
+        results.push_back(BenchResult{name, param, size, ops, value, unit});
+        std::cerr << "  " << std::left << std::setw(32) << name << std::right << std::setw(10) << size
+                  << std::setw(14) << std::fixed << std::setprecision(1) << value << " " << unit << "\n";
+    }
+
+    void writeTable(std::ostream& os) const;
+    void writeCsv(std::ostream& os) const;
+    void writeJson(std::ostream& os) const;
+};
+
+void BenchSuite::writeTable(std::ostream& os) const {
+    os << std::left << std::setw(32) << "case" << std::setw(12) << "param" << std::right
+       << std::setw(10) << "size" << std::setw(12) << "ops" << std::setw(14) << "value" << "  unit\n";
+    for (const auto& r : results) {
+        os << std::left << std::setw(32) << r.name << std::setw(12) << r.param << std::right
+           << std::setw(10) << r.size << std::setw(12) << r.ops
+           << std::setw(14) << std::fixed << std::setprecision(1) << r.value << "  " << r.unit << "\n";
+    }
+}
+
+void BenchSuite::writeCsv(std::ostream& os) const {
+    os << "case,param,size,ops,value,unit\n";
+    for (const auto& r : results) {
+        os << r.name << "," << r.param << "," << r.size << "," << r.ops << ","
+           << std::fixed << std::setprecision(1) << r.value << "," << r.unit << "\n";
+    }
+}
+
+void BenchSuite::writeJson(std::ostream& os) const {
+    os << "{\n  \"suite\": \"crypto_sim\",\n  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        os << "    {\"case\": \"" << r.name << "\", \"param\": \"" << r.param << "\", \"size\": " << r.size
+           << ", \"ops\": " << r.ops << ", \"value\": " << std::fixed << std::setprecision(1) << r.value
+           << ", \"unit\": \"" << r.unit << "\"}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+// Registers `count` listings named S0..S<count-1>.
+std::vector<SymbolId> listSymbols(Exchange& ex, std::size_t count) {
+    std::vector<SymbolId> ids;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::string symbol = "S" + std::to_string(i);
+        ex.add_crypto_listing(Crypto_currency("Coin" + std::to_string(i), symbol, Fixed::fromInt(1 + i % 1000)));
+        ids.push_back(ex.find(symbol)->getId());
+    }
+    return ids;
+}
+
+// Writes `resting` buy orders that sit below every seeded price, spread over
+// BTC, ETH and SOL.
+void writeOrderFile(std::size_t resting) {
+    const char* symbols[] = {"BTC", "ETH", "SOL"};
+    fs::remove("limit_orders.journal");
+    std::ofstream file("limit_orders.txt");
+    for (std::size_t i = 0; i < resting; ++i) {
+        file << (i + 1) << " user" << (i % 1000) << " " << symbols[i % 3] << " 1 " << (10 + i % 100) << " 1\n";
+    }
+}
+
+// Cost on the trading thread of reporting one fill: the async ring versus
+// formatting the line inline, which is what every fill used to pay.
+void benchEvents(BenchSuite& suite) {
+    Exchange ex;
+    seedExchange(ex);
+    User user("bench");
+    TradeEvent event{0, Fixed::fromInt(1).getRaw(), Fixed::fromInt(60000).getRaw(), Fixed::fromInt(60000).getRaw(), 0,
+                     user.getId(), ex.find("BTC")->getId(), TradeEvent::Bought, true, {}};
+    const std::size_t ops = 1000000;
+    if (suite.enabled("events.record")) {
+        Stopwatch sw;
+        sw.resume();
+        for (std::size_t i = 0; i < ops; ++i) EventLog::instance().record(event);
+        sw.pause();
+        EventLog::instance().flush();
+        suite.record("events.record", "", 1, ops, sw.elapsedNs);
+    }
+    if (suite.enabled("events.format_inline")) {
+        std::size_t sink = 0;
+        Stopwatch sw;
+        sw.resume();
+        for (std::size_t i = 0; i < ops; ++i) sink += EventLog::format(event).size();
+        sw.pause();
+        benchSink = benchSink + sink;
+        suite.record("events.format_inline", "", 1, ops, sw.elapsedNs);
+    }
+}
+
+void benchExchange(BenchSuite& suite) {
+    for (std::size_t listings : suite.sizes({10, 100, 1000, 10000, 100000})) {
+        Exchange ex;
+        std::vector<SymbolId> ids = listSymbols(ex, listings);
+        std::vector<std::string> names;
+        for (SymbolId id : ids) names.push_back(symbolName(id));
+
+        const std::size_t ops = 1000000;
+        std::uint64_t sink = 0;
+        if (suite.enabled("exchange.find")) {
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) sink += ex.find(names[(i * 7919) % listings])->getPrice().getRaw();
+            sw.pause();
+            suite.record("exchange.find", "listings", listings, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("exchange.price_of")) {
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) sink += ex.priceOf(ids[(i * 7919) % listings]).getRaw();
+            sw.pause();
+            suite.record("exchange.price_of", "listings", listings, ops, sw.elapsedNs);
+        }
+        benchSink = benchSink + sink;
+    }
+}
+
+void benchWallet(BenchSuite& suite) {
+    const Fixed lot = Crypto_currency::DEFAULT_LOT;
+    for (std::size_t holdings : suite.sizes({1, 10, 100, 1000, 10000})) {
+        Exchange ex;
+        std::vector<SymbolId> ids = listSymbols(ex, holdings);
+        Wallet wallet(Fixed::fromInt(1000000));
+        for (SymbolId id : ids) wallet.addQty(id, Fixed::fromInt(1));
+
+        const std::size_t ops = 1000000;
+        if (suite.enabled("wallet.add_qty")) {
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) wallet.addQty(ids[(i * 7919) % holdings], lot);
+            sw.pause();
+            suite.record("wallet.add_qty", "holdings", holdings, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("wallet.remove_qty")) {
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) wallet.removeQty(ids[(i * 7919) % holdings], lot);
+            sw.pause();
+            suite.record("wallet.remove_qty", "holdings", holdings, ops, sw.elapsedNs);
+        }
+    }
+}
+
+void benchTrades(BenchSuite& suite) {
+    if (suite.enabled("trade.buy_execute")) {
+        // $240B of BTC does not fit in Fixed; the buy and a second $60B deposit must both be refused.
+        Exchange ex;
+        seedExchange(ex);
+        User whale("whale", Fixed::fromInt(60000000000));
+        const Wallet before = whale.getWallet();
+        QuietCout quiet;
+        if (BuyTrade(ex.find("BTC")->getId(), Fixed::fromInt(4000000)).execute(whale, ex) ||
+            whale.getWallet().deposit(Fixed::fromInt(60000000000)) || whale.getWallet() != before) {
+            std::cerr << "trade.buy_execute: an out-of-range trade or deposit was settled\n";
+            std::exit(1);
+        }
+    }
+    for (std::size_t holdings : suite.sizes({1, 100, 10000})) {
+        Exchange ex;
+        seedExchange(ex);
+        listSymbols(ex, holdings);
+        User user("bench", Fixed::fromInt(1000000000));
+        for (const auto& listing : ex.getListings()) user.getWallet().addQty(listing.getId(), Fixed::fromInt(1));
+        const SymbolId btc = ex.find("BTC")->getId();
+
+        const std::size_t ops = 200000;
+        QuietCout quiet;
+        if (suite.enabled("trade.buy_execute")) {
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) BuyTrade(btc, Crypto_currency::DEFAULT_LOT).execute(user, ex);
+            sw.pause();
+            suite.record("trade.buy_execute", "holdings", holdings, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("trade.sell_execute")) {
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) SellTrade(btc, Crypto_currency::DEFAULT_LOT).execute(user, ex);
+            sw.pause();
+            suite.record("trade.sell_execute", "holdings", holdings, ops, sw.elapsedNs);
+        }
+    }
+}
+
+// A rebalance of `legs` symbols: sell one lot of each, then buy it back. The
+// batch prices every leg from one snapshot and validates before applying;
+// sequential runs the same legs as separate trades. Both report ns per leg.
+void benchBaskets(BenchSuite& suite) {
+    for (std::size_t legs : suite.sizes({1, 8, 64, 512})) {
+        Exchange ex;
+        std::vector<SymbolId> ids = listSymbols(ex, legs);
+        User user("bench", Fixed::fromInt(1000000000));
+        for (SymbolId id : ids) user.getWallet().addQty(id, Fixed::fromInt(1));
+
+        const std::size_t rounds = 200000 / legs;
+        QuietCout quiet;
+        if (suite.enabled("trade.basket")) {
+            TradeBatch batch;
+            for (SymbolId id : ids) batch.add(id, Crypto_currency::DEFAULT_LOT, false);
+            for (SymbolId id : ids) batch.add(id, Crypto_currency::DEFAULT_LOT, true);
+            std::string error;
+            std::size_t filled = 0;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < rounds; ++i) filled += batch.execute(user, ex, error);
+            sw.pause();
+            benchSink = benchSink + filled;
+            suite.record("trade.basket", "legs", legs, rounds * legs * 2, sw.elapsedNs);
+        }
+        if (suite.enabled("trade.sequential")) {
+            std::size_t filled = 0;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < rounds; ++i) {
+                for (SymbolId id : ids) filled += SellTrade(id, Crypto_currency::DEFAULT_LOT).execute(user, ex);
+                for (SymbolId id : ids) filled += BuyTrade(id, Crypto_currency::DEFAULT_LOT).execute(user, ex);
+            }
+            sw.pause();
+            benchSink = benchSink + filled;
+            suite.record("trade.sequential", "legs", legs, rounds * legs * 2, sw.elapsedNs);
+        }
+    }
+}
+
+void benchLimitOrders(BenchSuite& suite) {
+    const std::size_t triggered = 16;
+    for (std::size_t resting : suite.sizes({1000, 10000, 100000, 1000000})) {
+        writeOrderFile(resting);
+        Exchange ex;
+        seedExchange(ex);
+        AuthManager auth;
+        LimitOrderManager manager;
+        const SymbolId btc = ex.find("BTC")->getId();
+        QuietCout quiet;
+
+        if (suite.enabled("orders.trigger_book")) {
+            const std::size_t ops = 100000;
+            std::size_t sink = 0;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) sink += manager.triggeredOrders(btc, ex.priceOf(btc)).size();
+            sw.pause();
+            benchSink = benchSink + sink;
+            suite.record("orders.trigger_book", "resting", resting, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("orders.trigger_scan_legacy")) {
+            // The pre-index layout: every order re-evaluated on every tick.
+            struct FlatOrder { SymbolId symbol; Fixed desiredPrice; bool isBuyOrder; };
+            std::vector<FlatOrder> flat;
+            const char* symbols[] = {"BTC", "ETH", "SOL"};
+            for (std::size_t i = 0; i < resting; ++i) {
+                flat.push_back(FlatOrder{ex.find(symbols[i % 3])->getId(), Fixed::fromInt(10 + i % 100), true});
+            }
+            const std::size_t ops = resting >= 100000 ? 5 : 100;
+            std::size_t sink = 0;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) {
+                for (const auto& order : flat) {
+                    Fixed currentPrice = ex.priceOf(order.symbol);
+                    if ((order.isBuyOrder && currentPrice <= order.desiredPrice) ||
+                        (!order.isBuyOrder && currentPrice >= order.desiredPrice)) {
+                        ++sink;
+                    }
+                }
+            }
+            sw.pause();
+            benchSink = benchSink + sink;
+            suite.record("orders.trigger_scan_legacy", "resting", resting, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("orders.add_order")) {
+            const std::size_t ops = 2000;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) {
+                manager.addOrder("bench", btc, Fixed::fromInt(1), Fixed::fromInt(10 + i % 100), true);
+            }
+            sw.pause();
+            suite.record("orders.add_order", "resting", resting, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("orders.check_all")) {
+            // Per tick: `triggered` BTC buys fire and settle; they are re-placed untimed.
+            const std::size_t ticks = 50;
+            Stopwatch sw;
+            for (std::size_t t = 0; t < ticks; ++t) {
+                for (std::size_t i = 0; i < triggered; ++i) {
+                    manager.addOrder("user" + std::to_string(i), btc, Crypto_currency::DEFAULT_LOT, Fixed::fromInt(70000), true);
+                }
+                sw.resume();
+                manager.checkAndExecuteAllOrders(ex, auth);
+                sw.pause();
+            }
+            suite.record("orders.check_all", "resting", resting, ticks, sw.elapsedNs);
+        }
+    }
+}
+
+// Resting-order storage: the previous layout (an ordered map of records that
+// own the username string) against the slab pool, each with the trigger index
+// the manager keeps beside it. Reports heap bytes and allocations per order,
+// plus the cost of one fill-and-replace cycle.
+void benchOrderStorage(BenchSuite& suite) {
+    struct LegacyOrder {
+        int orderId;
+        std::string username;
+        SymbolId symbol;
+        Fixed units;
+        Fixed desiredPrice;
+        bool isBuyOrder;
+    };
+    using TriggerIndex = std::multimap<Fixed, int, std::greater<Fixed>>;
+
+    for (std::size_t resting : suite.sizes({1000, 100000, 1000000})) {
+        auto priceOf = [](std::size_t i) { return Fixed::fromInt(10 + i % 100); };
+        auto ownerOf = [](std::size_t i) { return "user" + std::to_string(i % 100000); };
+        const std::size_t ops = 100000;
+
+        if (suite.enabled("orders.layout_legacy")) {
+            HeapMark mark;
+            std::map<int, LegacyOrder> orders;
+            TriggerIndex index;
+            for (std::size_t i = 0; i < resting; ++i) {
+                int id = int(i) + 1;
+                orders.emplace(id, LegacyOrder{id, ownerOf(i), 0, Fixed::fromInt(1), priceOf(i), true});
+                index.emplace(priceOf(i), id);
+            }
+            suite.recordValue("orders.layout_legacy.bytes", "resting", resting, resting, mark.bytesSince(resting), "B/order");
+            suite.recordValue("orders.layout_legacy.allocs", "resting", resting, resting, mark.allocsSince(resting), "allocs/order");
+
+            int nextId = int(resting) + 1;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) {
+                auto it = orders.begin();
+                auto range = index.equal_range(it->second.desiredPrice);
+                for (auto hit = range.first; hit != range.second; ++hit) {
+                    if (hit->second == it->first) { index.erase(hit); break; }
+                }
+                orders.erase(it);
+                int id = nextId++;
+                orders.emplace_hint(orders.end(), id, LegacyOrder{id, ownerOf(i), 0, Fixed::fromInt(1), priceOf(i), true});
+                index.emplace(priceOf(i), id);
+            }
+            sw.pause();
+            suite.record("orders.layout_legacy.churn", "resting", resting, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("orders.layout_pool")) {
+            std::vector<UserId> owners;
+            for (std::size_t i = 0; i < std::min<std::size_t>(resting, 100000); ++i) {
+                owners.push_back(UserRegistry::instance().intern(ownerOf(i)));
+            }
+            HeapMark mark;
+            OrderPool orders;
+            TriggerBook index;
+            for (std::size_t i = 0; i < resting; ++i) {
+                std::int64_t id = std::int64_t(i) + 1;
+                index.add(orders, orders.insert(LimitOrder(id, owners[i % owners.size()], 0, Fixed::fromInt(1), priceOf(i), true)));
+            }
+            suite.recordValue("orders.layout_pool.bytes", "resting", resting, resting, mark.bytesSince(resting), "B/order");
+            suite.recordValue("orders.layout_pool.allocs", "resting", resting, resting, mark.allocsSince(resting), "allocs/order");
+
+            std::int64_t nextId = std::int64_t(resting) + 1;
+            std::int64_t oldest = 1;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) {
+                OrderHandle handle = orders.find(oldest++);
+                index.remove(orders, handle);
+                orders.erase(handle);
+                std::int64_t id = nextId++;
+                index.add(orders, orders.insert(LimitOrder(id, owners[i % owners.size()], 0, Fixed::fromInt(1), priceOf(i), true)));
+            }
+            sw.pause();
+            suite.record("orders.layout_pool.churn", "resting", resting, ops, sw.elapsedNs);
+        }
+    }
+}
+
+void benchPersistence(BenchSuite& suite) {
+    AuthManager auth;
+    for (std::size_t holdings : suite.sizes({1, 10, 100, 1000})) {
+        Exchange ex;
+        std::vector<SymbolId> ids = listSymbols(ex, holdings);
+        User user("persist", Fixed::fromInt(12345));
+        for (SymbolId id : ids) user.getWallet().addQty(id, Fixed::fromRaw(123456789));
+
+        const std::size_t ops = 2000;
+        if (suite.enabled("auth.save_user_data")) {
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) auth.saveUserData(user);
+            sw.pause();
+            suite.record("auth.save_user_data", "holdings", holdings, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("auth.load_user_data")) {
+            auth.saveUserData(user);
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) auth.releaseUser(auth.loadUserData("persist"));
+            sw.pause();
+            suite.record("auth.load_user_data", "holdings", holdings, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("auth.load_user_data.uncached")) {
+            // A zero budget evicts on every release, so each load reads wallets.db.
+            WalletCacheConfig uncached;
+            uncached.budgetBytes = 0;
+            auth.configureCache(uncached);
+            auth.saveUserData(user);
+            auth.flushWallets();
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) auth.releaseUser(auth.loadUserData("persist"));
+            sw.pause();
+            auth.configureCache(WalletCacheConfig());
+            suite.record("auth.load_user_data.uncached", "holdings", holdings, ops, sw.elapsedNs);
+        }
+    }
+
+    if (!suite.enabled("io.load_crypto_data")) return;
+    for (std::size_t listings : suite.sizes({10, 1000, 100000})) {
+        {
+            std::ofstream file("crypto_data.csv");
+            for (std::size_t i = 0; i < listings; ++i) {
+                file << "Coin" << i << ",L" << i << "," << (1 + i % 1000) << ".25,0.01,0.000001\n";
+            }
+        }
+        const std::size_t ops = listings >= 100000 ? 3 : 100;
+        Stopwatch sw;
+        for (std::size_t i = 0; i < ops; ++i) {
+            Exchange ex;
+            sw.resume();
+            loadCryptoData(ex);
+            sw.pause();
+        }
+        suite.record("io.load_crypto_data", "listings", listings, ops, sw.elapsedNs);
+    }
+}
+
+// The pre-store scheme: one <user>_wallet.csv per wallet, rewritten whole.
+void legacySaveWallet(const User& user) {
+    std::ofstream file(user.getName() + "_wallet.csv");
+    file << user.getWallet().getCash() << '\n';
+    for (const auto& holding : user.getWallet().getHoldings()) {
+        file << symbolName(holding.first) << "," << holding.second << '\n';
+    }
+}
+
+User* legacyLoadWallet(const std::string& username) {
+    std::ifstream file(username + "_wallet.csv");
+    if (!file) return nullptr;
+    Fixed cash;
+    file >> cash;
+    User* user = new User(username, cash);
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+        std::stringstream ss(line);
+        std::string symbol;
+        Fixed units;
+        std::getline(ss, symbol, ',');
+        ss >> units;
+        if (!symbol.empty()) user->getWallet().addQty(symbol, units);
+    }
+    return user;
+}
+
+// Random wallet reads and writes against wallets.db and against a CSV per
+// user, over `users` wallets of 5 holdings each.
+void benchWalletStorage(BenchSuite& suite) {
+    const char* cases[] = {"storage.wallet_load.csv", "storage.wallet_load.db", "storage.wallet_save.csv",
+                           "storage.wallet_save.db",  "storage.wallet_scan.db", "storage.wallet_open.db"};
+    if (std::none_of(std::begin(cases), std::end(cases), [&](const char* c) { return suite.enabled(c); })) return;
+    fs::create_directories("walletstore");
+    fs::current_path("walletstore");
+    Exchange ex;
+    std::vector<SymbolId> ids = listSymbols(ex, 50);
+    for (std::size_t users : suite.sizes({1000, 100000})) {
+        fs::remove("bench_wallets.db");
+        std::vector<std::string> names;
+        char name[32];
+        auto makeUser = [&](std::size_t i, std::int64_t cash) {
+            User user(names[i], Fixed::fromInt(cash));
+            for (std::size_t k = 0; k < 5; ++k) user.getWallet().addQty(ids[(i + k * 11) % ids.size()], Fixed::fromRaw(123456789));
+            return user;
+        };
+        for (std::size_t i = 0; i < users; ++i) {
+            std::snprintf(name, sizeof(name), "w%07zu", i);
+            names.push_back(name);
+        }
+        {
+            WalletStore store;
+            store.open("bench_wallets.db");
+            for (std::size_t i = 0; i < users; ++i) {
+                User user = makeUser(i, 1000);
+                store.save(user);
+                legacySaveWallet(user);
+            }
+        }
+
+        const std::size_t ops = 20000;
+        if (suite.enabled("storage.wallet_load.csv")) {
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) delete legacyLoadWallet(names[(i * 7919) % users]);
+            sw.pause();
+            suite.record("storage.wallet_load.csv", "users", users, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("storage.wallet_save.csv")) {
+            Stopwatch sw;
+            for (std::size_t i = 0; i < ops; ++i) {
+                User user = makeUser((i * 7919) % users, 2000 + i);
+                sw.resume();
+                legacySaveWallet(user);
+                sw.pause();
+            }
+            suite.record("storage.wallet_save.csv", "users", users, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("storage.wallet_open.db")) {
+            const std::size_t opens = 5;
+            Stopwatch sw;
+            for (std::size_t i = 0; i < opens; ++i) {
+                WalletStore store;
+                sw.resume();
+                store.open("bench_wallets.db");
+                sw.pause();
+            }
+            suite.record("storage.wallet_open.db", "users", users, opens, sw.elapsedNs);
+        }
+
+        WalletStore store;
+        store.open("bench_wallets.db");
+        if (suite.enabled("storage.wallet_load.db")) {
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) delete store.load(names[(i * 7919) % users]);
+            sw.pause();
+            suite.record("storage.wallet_load.db", "users", users, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("storage.wallet_save.db")) {
+            Stopwatch sw;
+            for (std::size_t i = 0; i < ops; ++i) {
+                User user = makeUser((i * 7919) % users, 2000 + i);
+                sw.resume();
+                store.save(user);
+                sw.pause();
+            }
+            suite.record("storage.wallet_save.db", "users", users, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("storage.wallet_scan.db")) {
+            std::uint64_t sink = 0;
+            Stopwatch sw;
+            sw.resume();
+            store.scan([&](const User& user) { sink += user.getWallet().getCash().getRaw(); });
+            sw.pause();
+            benchSink = benchSink + sink;
+            suite.record("storage.wallet_scan.db", "users", users, users, sw.elapsedNs);
+        }
+        for (const auto& n : names) fs::remove(n + "_wallet.csv");
+    }
+    fs::remove("bench_wallets.db");
+    fs::current_path("..");
+}
+
+void benchAuth(BenchSuite& suite) {
+    if (!suite.enabled("auth.load_credentials") && !suite.enabled("auth.login") && !suite.enabled("auth.signup")) return;
+    for (std::size_t users : suite.sizes({1000, 100000, 1000000, 10000000})) {
+        {
+            std::ofstream file("users.txt", std::ios::trunc);
+            for (std::size_t i = 0; i < users; ++i) file << "user" << i << " " << (5381 + i) << '\n';
+            file << "bench " << 6954013174763UL << '\n'; // password "secret"
+        }
+        Stopwatch load;
+        load.resume();
+        AuthManager auth;
+        load.pause();
+        if (suite.enabled("auth.load_credentials")) suite.record("auth.load_credentials", "users", users, users, load.elapsedNs);
+
+        QuietCout quiet;
+        const std::size_t ops = 2000;
+        if (suite.enabled("auth.login")) {
+            auth.releaseUser(auth.loadUserData("bench")); // wallet exists, so the timed path only reads it
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) auth.releaseUser(auth.login("bench", "secret"));
+            sw.pause();
+            suite.record("auth.login", "users", users, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("auth.signup")) {
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) auth.releaseUser(auth.signUp("new" + std::to_string(users) + "_" + std::to_string(i), "secret"));
+            sw.pause();
+            suite.record("auth.signup", "users", users, ops, sw.elapsedNs);
+        }
+    }
+    fs::remove("users.txt");
+}
+
+// Correlated GBM step generation for `symbols` listings: Philox shocks plus
+// the price update, reported per symbol-step.
+void benchSimulation(BenchSuite& suite) {
+    if (!suite.enabled("sim.advance")) return;
+    for (std::size_t symbols : suite.sizes({3, 100, 1000})) {
+        Exchange ex;
+        listSymbols(ex, symbols);
+        GbmConfig config;
+        PriceGenerator generator(ex, config);
+        std::vector<double> prices;
+        const std::size_t steps = 1000000 / symbols;
+        Stopwatch sw;
+        sw.resume();
+        for (std::uint64_t first = 0; first < steps; first += 1024) {
+            generator.advance(first, static_cast<std::size_t>(std::min<std::uint64_t>(1024, steps - first)), prices);
+        }
+        sw.pause();
+        benchSink = benchSink + static_cast<std::uint64_t>(prices.back());
+        suite.record("sim.advance", "symbols", symbols, steps * symbols, sw.elapsedNs);
+    }
+}
+
+// 64 grid runs over a 100k-tick BTC random walk, spread across `threads`
+// workers; ns per run falling with the thread count is the scaling curve.
+void benchBacktest(BenchSuite& suite) {
+    if (!suite.enabled("backtest.grid")) return;
+    {
+        std::ofstream file("backtest_ticks.csv");
+        std::uint64_t state = 12345;
+        std::int64_t price = 6000000; // cents
+        for (std::size_t i = 0; i < 100000; ++i) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            price += (static_cast<std::int64_t>(state >> 59) - 15) * 10;
+            file << i * 1000 << ",BTC," << price / 100 << "." << std::setw(2) << std::setfill('0') << price % 100
+                 << std::setfill(' ') << "\n";
+        }
+    }
+    Exchange ex;
+    seedExchange(ex);
+    Backtester backtester(ex, AuthManager::STARTING_CASH);
+    backtester.load("backtest_ticks.csv");
+    std::istringstream specText("grid BTC 1:8:1 0.01:0.08:0.01 0.01\n");
+    std::vector<BacktestSpec> specs;
+    std::string error;
+    backtester.parseSpecs(specText, specs, error);
+
+    for (std::size_t threads : suite.sizes({1, 2, 4, 8})) {
+        std::uint64_t sink = 0;
+        Stopwatch sw;
+        sw.resume();
+        for (const BacktestResult& r : backtester.runAll(specs, static_cast<unsigned>(threads))) sink += r.fills;
+        sw.pause();
+        benchSink = benchSink + sink;
+        suite.record("backtest.grid", "threads", threads, specs.size(), sw.elapsedNs);
+    }
+    fs::remove("backtest_ticks.csv");
+}
+
+// Multi-symbol order flow from two producer threads through the sharded
+// engine; ns/op falling with the shard count is the scaling curve.
+void benchEngine(BenchSuite& suite) {
+    if (!suite.enabled("engine.throughput")) return;
+    const std::size_t symbols = 64, userCount = 1000, producers = 2;
+    const std::size_t ops = 2000000;
+    Exchange ex;
+    std::vector<SymbolId> ids = listSymbols(ex, symbols);
+    std::vector<UserId> userIds;
+    for (std::size_t u = 0; u < userCount; ++u) {
+        userIds.push_back(UserRegistry::instance().intern("user" + std::to_string(u)));
+    }
+    std::vector<std::vector<EngineOrder>> flows(producers);
+    for (std::size_t p = 0; p < producers; ++p) {
+        for (std::size_t i = 0; i < ops / producers; ++i) {
+            std::size_t k = i * producers + p;
+            EngineOrder order;
+            order.symbol = ids[(k * 7919) % symbols];
+            order.user = userIds[k % userCount];
+            order.orderId = static_cast<std::int64_t>(k) + 1;
+            order.isBuy = (k & 1) == 0;
+            order.units = Crypto_currency::DEFAULT_LOT;
+            Fixed ref = ex.priceOf(order.symbol);
+            switch (k % 10) {
+                case 0: order.type = EngineOrder::PriceUpdate; order.price = ref + Fixed::fromInt(k % 3) - Fixed::fromInt(1); break;
+                case 1: case 2: order.type = EngineOrder::Limit; order.price = order.isBuy ? ref - Fixed::fromInt(1) : ref + Fixed::fromInt(1); break;
+                default: order.type = EngineOrder::Market; break;
+            }
+            flows[p].push_back(order);
+        }
+    }
+
+    for (std::size_t shardCount : suite.sizes({1, 2, 4, 8})) {
+        std::vector<User> users;
+        users.reserve(userCount);
+        for (std::size_t u = 0; u < userCount; ++u) {
+            users.emplace_back("user" + std::to_string(u), Fixed::fromInt(1000000000));
+            for (SymbolId id : ids) users.back().getWallet().addQty(id, Fixed::fromInt(1000));
+        }
+        ShardedEngine engine(ex, shardCount);
+        for (auto& user : users) engine.addUser(&user);
+
+        Stopwatch sw;
+        sw.resume();
+        engine.start();
+        std::vector<std::thread> threads;
+        for (std::size_t p = 0; p < producers; ++p) {
+            threads.emplace_back([&engine, &flows, p] {
+                for (const auto& order : flows[p]) {
+                    while (!engine.submit(order)) std::this_thread::yield();
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+        engine.stop();
+        sw.pause();
+        benchSink = benchSink + engine.settled() + engine.rejected();
+        suite.record("engine.throughput", "shards", shardCount, engine.processed(), sw.elapsedNs);
+    }
+}
+
+// Many threads drawing order IDs at once; every run checks the IDs are
+// unique. orders.id_alloc.mutex is a locked counter for comparison.
+void benchOrderIds(BenchSuite& suite) {
+    if (!suite.enabled("orders.id_alloc") && !suite.enabled("orders.id_alloc.mutex")) return;
+    const std::size_t perThread = 200000;
+    for (std::size_t threads : suite.sizes({1, 2, 4, 8, 16, 32})) {
+        std::vector<std::vector<std::int64_t>> drawn(threads, std::vector<std::int64_t>(perThread));
+        auto run = [&](const std::function<std::int64_t()>& next) {
+            std::atomic<bool> go{false};
+            std::vector<std::thread> pool;
+            for (std::size_t t = 0; t < threads; ++t) {
+                pool.emplace_back([&, t] {
+                    while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                    for (std::size_t i = 0; i < perThread; ++i) drawn[t][i] = next();
+                });
+            }
+            Stopwatch sw;
+            sw.resume();
+            go.store(true, std::memory_order_release);
+            for (auto& thread : pool) thread.join();
+            sw.pause();
+            std::vector<std::int64_t> all;
+            for (const auto& ids : drawn) all.insert(all.end(), ids.begin(), ids.end());
+            std::sort(all.begin(), all.end());
+            if (std::adjacent_find(all.begin(), all.end()) != all.end()) {
+                std::cerr << "orders.id_alloc: duplicate order ID\n";
+                std::exit(1);
+            }
+            return sw.elapsedNs;
+        };
+        if (suite.enabled("orders.id_alloc")) {
+            fs::remove("bench_order_id.txt");
+            OrderIdAllocator ids;
+            ids.open("bench_order_id.txt");
+            double ns = run([&] { return ids.allocate(); });
+            suite.record("orders.id_alloc", "threads", threads, threads * perThread, ns);
+        }
+        if (suite.enabled("orders.id_alloc.mutex")) {
+            std::mutex lock;
+            std::int64_t counter = 1;
+            double ns = run([&] {
+                std::lock_guard<std::mutex> guard(lock);
+                return counter++;
+            });
+            suite.record("orders.id_alloc.mutex", "threads", threads, threads * perThread, ns);
+        }
+    }
+    fs::remove("bench_order_id.txt");
+}
+
+// Core matching on one book; 1000 / ns_per_op gives millions of ops per second.
+void benchOrderBook(BenchSuite& suite) {
+    const Fixed tick = Crypto_currency::DEFAULT_TICK;
+    const Fixed lot = Fixed::fromInt(1);
+    const std::int64_t mid = 100000; // ticks, $1000.00
+    for (std::size_t resting : suite.sizes({1000, 100000, 1000000})) {
+        // Bids below and asks above the mid, spread over 1000 levels a side.
+        OrderBook book(tick);
+        std::vector<BookFill> fills;
+        std::vector<std::uint64_t> handles;
+        std::uint64_t handle;
+        for (std::size_t i = 0; i < resting; ++i) {
+            bool isBuy = (i & 1) == 0;
+            std::int64_t t = isBuy ? mid - 1 - static_cast<std::int64_t>(i % 1000) : mid + 1 + static_cast<std::int64_t>(i % 1000);
+            book.submit(0, i, isBuy, Fixed::fromRaw(t * tick.getRaw()), lot, fills, handle);
+            handles.push_back(handle);
+        }
+
+        const std::size_t ops = 2000000;
+        if (suite.enabled("book.add_cancel")) {
+            // Passive add then cancel of the oldest live order: two ops per step.
+            Stopwatch sw;
+            std::size_t oldest = 0;
+            sw.resume();
+            for (std::size_t i = 0; i < ops / 2; ++i) {
+                bool isBuy = (i & 1) == 0;
+                std::int64_t t = isBuy ? mid - 1 - static_cast<std::int64_t>((i * 7) % 1000) : mid + 1 + static_cast<std::int64_t>((i * 7) % 1000);
+                book.submit(1, i, isBuy, Fixed::fromRaw(t * tick.getRaw()), lot, fills, handle);
+                handles.push_back(handle);
+                book.cancel(handles[oldest++]);
+            }
+            sw.pause();
+            handles.erase(handles.begin(), handles.begin() + static_cast<std::ptrdiff_t>(oldest));
+            suite.record("book.add_cancel", "resting", resting, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("book.match")) {
+            // Aggressive order takes the top of book, then the level is refilled.
+            Stopwatch sw;
+            std::size_t matched = 0;
+            sw.resume();
+            for (std::size_t i = 0; i < ops / 2; ++i) {
+                bool isBuy = (i & 1) == 0;
+                Fixed best = isBuy ? book.getBestAsk() : book.getBestBid();
+                fills.clear();
+                book.submit(2, i, isBuy, best, lot, fills, handle);
+                matched += fills.size();
+                book.submit(3, i, !isBuy, best, lot, fills, handle);
+            }
+            sw.pause();
+            benchSink = benchSink + matched;
+            suite.record("book.match", "resting", resting, ops, sw.elapsedNs);
+        }
+    }
+    if (suite.enabled("book.gap_cancel")) {
+        // Cancelling the only bid near the mid leaves the next one `gap` ticks
+        // lower, so every cancel searches that far for the new best bid.
+        for (std::size_t gap : suite.sizes({1000, 100000, 1000000})) {
+            OrderBook book(tick);
+            std::vector<BookFill> fills;
+            std::uint64_t handle;
+            const std::int64_t near = 1000 + static_cast<std::int64_t>(gap);
+            book.submit(0, 0, true, Fixed::fromRaw(1000 * tick.getRaw()), lot, fills, handle);
+            const std::size_t ops = 200000;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) {
+                book.submit(1, i, true, Fixed::fromRaw(near * tick.getRaw()), lot, fills, handle);
+                book.cancel(handle);
+            }
+            sw.pause();
+            benchSink = benchSink + static_cast<std::uint64_t>(book.getBestBid().getRaw());
+            suite.record("book.gap_cancel", "gap", gap, ops, sw.elapsedNs);
+        }
+    }
+}
+
+// Candle upkeep per tick across `symbols` symbols (all three resolutions),
+// and a one-hour range query at 1s resolution on a full ring.
+void benchCandles(BenchSuite& suite) {
+    if (!suite.enabled("candles.add") && !suite.enabled("candles.range")) return;
+    CandleStore& store = CandleStore::instance();
+    for (std::size_t symbols : suite.sizes({1, 100, 1000})) {
+        store.clear();
+        const std::size_t ops = 1000000;
+        if (suite.enabled("candles.add")) {
+            // Ticks 10 ms apart, so a new 1s candle opens every 100 ticks per
+            // symbol. Rings are allocated and touched before timing.
+            for (SymbolId symbol = 0; symbol < symbols; ++symbol) {
+                for (std::int64_t t = -4000; t < 0; ++t) store.add(symbol, t * 1000, Fixed::fromInt(100), Fixed());
+            }
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) {
+                SymbolId symbol = static_cast<SymbolId>(i % symbols);
+                store.add(symbol, static_cast<std::int64_t>(i / symbols) * 10, Fixed::fromInt(100 + i % 7), Fixed::fromInt(1));
+            }
+            sw.pause();
+            suite.record("candles.add", "symbols", symbols, ops, sw.elapsedNs);
+            suite.recordValue("candles.memory", "symbols", symbols, symbols, double(store.bytesPerSymbol()), "B/symbol");
+        }
+        if (suite.enabled("candles.range")) {
+            for (std::size_t t = 0; t < 4000; ++t) store.add(0, static_cast<std::int64_t>(t) * 1000, Fixed::fromInt(100), Fixed());
+            const CandleSeries* series = store.find(0, CandleStore::SECOND);
+            std::uint64_t sink = 0;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) {
+                std::int64_t from = static_cast<std::int64_t>(1000 + i % 600) * 1000;
+                sink += series->range(from, from + 3600000).size;
+            }
+            sw.pause();
+            benchSink = benchSink + sink;
+            suite.record("candles.range", "symbols", symbols, ops, sw.elapsedNs);
+        }
+    }
+    store.clear();
+}
+
+// Fills spread over 16 symbols from 1-8 threads, each recording into its own
+// padded slots; the merged count must come out exact.
+void benchTradeStats(BenchSuite& suite) {
+    if (!suite.enabled("stats.trade_record")) return;
+    const std::size_t perThread = 500000;
+    const SymbolId symbols = 16;
+    std::uint64_t expected = 0; // starts from the fills earlier cases recorded on these ids
+    for (SymbolId symbol = 0; symbol < symbols; ++symbol) expected += TradeStats::instance().summary(symbol, 0).count;
+    for (std::size_t threads : suite.sizes({1, 2, 4, 8})) {
+        std::atomic<bool> go{false};
+        std::vector<std::thread> pool;
+        for (std::size_t t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t] {
+                TradeStats& stats = TradeStats::instance();
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                for (std::size_t i = 0; i < perThread; ++i) {
+                    stats.record(static_cast<SymbolId>((i + t) % symbols), Fixed::fromInt(100 + i % 7), Fixed::fromInt(1),
+                                 static_cast<std::int64_t>(i));
+                }
+            });
+        }
+        Stopwatch sw;
+        sw.resume();
+        go.store(true, std::memory_order_release);
+        for (auto& thread : pool) thread.join();
+        sw.pause();
+        expected += threads * perThread;
+        std::uint64_t counted = 0;
+        for (SymbolId symbol = 0; symbol < symbols; ++symbol) counted += TradeStats::instance().summary(symbol, 0).count;
+        if (counted != expected) {
+            std::cerr << "stats.trade_record: merged " << counted << " fills, expected " << expected << "\n";
+            std::exit(1);
+        }
+        suite.record("stats.trade_record", "threads", threads, threads * perThread, sw.elapsedNs);
+    }
+}
+
+// Mark-to-market over `users` wallets, each holding 4 of 100 symbols. Loaded
+// from an empty user directory, then filled row by row as saves would.
+void benchValuation(BenchSuite& suite) {
+    if (!suite.enabled("valuation.revalue") && !suite.enabled("valuation.set_price") &&
+        !suite.enabled("valuation.update_user") && !suite.enabled("valuation.top10")) {
+        return;
+    }
+    fs::create_directories("valuation");
+    fs::current_path("valuation");
+    ValuationEngine& valuation = ValuationEngine::instance();
+    for (std::size_t users : suite.sizes({1000, 100000, 1000000})) {
+        Exchange ex;
+        std::vector<SymbolId> ids = listSymbols(ex, 100);
+        AuthManager auth;
+        valuation.clear();
+        valuation.load(ex, auth);
+        char name[32];
+        for (std::size_t i = 0; i < users; ++i) {
+            std::snprintf(name, sizeof(name), "val%07zu", i);
+            User user(name, Fixed::fromInt(1000 + i % 5000));
+            for (std::size_t k = 0; k < 4; ++k) user.getWallet().addQty(ids[(i + k * 25) % ids.size()], Fixed::fromInt(1));
+            valuation.update(user);
+        }
+
+        if (suite.enabled("valuation.revalue")) {
+            const std::size_t ops = users >= 1000000 ? 20 : 200;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) valuation.revalue();
+            sw.pause();
+            suite.record("valuation.revalue", "users", users, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("valuation.set_price")) {
+            // One symbol is held by 4% of users; only those rows are touched.
+            const std::size_t ops = 2000;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) ex.setPrice(ids[i % ids.size()], Fixed::fromInt(1 + i % 1000));
+            sw.pause();
+            suite.record("valuation.set_price", "users", users, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("valuation.update_user")) {
+            const std::size_t ops = 100000;
+            User user("val0000000", Fixed::fromInt(1000));
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) {
+                user.getWallet().addQty(ids[i % ids.size()], Fixed::fromInt(1));
+                user.getWallet().removeQty(ids[(i + 50) % ids.size()], Fixed::fromInt(1));
+                valuation.update(user);
+            }
+            sw.pause();
+            suite.record("valuation.update_user", "users", users, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("valuation.top10")) {
+            const std::size_t ops = users >= 1000000 ? 10 : 100;
+            std::uint64_t sink = 0;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) sink += valuation.top(10).size();
+            sw.pause();
+            benchSink = benchSink + sink;
+            suite.record("valuation.top10", "users", users, ops, sw.elapsedNs);
+        }
+    }
+    valuation.clear();
+    fs::current_path("..");
+}
+
+void benchSnapshot(BenchSuite& suite) {
+    if (!suite.enabled("snapshot.startup") && !suite.enabled("snapshot.checkpoint")) return;
+    for (std::size_t users : suite.sizes({10000, 100000, 1000000})) {
+        fs::remove("state.snap");
+        fs::remove("limit_orders.journal");
+        {
+            Exchange ex;
+            seedExchange(ex);
+            writeOrderFile(1000);
+            LimitOrderManager manager;
+            SnapshotWriter writer(ex, manager);
+            char name[32];
+            for (std::size_t i = 0; i < users; ++i) {
+                std::snprintf(name, sizeof(name), "user%07zu", i);
+                User user(name, Fixed::fromInt(10000));
+                for (const auto& listing : ex.getListings()) user.getWallet().addQty(listing.getId(), Fixed::fromRaw(123456789));
+                writer.addUser(user);
+            }
+            writer.write("state.snap");
+            fs::remove("limit_orders.txt");
+        }
+
+        // Process start-up: map, restore listings and the order book, then log one user in.
+        if (suite.enabled("snapshot.startup")) {
+            const std::size_t ops = 5;
+            std::uint64_t sink = 0;
+            Stopwatch sw;
+            sw.resume();
+            for (std::size_t i = 0; i < ops; ++i) {
+                StateSnapshot snapshot;
+                snapshot.open("state.snap");
+                Exchange ex;
+                snapshot.restoreListings(ex);
+                LimitOrderManager manager(&snapshot);
+                User* user = snapshot.loadUser(*snapshot.findUser("user0000000"));
+                sink += user->getWallet().getCash().getRaw() + manager.size();
+                delete user;
+            }
+            sw.pause();
+            benchSink = benchSink + sink;
+            suite.record("snapshot.startup", "users", users, ops, sw.elapsedNs);
+        }
+        if (suite.enabled("snapshot.checkpoint")) {
+            StateSnapshot snapshot;
+            snapshot.open("state.snap");
+            Exchange ex;
+            snapshot.restoreListings(ex);
+            AuthManager auth;
+            auth.attachSnapshot(&snapshot);
+            LimitOrderManager manager(&snapshot);
+            Stopwatch sw;
+            sw.resume();
+            checkpointState("state.snap", ex, auth, manager, &snapshot);
+            sw.pause();
+            suite.record("snapshot.checkpoint", "users", users, 1, sw.elapsedNs);
+        }
+    }
+    fs::remove("state.snap");
+}
+
+int main(int argc, char* argv[]) {
+    std::string format = "table", outPath, filter;
+    bool quick = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) format = argv[++i];
+        else if (arg == "--out" && i + 1 < argc) outPath = fs::absolute(argv[++i]).string();
+        else if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+        else if (arg == "--quick") quick = true;
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--format table|csv|json] [--out <file>] [--filter <substring>] [--quick]\n";
+            return 1;
+        }
+    }
+    if (format != "table" && format != "csv" && format != "json") {
+        std::cerr << "Unknown format " << format << '\n';
+        return 1;
+    }
+
+    fs::path scratch = fs::temp_directory_path() / "crypto_sim_bench";
+    fs::remove_all(scratch);
+    fs::create_directories(scratch);
+    fs::current_path(scratch);
+
+    // Trade paths report through the event log as in the simulator, with echo off.
+    EventLog::instance().setEcho(false);
+    EventLog::instance().start();
+
+    BenchSuite suite(filter, quick);
+    benchEvents(suite);
+    benchExchange(suite);
+    benchWallet(suite);
+    benchTrades(suite);
+    benchBaskets(suite);
+    benchLimitOrders(suite);
+    benchOrderStorage(suite);
+    benchOrderIds(suite);
+    benchOrderBook(suite);
+    benchPersistence(suite);
+    benchWalletStorage(suite);
+    benchAuth(suite);
+    benchCandles(suite);
+    benchTradeStats(suite);
+    benchValuation(suite);
+    benchSnapshot(suite);
+    benchEngine(suite);
+    benchBacktest(suite);
+    benchSimulation(suite);
+    EventLog::instance().stop();
+
+    fs::current_path(scratch.parent_path());
+    fs::remove_all(scratch);
+
+    std::ofstream outFile;
+    if (!outPath.empty()) {
+        outFile.open(outPath);
+        if (!outFile) {
+            std::cerr << "Error: Could not open " << outPath << '\n';
+            return 1;
+        }
+    }
+    std::ostream& out = outPath.empty() ? std::cout : outFile;
+    if (format == "csv") suite.writeCsv(out);
+    else if (format == "json") suite.writeJson(out);
+    else suite.writeTable(out);
+    return 0;
+}
@@ -1,14 +1,51 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
 #include <fstream>
+#include <filesystem>
 #include <sstream>
 #include <iomanip>
 #include <limits>
 #include <algorithm>
+#include <functional>
 #include <utility> // for std::pair
 #include <stdexcept> // Required for standard exception types
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <cctype>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <list>
+#include <type_traits>
+#include <array>
+#include <cstdio>
+#include <optional>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <csignal>
+#include <deque>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 
 using namespace std;
 
@@ -17,940 +54,7548 @@ class Exchange;
 class AuthManager;
 class LimitOrderManager;
 
-class Crypto_currency {
+using SymbolId = std::uint32_t;
+using UserId = std::uint32_t;
+
+// Interns each name once into a dense id. Strings are resolved here, at the
+// I/O edge; prices, wallets and orders work on ids only. Names sit in fixed
+// chunks that never move, so a thread handed an id may read its name while
+// the owning thread keeps interning.
+class NameRegistry {
 private:
-    std::string name;
-    std::string symbol;
-    double price;
+    static constexpr std::size_t CHUNK_SIZE = 4096;
+    static constexpr std::size_t MAX_CHUNKS = 4096;
+    std::unique_ptr<std::unique_ptr<std::string[]>[]> chunks;
+    std::atomic<std::size_t> count{0};
+    std::unordered_map<std::string, std::uint32_t> ids;
 
 public:
-    Crypto_currency(const std::string& name, const std::string& symbol, double price);
+    static const std::uint32_t npos = 0xFFFFFFFFu;
 
-    const std::string& getName() const;
-    const std::string& getSymbol() const;
-    double getPrice() const;
-    void setPrice(double newPrice);
-
-    bool operator==(const Crypto_currency& other) const { return symbol == other.symbol; }
-    bool operator!=(const Crypto_currency& other) const { return !(*this == other); }
+    NameRegistry();
+    NameRegistry(const NameRegistry&) = delete;
+    NameRegistry& operator=(const NameRegistry&) = delete;
 
-    friend std::ostream& operator<<(std::ostream& os, const Crypto_currency& c);
+    std::uint32_t intern(const std::string& name);
+    std::uint32_t lookup(const std::string& name) const;
+    const std::string& name(std::uint32_t id) const;
+    std::size_t size() const;
 };
 
-Crypto_currency::Crypto_currency(const std::string& name, const std::string& symbol, double price)
-    : name(name), symbol(symbol), price(price) {}
+NameRegistry::NameRegistry() : chunks(new std::unique_ptr<std::string[]>[MAX_CHUNKS]) {}
+
+std::uint32_t NameRegistry::intern(const std::string& name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) return it->second;
+    std::size_t next = count.load(std::memory_order_relaxed);
+    if (next == CHUNK_SIZE * MAX_CHUNKS) throw std::length_error("name registry is full");
+    std::unique_ptr<std::string[]>& chunk = chunks[next / CHUNK_SIZE];
+    if (!chunk) chunk.reset(new std::string[CHUNK_SIZE]);
+    chunk[next % CHUNK_SIZE] = name;
+    count.store(next + 1, std::memory_order_release);
+    std::uint32_t id = static_cast<std::uint32_t>(next);
+    ids.emplace(name, id);
+    return id;
+}
 
-const std::string& Crypto_currency::getName() const { return name; }
-const std::string& Crypto_currency::getSymbol() const { return symbol; }
-double Crypto_currency::getPrice() const { return price; }
-void Crypto_currency::setPrice(double newPrice) { price = newPrice; }
+std::uint32_t NameRegistry::lookup(const std::string& name) const {
+    auto it = ids.find(name);
+    return (it != ids.end()) ? it->second : npos;
+}
 
-inline std::ostream& operator<<(std::ostream& os, const Crypto_currency& c) {
-    os << c.getSymbol() << " (" << c.getName() << ") $" << std::fixed << std::setprecision(2) << c.getPrice();
-    return os;
+const std::string& NameRegistry::name(std::uint32_t id) const {
+    if (id >= count.load(std::memory_order_acquire)) throw std::out_of_range("unknown registry id");
+    return chunks[id / CHUNK_SIZE][id % CHUNK_SIZE];
 }
 
-class Wallet {
-private:
-    double cashBalance;
-    std::map<std::string, double> holdings;
+std::size_t NameRegistry::size() const { return count.load(std::memory_order_acquire); }
 
+class SymbolRegistry : public NameRegistry {
 public:
-    Wallet() : cashBalance(0.0) {}
-    explicit Wallet(double initialCash) : cashBalance(initialCash) {}
+    static SymbolRegistry& instance();
+};
 
-    double getCash() const;
-    void deposit(double amount);
-    bool withdraw(double amount);
+SymbolRegistry& SymbolRegistry::instance() {
+    static SymbolRegistry registry;
+    return registry;
+}
 
-    double getQty(const std::string& symbol) const;
-    void addQty(const std::string& symbol, double units);
-    bool removeQty(const std::string& symbol, double units);
+class UserRegistry : public NameRegistry {
+public:
+    static UserRegistry& instance();
+};
 
-    void print() const;
-    const std::map<std::string, double>& getHoldings() const;
+UserRegistry& UserRegistry::instance() {
+    static UserRegistry registry;
+    return registry;
+}
 
-    Wallet& operator+=(double amount) { deposit(amount); return *this; }
-    Wallet& operator-=(double amount) { withdraw(amount); return *this; }
+inline const std::string& symbolName(SymbolId id) { return SymbolRegistry::instance().name(id); }
+inline const std::string& userName(UserId id) { return UserRegistry::instance().name(id); }
 
-    Wallet& operator+=(const std::pair<std::string,double>& asset) { addQty(asset.first, asset.second); return *this; }
-    Wallet& operator-=(const std::pair<std::string,double>& asset) { removeQty(asset.first, asset.second); return *this; }
+// Fixed-point decimal with eight fractional digits, stored as int64 ticks of
+// 1e-8. Money, prices and quantities all use it, so trade arithmetic is exact
+// and independent of evaluation order.
+class Fixed {
+private:
+    std::int64_t raw;
 
-    bool operator==(const Wallet& other) const { return cashBalance == other.cashBalance && holdings == other.holdings; }
-    bool operator!=(const Wallet& other) const { return !(*this == other); }
+    explicit constexpr Fixed(std::int64_t ticks) : raw(ticks) {}
 
-    friend std::ostream& operator<<(std::ostream& os, const Wallet& w);
+public:
+    static const std::int64_t SCALE = 100000000;
+    static const int DECIMALS = 8;
+
+    constexpr Fixed() : raw(0) {}
+
+    static constexpr Fixed fromRaw(std::int64_t ticks) { return Fixed(ticks); }
+    static constexpr Fixed fromInt(std::int64_t whole) { return Fixed(whole * SCALE); }
+    static Fixed fromDouble(double value);
+    static bool parse(const std::string& text, Fixed& out);
+    static bool parse(const char* begin, const char* end, Fixed& out);
+
+    // Exact product or sum; false, leaving `out` untouched, when it does not fit in int64 ticks.
+    static bool checkedMul(Fixed a, Fixed b, Fixed& out);
+    static bool checkedAdd(Fixed a, Fixed b, Fixed& out);
+
+    std::int64_t getRaw() const { return raw; }
+    double toDouble() const { return static_cast<double>(raw) / SCALE; }
+    std::string toString() const;
+
+    bool isMultipleOf(Fixed step) const { return step.raw > 0 && raw % step.raw == 0; }
+    Fixed roundTo(Fixed step) const;
+
+    Fixed operator-() const { return Fixed(-raw); }
+    Fixed operator+(Fixed other) const { return Fixed(raw + other.raw); }
+    Fixed operator-(Fixed other) const { return Fixed(raw - other.raw); }
+    Fixed operator*(Fixed other) const;
+    Fixed operator/(std::int64_t divisor) const;
+    Fixed& operator+=(Fixed other) { raw += other.raw; return *this; }
+    Fixed& operator-=(Fixed other) { raw -= other.raw; return *this; }
+
+    bool operator==(Fixed other) const { return raw == other.raw; }
+    bool operator!=(Fixed other) const { return raw != other.raw; }
+    bool operator<(Fixed other) const { return raw < other.raw; }
+    bool operator>(Fixed other) const { return raw > other.raw; }
+    bool operator<=(Fixed other) const { return raw <= other.raw; }
+    bool operator>=(Fixed other) const { return raw >= other.raw; }
+
+    friend std::ostream& operator<<(std::ostream& os, Fixed f);
+    friend std::istream& operator>>(std::istream& is, Fixed& f);
 };
 
-double Wallet::getCash() const { return cashBalance; }
-
-void Wallet::deposit(double amount) {
-    if (amount > 0) {
-        cashBalance += amount;
-    }
+// Divides by `den`, rounding half away from zero.
+template <typename Wide>
+inline std::int64_t roundedQuotient(Wide num, Wide den) {
+    Wide q = num / den;
+    Wide r = num % den;
+    if (r < 0) r = -r;
+    if (2 * r >= den) q += (num < 0) ? -1 : 1;
+    return static_cast<std::int64_t>(q);
 }
 
-bool Wallet::withdraw(double amount) {
-    if (amount > 0 && amount <= cashBalance) {
-        cashBalance -= amount;
-        return true;
-    }
-    return false;
+Fixed Fixed::fromDouble(double value) {
+    return Fixed(static_cast<std::int64_t>(std::llround(value * SCALE)));
 }
 
-double Wallet::getQty(const std::string& symbol) const {
-    auto it = holdings.find(symbol);
-    return (it != holdings.end()) ? it->second : 0.0;
+// Accepts plain decimals ("12", "-0.5", ".25"); digits past the eighth decimal
+// are rounded. Exponent forms written by older double-based files fall back
+// to a double conversion.
+bool Fixed::parse(const std::string& text, Fixed& out) {
+    return parse(text.data(), text.data() + text.size(), out);
 }
 
-void Wallet::addQty(const std::string& symbol, double units) {
-    if (units > 0) {
-        holdings[symbol] += units;
+bool Fixed::parse(const char* begin, const char* end, Fixed& out) {
+    const char* p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+    std::int64_t whole = 0, frac = 0;
+    int fracDigits = 0, digits = 0;
+    bool roundUp = false;
+    for (; p < end && std::isdigit(static_cast<unsigned char>(*p)); ++p, ++digits) {
+        if (whole > (std::numeric_limits<std::int64_t>::max() / SCALE) / 10) return false;
+        whole = whole * 10 + (*p - '0');
     }
-}
-
-bool Wallet::removeQty(const std::string& symbol, double units) {
-    if (units > 0 && getQty(symbol) >= units) {
-        holdings[symbol] -= units;
-        if (holdings[symbol] < 1e-9) {
-            holdings.erase(symbol);
+    if (p < end && *p == '.') {
+        for (++p; p < end && std::isdigit(static_cast<unsigned char>(*p)); ++p, ++digits) {
+            if (fracDigits < DECIMALS) {
+                frac = frac * 10 + (*p - '0');
+                ++fracDigits;
+            } else if (fracDigits++ == DECIMALS) {
+                roundUp = (*p >= '5');
+            }
         }
-        return true;
     }
-    return false;
-}
-
-void Wallet::print() const {
-    std::cout << "Cash: $" << std::fixed << std::setprecision(2) << cashBalance << "\n";
-    std::cout << "Holdings:\n";
-    if (holdings.empty()) {
-        std::cout << "  No holdings yet.\n";
-    } else {
-        for (const auto& pair : holdings) {
-            std::cout << "  " << pair.first << ": " << pair.second << " units\n";
+    if (digits == 0 || whole >= std::numeric_limits<std::int64_t>::max() / SCALE) return false;
+    if (p < end) {
+        if (*p != 'e' && *p != 'E') return false;
+        try {
+            std::string text(begin, end);
+            std::size_t used = 0;
+            double value = std::stod(text, &used);
+            if (used != text.size() || std::fabs(value) >= 9e10) return false;
+            out = fromDouble(value);
+            return true;
+        } catch (const std::exception&) {
+            return false;
         }
     }
-}
 
-const std::map<std::string, double>& Wallet::getHoldings() const { return holdings; }
+    for (int d = std::min(fracDigits, static_cast<int>(DECIMALS)); d < DECIMALS; ++d) frac *= 10;
+    std::int64_t ticks = whole * SCALE + frac + (roundUp ? 1 : 0);
+    out = Fixed(negative ? -ticks : ticks);
+    return true;
+}
 
-inline std::ostream& operator<<(std::ostream& os, const Wallet& w) {
-    os << "Cash: $" << std::fixed << std::setprecision(2) << w.cashBalance << "\nHoldings:\n";
-    if (w.holdings.empty()) {
-        os << "  No holdings yet.\n";
-    } else {
-        for (const auto& h : w.holdings) {
-            os << "  " << h.first << ": " << h.second << " units\n";
-        }
+std::string Fixed::toString() const {
+    std::uint64_t magnitude = raw < 0 ? 0 - static_cast<std::uint64_t>(raw) : static_cast<std::uint64_t>(raw);
+    std::string text = std::to_string(magnitude / SCALE);
+    std::uint64_t frac = magnitude % SCALE;
+    if (frac != 0) {
+        std::string digits = std::to_string(frac);
+        digits.insert(0, DECIMALS - digits.size(), '0');
+        digits.erase(digits.find_last_not_of('0') + 1);
+        text += "." + digits;
     }
-    return os;
+    return raw < 0 ? "-" + text : text;
 }
 
-class User {
-private:
-    std::string name;
-    Wallet wallet;
+Fixed Fixed::roundTo(Fixed step) const {
+    if (step.raw <= 0) return *this;
+    return Fixed(roundedQuotient<std::int64_t>(raw, step.raw) * step.raw);
+}
 
-public:
-    User(const std::string& name, double cash = 0.0);
+Fixed Fixed::operator*(Fixed other) const {
+#if defined(__SIZEOF_INT128__)
+    return Fixed(roundedQuotient<__int128>(static_cast<__int128>(raw) * other.raw, SCALE));
+#else
+    return Fixed(static_cast<std::int64_t>(std::llround(static_cast<long double>(raw) * other.raw / SCALE)));
+#endif
+}
 
-    const std::string& getName() const;
-    Wallet& getWallet();
-    const Wallet& getWallet() const;
-    void printSummary() const;
+bool Fixed::checkedMul(Fixed a, Fixed b, Fixed& out) {
+#if defined(__SIZEOF_INT128__)
+    __int128 product = static_cast<__int128>(a.raw) * b.raw;
+    const __int128 limit = static_cast<__int128>(std::numeric_limits<std::int64_t>::max()) * SCALE;
+    if (product > limit || product < -limit) return false;
+    out = Fixed(roundedQuotient<__int128>(product, SCALE));
+#else
+    long double product = static_cast<long double>(a.raw) * b.raw / SCALE;
+    if (std::fabs(product) >= static_cast<long double>(std::numeric_limits<std::int64_t>::max())) return false;
+    out = Fixed(static_cast<std::int64_t>(std::llround(product)));
+#endif
+    return true;
+}
 
-    friend std::ostream& operator<<(std::ostream& os, const User& u);
-};
+bool Fixed::checkedAdd(Fixed a, Fixed b, Fixed& out) {
+    const std::int64_t hi = std::numeric_limits<std::int64_t>::max(), lo = std::numeric_limits<std::int64_t>::min();
+    if (b.raw > 0 ? a.raw > hi - b.raw : a.raw < lo - b.raw) return false;
+    out = Fixed(a.raw + b.raw);
+    return true;
+}
 
-User::User(const std::string& name, double cash) : name(name), wallet(cash) {}
-const std::string& User::getName() const { return name; }
-Wallet& User::getWallet() { return wallet; }
-const Wallet& User::getWallet() const { return wallet; }
+Fixed Fixed::operator/(std::int64_t divisor) const {
+    return Fixed(roundedQuotient<std::int64_t>(raw, divisor));
+}
 
-void User::printSummary() const {
-    std::cout << "\n--- User Portfolio ---\n";
-    std::cout << "Welcome, " << name << "!\n";
-    wallet.print();
-    std::cout << "----------------------\n";
+// Honours std::fixed/setprecision like a double would; otherwise prints the
+// shortest exact decimal.
+std::ostream& operator<<(std::ostream& os, Fixed f) {
+    if (!(os.flags() & std::ios::fixed)) return os << f.toString();
+
+    int precision = static_cast<int>(std::min<std::streamsize>(os.precision(), 18));
+    Fixed shown = f;
+    if (precision < Fixed::DECIMALS) {
+        std::int64_t step = 1;
+        for (int d = precision; d < Fixed::DECIMALS; ++d) step *= 10;
+        shown = f.roundTo(Fixed::fromRaw(step));
+    }
+    std::string text = shown.toString();
+    std::size_t dot = text.find('.');
+    int have = (dot == std::string::npos) ? 0 : static_cast<int>(text.size() - dot - 1);
+    if (have > precision) text.erase(dot + precision + (precision > 0 ? 1 : 0));
+    else {
+        if (dot == std::string::npos && precision > 0) text += '.';
+        text.append(precision - have, '0');
+    }
+    return os << text;
 }
 
-inline std::ostream& operator<<(std::ostream& os, const User& u) {
-    os << "--- User Portfolio ---\n";
-    os << "User: " << u.name << "\n";
-    os << u.wallet;
-    os << "----------------------\n";
-    return os;
+std::istream& operator>>(std::istream& is, Fixed& f) {
+    std::string token;
+    if (is >> token && !Fixed::parse(token, f)) is.setstate(std::ios::failbit);
+    return is;
 }
 
-class Exchange {
+// Read-only view of a whole file: mmap where available, a heap copy elsewhere.
+class MappedFile {
 private:
-    std::vector<Crypto_currency> listings;
+    const char* bytes = nullptr;
+    std::size_t length = 0;
+#if defined(_WIN32)
+    std::vector<char> buffer;
+#endif
 
 public:
-    static int totalTrades;
-
-    void add_crypto_listing(const Crypto_currency& c);
-    Crypto_currency* find(const std::string& symbol);
-    double priceOf(const std::string& symbol);
-    bool isListingsEmpty() const;
-    void print() const;
-    const std::vector<Crypto_currency>& getListings() const;
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    const char* data() const;
+    std::size_t size() const;
 };
 
-int Exchange::totalTrades = 0;
-
-void Exchange::add_crypto_listing(const Crypto_currency& c) { listings.push_back(c); }
-
-Crypto_currency* Exchange::find(const std::string& symbol) {
-    for (auto& crypto : listings) {
-        if (crypto.getSymbol() == symbol) {
-            return &crypto;
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#if defined(_WIN32)
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    buffer.resize(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(buffer.data(), buffer.size())) return false;
+    bytes = buffer.data();
+    length = buffer.size();
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    length = static_cast<std::size_t>(st.st_size);
+    if (length > 0) {
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            length = 0;
+            return false;
         }
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        bytes = static_cast<const char*>(mapped);
     }
-    return nullptr;
-}
-
-double Exchange::priceOf(const std::string& symbol) {
-    Crypto_currency* crypto = find(symbol);
-    return (crypto != nullptr) ? crypto->getPrice() : -1.0;
+    ::close(fd);
+    return true;
+#endif
 }
 
-bool Exchange::isListingsEmpty() const { return listings.empty(); }
-
-void Exchange::print() const {
-    std::cout << "\n--- Crypto Exchange Listings ---\n";
-    for (const auto& c : listings) {
-        std::cout << "  " << std::setw(5) << c.getSymbol()
-                  << "  " << std::setw(12) << c.getName()
-                  << "  $" << std::fixed << std::setprecision(2) << c.getPrice() << "\n";
-    }
-    std::cout << "Total Trades on Exchange: " << totalTrades << "\n";
-    std::cout << "-------------------------------\n";
+void MappedFile::close() {
+#if defined(_WIN32)
+    buffer.clear();
+#else
+    if (bytes) munmap(const_cast<char*>(bytes), length);
+#endif
+    bytes = nullptr;
+    length = 0;
 }
 
-const std::vector<Crypto_currency>& Exchange::getListings() const { return listings; }
-
-class Trade {
-protected:
-    std::string symbol;
-    double units;
+const char* MappedFile::data() const { return bytes; }
+std::size_t MappedFile::size() const { return length; }
 
-public:
-    Trade(const std::string& sym, double u);
-    virtual ~Trade() = default;
-    virtual bool execute(User& user, Exchange& ex) = 0;
-};
+// --- Lock-free queue ---
+constexpr std::size_t CACHE_LINE = 64;
 
-Trade::Trade(const std::string& sym, double u) : symbol(sym), units(u) {}
+// Bounded multi-producer/single-consumer ring. Each cell carries a sequence
+// number, so producers only contend on one fetch of the tail counter.
+template <typename T>
+class MpscQueue {
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T item;
+    };
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+    alignas(CACHE_LINE) std::atomic<std::size_t> tail{0};
+    alignas(CACHE_LINE) std::size_t head = 0; // consumer only
 
-class BuyTrade : public Trade {
 public:
-    BuyTrade(const std::string& sym, double u);
-    bool execute(User& user, Exchange& ex) override;
+    explicit MpscQueue(std::size_t capacity);
+    bool tryPush(const T& item);
+    bool tryPop(T& item);
 };
 
-BuyTrade::BuyTrade(const std::string& sym, double u) : Trade(sym, u) {}
+template <typename T>
+MpscQueue<T>::MpscQueue(std::size_t capacity) {
+    std::size_t size = 2;
+    while (size < capacity) size <<= 1;
+    cells.reset(new Cell[size]);
+    mask = size - 1;
+    for (std::size_t i = 0; i < size; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+}
 
-bool BuyTrade::execute(User& user, Exchange& ex) {
-    double px = ex.priceOf(symbol);
-    if (px < 0) {
-        std::cout << "Symbol not found.\n";
-        return false;
-    }
-    double cost = px * units;
-    if (!user.getWallet().withdraw(cost)) {
-        std::cout << "Insufficient cash to complete purchase.\n";
-        return false;
+template <typename T>
+bool MpscQueue<T>::tryPush(const T& item) {
+    std::size_t pos = tail.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[pos & mask];
+        std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+        std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0) {
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false; // full
+        } else {
+            pos = tail.load(std::memory_order_relaxed);
+        }
     }
-    user.getWallet().addQty(symbol, units);
-    Exchange::totalTrades++;
-    std::cout << "SUCCESS: Bought " << units << " " << symbol << " for $" << std::fixed << std::setprecision(2) << cost << "\n";
+    cell->item = item;
+    cell->sequence.store(pos + 1, std::memory_order_release);
     return true;
 }
 
-class SellTrade : public Trade {
-public:
-    SellTrade(const std::string& sym, double u);
-    bool execute(User& user, Exchange& ex) override;
-};
-
-SellTrade::SellTrade(const std::string& sym, double u) : Trade(sym, u) {}
-
-bool SellTrade::execute(User& user, Exchange& ex) {
-    double px = ex.priceOf(symbol);
-    if (px < 0) {
-        std::cout << "Symbol not found.\n";
-        return false;
-    }
-    if (!user.getWallet().removeQty(symbol, units)) {
-        std::cout << "Insufficient units to sell.\n";
-        return false;
-    }
-    double earnings = px * units;
-    user.getWallet().deposit(earnings);
-    Exchange::totalTrades++;
-    std::cout << "SUCCESS: Sold " << units << " " << symbol << " for $" << std::fixed << std::setprecision(2) << earnings << "\n";
+template <typename T>
+bool MpscQueue<T>::tryPop(T& item) {
+    Cell& cell = cells[head & mask];
+    if (cell.sequence.load(std::memory_order_acquire) != head + 1) return false;
+    item = cell.item;
+    cell.sequence.store(head + mask + 1, std::memory_order_release);
+    ++head;
     return true;
 }
 
-class AuthManager {
+// --- Event log ---
+// Fills and trigger notices are recorded as fixed-size binary events; a
+// background thread formats them for the console and the optional text log,
+// so the trading path neither formats nor makes syscalls. Until start() is
+// called events are formatted inline, as before.
+struct TradeEvent {
+    enum Kind : std::uint8_t { Bought, Sold, LimitTriggered, LimitFailed, BookFill };
+    std::int64_t timestampNs; // steady clock
+    std::int64_t units;       // raw Fixed
+    std::int64_t price;       // raw Fixed, execution price
+    std::int64_t value;       // raw Fixed, cash paid or received
+    std::int64_t orderId;
+    UserId user;
+    SymbolId symbol;
+    Kind kind;
+    bool isBuy;
+    std::uint8_t reserved[6];
+};
+
+static_assert(sizeof(TradeEvent) == 56, "trade event layout changed");
+
+class EventLog {
 private:
-    const std::string user_file = "users.txt";
-    unsigned long simpleHash(const std::string& str) const;
+    MpscQueue<TradeEvent> ring;
+    std::thread writer;
+    std::atomic<bool> running{false};
+    std::atomic<bool> echo{true};
+    std::atomic<std::uint64_t> recorded{0};
+    std::atomic<std::uint64_t> written{0};
+    std::ofstream file;
+
+    static thread_local std::ostream* capture;
+
+    void run();
+    void write(const TradeEvent& event);
 
 public:
-    User* login();
-    User* signUp();
-    void saveUserData(const User& user) const;
-    User* loadUserData(const std::string& username) const;
+    // While one is alive, events recorded on its thread are also formatted
+    // into `os`, so a command's reply carries its own fills whatever the echo.
+    class Capture {
+    private:
+        std::ostream* previous;
+
+    public:
+        explicit Capture(std::ostream& os);
+        ~Capture();
+        Capture(const Capture&) = delete;
+        Capture& operator=(const Capture&) = delete;
+    };
+
+    explicit EventLog(std::size_t capacity = 1 << 16);
+    ~EventLog();
+
+    static EventLog& instance();
+    static std::string format(const TradeEvent& event);
+
+    void start(const std::string& logPath = "");
+    void stop();
+    void setEcho(bool on);
+    void record(TradeEvent event);
+    void flush(); // waits until everything recorded so far is written
 };
 
-// Use a simple deterministic hash (djb2) that returns unsigned long
-unsigned long AuthManager::simpleHash(const std::string& str) const {
-    unsigned long hash = 5381;
-    for (unsigned char c : str) {
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
-    }
-    return hash;
-}
+thread_local std::ostream* EventLog::capture = nullptr;
 
-User* AuthManager::login() {
-    std::string username, password;
+EventLog::Capture::Capture(std::ostream& os) : previous(capture) { capture = &os; }
+EventLog::Capture::~Capture() { capture = previous; }
 
-    try {
-        std::ifstream file(user_file);
-        if (!file) {
-            std::cout << "No users have signed up yet.\n";
-            return nullptr;
-        }
+EventLog::EventLog(std::size_t capacity) : ring(capacity) {}
+EventLog::~EventLog() { stop(); }
 
-        std::cout << "--- User Login ---\n";
-        std::cout << "Enter username: ";
-        std::cin >> username;
-        std::cout << "Enter password: ";
-        std::cout << "if forgot password write 1:";
-        std::cin >> password;
-
-        if (password == "1") {
-            file.clear();
-            file.seekg(0);
-            std::string line;
-            while (std::getline(file, line)) {
-                std::stringstream ss(line);
-                std::string stored_user;
-                unsigned long stored_hash;
-                ss >> stored_user >> stored_hash;
-                if (username == stored_user) {
-                    std::cout << "Stored password hash for user '" << username << "': " << stored_hash << "\n";
-                    break;
-                }
-            }
-            return nullptr;
-        }
+EventLog& EventLog::instance() {
+    static EventLog log;
+    return log;
+}
 
-        std::string line;
-        while (std::getline(file, line)) {
-            if (line.empty()) continue;
-            std::stringstream ss(line);
-            std::string stored_user;
-            unsigned long stored_hash;
-            ss >> stored_user >> stored_hash;
-            if (username == stored_user) {
-                if (simpleHash(password) == stored_hash) {
-                    std::cout << "Login successful! Welcome, " << username << ".\n";
-                    return loadUserData(username);
-                } else {
-                    std::cout << "Invalid password.\n";
-                    return nullptr;
-                }
-            }
-        }
-    } catch (const std::ifstream::failure& e) {
-        std::cerr << "Exception opening/reading user file: " << e.what() << '\n';
-        return nullptr;
+std::string EventLog::format(const TradeEvent& event) {
+    std::ostringstream line;
+    switch (event.kind) {
+        case TradeEvent::Bought:
+        case TradeEvent::Sold:
+            line << "SUCCESS: " << (event.kind == TradeEvent::Bought ? "Bought " : "Sold ")
+                 << Fixed::fromRaw(event.units).toString() << " " << symbolName(event.symbol) << " for $"
+                 << std::fixed << std::setprecision(2) << Fixed::fromRaw(event.value);
+            break;
+        case TradeEvent::LimitTriggered:
+            line << "\n[!] EXECUTING LIMIT ORDER ID: " << event.orderId << " for user " << userName(event.user);
+            break;
+        case TradeEvent::LimitFailed:
+            line << "[!] Limit Order ID " << event.orderId << " failed (insufficient funds/units).";
+            break;
+        case TradeEvent::BookFill:
+            line << "FILL: " << (event.isBuy ? "Bought " : "Sold ") << Fixed::fromRaw(event.units).toString() << " "
+                 << symbolName(event.symbol) << " @ $" << Fixed::fromRaw(event.price).toString()
+                 << " against book order #" << event.orderId;
+            break;
     }
-    std::cout << "User not found.\n";
-    return nullptr;
+    line << '\n';
+    return line.str();
 }
 
-User* AuthManager::signUp() {
-    std::string username, password;
-    std::cout << "--- User Sign Up ---\n";
-    std::cout << "Choose a username: ";
-    std::cin >> username;
-
-    try {
-        std::ifstream infile(user_file);
-        if (infile) {
-            std::string line;
-            while (std::getline(infile, line)) {
-                if (line.empty()) continue;
-                std::stringstream ss(line);
-                std::string stored_user;
-                ss >> stored_user;
-                if (username == stored_user) {
-                    std::cout << "Username already exists. Please try another.\n";
-                    return nullptr;
-                }
-            }
-        }
-        infile.close();
+void EventLog::start(const std::string& logPath) {
+    if (running.load()) return;
+    if (!logPath.empty()) {
+        file.open(logPath, std::ios::app);
+        if (!file) std::cerr << "Error: Could not open event log " << logPath << '\n';
+    }
+    running.store(true);
+    writer = std::thread([this] { run(); });
+}
 
-        std::cout << "Choose a password: \n Password should contain atleast size of 5 having character and digit\n";
-        std::cin >> password;
-        if (password.size() < 5) {
-            std::cout << "Not a valid password\n";
-            return nullptr;
-        }
+void EventLog::stop() {
+    if (!running.exchange(false)) return;
+    writer.join();
+    if (file.is_open()) file.close();
+}
 
-        std::ofstream outfile(user_file, std::ios::app);
-        if (!outfile) {
-            std::cerr << "Error: Could not open user file for writing.\n";
-            return nullptr;
-        }
-        outfile << username << " " << simpleHash(password) << std::endl;
+void EventLog::setEcho(bool on) { echo.store(on); }
 
-        std::cout << "Sign up successful! Welcome, " << username << ".\n";
-        User* newUser = new User(username, 10000.0);
-        saveUserData(*newUser);
-        return newUser;
-    } catch (const std::ios_base::failure& e) {
-        std::cerr << "Exception handling user file: " << e.what() << '\n';
-        return nullptr;
-    }
-     catch (const std::bad_alloc& e) {
-        std::cerr << "Memory allocation failed: " << e.what() << '\n';
-        return nullptr;
+void EventLog::record(TradeEvent event) {
+    event.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (capture) *capture << format(event);
+    if (!running.load(std::memory_order_relaxed)) {
+        write(event);
+        return;
     }
+    recorded.fetch_add(1, std::memory_order_relaxed);
+    // A full ring back-pressures the producer rather than losing fills.
+    while (!ring.tryPush(event)) std::this_thread::yield();
 }
 
-void AuthManager::saveUserData(const User& user) const {
-    std::string filename = user.getName() + "_wallet.csv";
-    try {
-        std::ofstream file(filename);
-        if (!file) {
-             std::cerr << "Error: Could not save user data for " << user.getName() << std::endl;
-             return;
-        }
-
-        file << user.getWallet().getCash() << std::endl;
-        for (const auto& holding : user.getWallet().getHoldings()) {
-            file << holding.first << "," << holding.second << std::endl;
-        }
-    } catch (const std::ofstream::failure& e) {
-        std::cerr << "Exception writing to user wallet file: " << e.what() << '\n';
+void EventLog::flush() {
+    if (!running.load()) return;
+    while (written.load(std::memory_order_acquire) < recorded.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
     }
+    std::cout.flush();
 }
 
-User* AuthManager::loadUserData(const std::string& username) const {
-    std::string filename = username + "_wallet.csv";
-    try {
-        std::ifstream file(filename);
-        if (!file) {
-            User* newUser = new User(username, 10000.0);
-            saveUserData(*newUser);
-            return newUser;
-        }
-
-        double cash;
-        file >> cash;
-        User* user = new User(username, cash);
+void EventLog::write(const TradeEvent& event) {
+    bool toConsole = echo.load(std::memory_order_relaxed);
+    if (!toConsole && !file.is_open()) return;
+    std::string line = format(event);
+    if (toConsole) std::cout << line;
+    if (file.is_open()) file << event.timestampNs << ' ' << (line[0] == '\n' ? line.substr(1) : line);
+}
 
-        std::string line;
-        std::getline(file, line); // Consume rest of the first line
-        while (std::getline(file, line)) {
-            if (line.empty()) continue;
-            std::stringstream ss(line);
-            std::string symbol;
-            double units;
-            std::getline(ss, symbol, ',');
-            ss >> units;
-            if (!symbol.empty()) {
-                user->getWallet().addQty(symbol, units);
-            }
+void EventLog::run() {
+    TradeEvent event;
+    while (true) {
+        if (ring.tryPop(event)) {
+            write(event);
+            written.fetch_add(1, std::memory_order_release);
+        } else if (!running.load(std::memory_order_acquire)) {
+            if (!ring.tryPop(event)) break;
+            write(event);
+            written.fetch_add(1, std::memory_order_release);
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
         }
-        return user;
-    } catch (const std::ifstream::failure& e) {
-        std::cerr << "Exception reading user wallet file: " << e.what() << '\n';
-        return nullptr;
-    } catch (const std::bad_alloc& e) {
-        std::cerr << "Memory allocation failed: " << e.what() << '\n';
-        return nullptr;
     }
+    if (file.is_open()) file.flush();
 }
 
+// --- Latency stats ---
+// HDR-style histograms: 32 linear sub-buckets per power of two ticks, so a
+// recorded value is reported within about 3%. Each thread records into its
+// own set with single-writer relaxed updates; readers merge every set.
+// Build with -DCRYPTO_SIM_NO_LATENCY to compile the probes out.
+
+// The cycle counter on x86 (constant-rate on anything current), steady_clock
+// nanoseconds elsewhere. Ticks become nanoseconds only when printed, scaled
+// by how far both clocks moved since start-up.
+inline std::uint64_t latencyTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
 
-class LimitOrder {
+enum class LatencyProbe : std::uint8_t {
+    BuyTrade,
+    SellTrade,
+    OrdersTick,
+    OrderFill,
+    Login,
+    LoadUser,
+    SaveUser,
+    FlushWallets,
+    SaveOrders,
+    LoadCryptoData,
+    Count
+};
+
+class LatencyHistogram {
 public:
-    int orderId;
-    std::string username;
-    std::string symbol;
-    double units;
-    double desiredPrice;
-    bool isBuyOrder;
+    static constexpr unsigned SUB_BITS = 5;
+    static constexpr unsigned SUB_BUCKETS = 1u << SUB_BITS;
+    static constexpr unsigned MAX_EXPONENT = 42; // about 73 minutes
+    static constexpr std::size_t BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) * SUB_BUCKETS;
 
-    LimitOrder(int id, std::string uname, std::string sym, double u, double price, bool isBuy);
-    void display() const;
+    static std::size_t bucketOf(std::uint64_t ticks);
+    static std::uint64_t highestIn(std::size_t bucket);
 
-    friend std::ostream& operator<<(std::ostream& os, const LimitOrder& lo);
+    void record(std::uint64_t ticks); // owning thread only
+    void mergeInto(std::vector<std::uint64_t>& totals, std::uint64_t& maxTicks) const;
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKETS> counts{};
+    std::atomic<std::uint64_t> maxSeen{0};
 };
 
-LimitOrder::LimitOrder(int id, std::string uname, std::string sym, double u, double price, bool isBuy)
-    : orderId(id), username(std::move(uname)), symbol(std::move(sym)), units(u), desiredPrice(price), isBuyOrder(isBuy) {}
+std::size_t LatencyHistogram::bucketOf(std::uint64_t ticks) {
+    if (ticks < SUB_BUCKETS) return static_cast<std::size_t>(ticks);
+    unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(ticks));
+    if (exponent > MAX_EXPONENT) return BUCKETS - 1;
+    return (exponent - SUB_BITS + 1) * SUB_BUCKETS + ((ticks >> (exponent - SUB_BITS)) - SUB_BUCKETS);
+}
 
-void LimitOrder::display() const {
-    std::cout << "ID: " << std::setw(4) << orderId
-              << " | " << (isBuyOrder ? "BUY " : "SELL")
-              << " | " << std::setw(5) << symbol
-              << " | Units: " << std::setw(8) << std::fixed << std::setprecision(4) << units
-              << " | Target Price: $" << std::setw(10) << std::fixed << std::setprecision(2) << desiredPrice << std::endl;
+std::uint64_t LatencyHistogram::highestIn(std::size_t bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    unsigned shift = static_cast<unsigned>(bucket / SUB_BUCKETS) - 1;
+    std::uint64_t low = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return low + (std::uint64_t(1) << shift) - 1;
 }
 
-inline std::ostream& operator<<(std::ostream& os, const LimitOrder& lo) {
-    os << "ID: " << std::setw(4) << lo.orderId
-       << " | " << (lo.isBuyOrder ? "BUY " : "SELL")
-       << " | " << std::setw(5) << lo.symbol
-       << " | Units: " << std::setw(8) << std::fixed << std::setprecision(4) << lo.units
-       << " | Target Price: $" << std::setw(10) << std::fixed << std::setprecision(2) << lo.desiredPrice;
-    return os;
+void LatencyHistogram::record(std::uint64_t ticks) {
+    std::atomic<std::uint64_t>& count = counts[bucketOf(ticks)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (ticks > maxSeen.load(std::memory_order_relaxed)) maxSeen.store(ticks, std::memory_order_relaxed);
 }
 
-class LimitOrderManager {
-private:
-    std::vector<LimitOrder> orders;
-    const std::string filename = "limit_orders.txt";
-    const std::string id_filename = "order_id.txt";
-    static int nextOrderId;
+void LatencyHistogram::mergeInto(std::vector<std::uint64_t>& totals, std::uint64_t& maxTicks) const {
+    totals.resize(BUCKETS);
+    for (std::size_t i = 0; i < BUCKETS; ++i) totals[i] += counts[i].load(std::memory_order_relaxed);
+    maxTicks = std::max(maxTicks, maxSeen.load(std::memory_order_relaxed));
+}
 
-    void loadNextOrderId();
-    void saveNextOrderId() const;
-    void loadOrders();
-    void saveOrders() const;
+class LatencyStats {
+private:
+    struct ThreadSet {
+        std::array<LatencyHistogram, static_cast<std::size_t>(LatencyProbe::Count)> histograms;
+    };
+
+    mutable std::mutex mutex; // sets and the dump settings
+    std::vector<std::unique_ptr<ThreadSet>> sets; // kept after their thread exits
+    std::string dumpPath;
+    std::chrono::seconds dumpInterval{10};
+    std::condition_variable dumpWake;
+    bool dumping = false;
+    std::thread dumper;
+    const std::chrono::steady_clock::time_point originTime = std::chrono::steady_clock::now();
+    const std::uint64_t originTicks = latencyTicks();
+
+    LatencyStats() = default;
+    ThreadSet& local();
+    bool dump() const;
+    double nsPerTick() const;
 
 public:
-    LimitOrderManager();
-    ~LimitOrderManager();
+    static LatencyStats& instance();
+    static const char* name(LatencyProbe probe);
 
-    void addOrder(const std::string& username, const std::string& symbol, double units, double price, bool isBuy);
-    void displayUserOrders(const std::string& username) const;
-    void checkAndExecuteUserOrders(User& user, Exchange& ex);
-    void checkAndExecuteAllOrders(Exchange& ex, AuthManager& auth);
-};
+    void record(LatencyProbe probe, std::uint64_t ticks);
+    void print(std::ostream& os) const;
 
-int LimitOrderManager::nextOrderId = 1;
+    // Rewrites `path` with the current table every `interval`, and once more
+    // from stopDump.
+    void startDump(const std::string& path, std::chrono::seconds interval);
+    void stopDump();
+};
 
-LimitOrderManager::LimitOrderManager() {
-    try {
-        loadNextOrderId();
-        loadOrders();
-    } catch (const std::exception& e) {
-        std::cerr << "Error during LimitOrderManager initialization: " << e.what() << '\n';
-    }
+LatencyStats& LatencyStats::instance() {
+    static LatencyStats stats;
+    return stats;
 }
 
-LimitOrderManager::~LimitOrderManager() {
-    try {
-        saveNextOrderId();
-    } catch (const std::exception& e) {
-        std::cerr << "Error during LimitOrderManager destruction: " << e.what() << '\n';
-    }
+const char* LatencyStats::name(LatencyProbe probe) {
+    static const char* const names[] = {"trade.buy",      "trade.sell",       "orders.tick",   "orders.fill",
+                                        "auth.login",     "auth.load_user",   "auth.save_user", "wallets.flush",
+                                        "orders.save",    "io.load_crypto_data"};
+    return names[static_cast<std::size_t>(probe)];
 }
 
-void LimitOrderManager::loadNextOrderId() {
-    try {
-        std::ifstream idFile(id_filename);
-        if (idFile) idFile >> nextOrderId;
-        if (nextOrderId == 0) nextOrderId = 1;
-    } catch (const std::ifstream::failure& e) {
-        std::cerr << "Exception loading next order ID: " << e.what() << '\n';
+LatencyStats::ThreadSet& LatencyStats::local() {
+    thread_local ThreadSet* set = nullptr;
+    if (!set) {
+        std::unique_ptr<ThreadSet> fresh(new ThreadSet());
+        set = fresh.get();
+        std::lock_guard<std::mutex> lock(mutex);
+        sets.push_back(std::move(fresh));
     }
+    return *set;
 }
 
-void LimitOrderManager::saveNextOrderId() const {
-    try {
-        std::ofstream idFile(id_filename);
-        if (idFile) idFile << nextOrderId;
-    } catch (const std::ofstream::failure& e) {
-        std::cerr << "Exception saving next order ID: " << e.what() << '\n';
-    }
+void LatencyStats::record(LatencyProbe probe, std::uint64_t ticks) {
+    local().histograms[static_cast<std::size_t>(probe)].record(ticks);
 }
 
-void LimitOrderManager::loadOrders() {
-    orders.clear();
-    try {
-        std::ifstream file(filename);
-        if (!file) return;
+double LatencyStats::nsPerTick() const {
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - originTime).count();
+    std::uint64_t ticks = latencyTicks() - originTicks;
+    return ticks > 0 && ns > 0 ? ns / static_cast<double>(ticks) : 1.0;
+}
 
-        int id, isBuyInt;
-        std::string username, symbol;
-        double units, price;
-        while (file >> id >> username >> symbol >> units >> price >> isBuyInt) {
-            orders.emplace_back(id, username, symbol, units, price, (isBuyInt == 1));
+void LatencyStats::print(std::ostream& os) const {
+    std::vector<std::uint64_t> totals;
+    const double usPerTick = nsPerTick() / 1000.0;
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << "\n--- Latency (us) ---\n"
+       << std::left << std::setw(22) << "probe" << std::right << std::setw(12) << "count" << std::setw(11) << "p50"
+       << std::setw(11) << "p99" << std::setw(11) << "p999" << std::setw(12) << "max" << "\n";
+    for (std::size_t p = 0; p < static_cast<std::size_t>(LatencyProbe::Count); ++p) {
+        totals.assign(LatencyHistogram::BUCKETS, 0);
+        std::uint64_t maxTicks = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& set : sets) set->histograms[p].mergeInto(totals, maxTicks);
+        }
+        std::uint64_t count = 0;
+        for (std::uint64_t c : totals) count += c;
+        auto percentile = [&](double q) {
+            std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(q * count)), seen = 0;
+            for (std::size_t i = 0; i < totals.size(); ++i) {
+                seen += totals[i];
+                if (seen >= std::max<std::uint64_t>(rank, 1)) return std::min(LatencyHistogram::highestIn(i), maxTicks) * usPerTick;
+            }
+            return maxTicks * usPerTick;
+        };
+        os << std::left << std::setw(22) << name(static_cast<LatencyProbe>(p)) << std::right << std::setw(12) << count
+           << std::fixed << std::setprecision(2);
+        if (count == 0) {
+            os << std::setw(11) << "-" << std::setw(11) << "-" << std::setw(11) << "-" << std::setw(12) << "-" << "\n";
+        } else {
+            os << std::setw(11) << percentile(0.50) << std::setw(11) << percentile(0.99) << std::setw(11)
+               << percentile(0.999) << std::setw(12) << maxTicks * usPerTick << "\n";
         }
-    } catch (const std::ifstream::failure& e) {
-        std::cerr << "Exception loading limit orders: " << e.what() << '\n';
     }
+#if defined(CRYPTO_SIM_NO_LATENCY)
+    os << "(latency probes were compiled out)\n";
+#endif
+    os.flags(flags);
+    os.precision(precision);
 }
 
-void LimitOrderManager::saveOrders() const {
-    try {
-        std::ofstream file(filename);
-        if (!file) return;
-
-        for (const auto& order : orders) {
-            file << order.orderId << " " << order.username << " " << order.symbol << " "
-                 << order.units << " " << order.desiredPrice << " " << (order.isBuyOrder ? 1 : 0) << std::endl;
-        }
-    } catch (const std::ofstream::failure& e) {
-        std::cerr << "Exception saving limit orders: " << e.what() << '\n';
+bool LatencyStats::dump() const {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        path = dumpPath;
+    }
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file) return false;
+        print(file);
+        if (!file.flush()) return false;
     }
+    std::error_code error;
+    std::filesystem::rename(tmp_path, path, error);
+    return !error;
 }
 
-void LimitOrderManager::addOrder(const std::string& username, const std::string& symbol, double units, double price, bool isBuy) {
-    try {
-        orders.emplace_back(nextOrderId++, username, symbol, units, price, isBuy);
-        saveOrders();
-        std::cout << "Limit order placed successfully.\n";
-    } catch (const std::bad_alloc& e) {
-        std::cerr << "Memory allocation failed for new order: " << e.what() << '\n';
+void LatencyStats::startDump(const std::string& path, std::chrono::seconds interval) {
+    stopDump();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dumpPath = path;
+        dumpInterval = interval;
+        dumping = true;
     }
+    dumper = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (dumping) {
+            if (dumpWake.wait_for(lock, dumpInterval, [this] { return !dumping; })) break;
+            lock.unlock();
+            if (!dump()) std::cerr << "Warning: could not write latency stats\n";
+            lock.lock();
+        }
+    });
 }
 
-void LimitOrderManager::displayUserOrders(const std::string& username) const {
-    std::cout << "\n--- Your Pending Limit Orders ---\n";
-    bool found = false;
-    for (const auto& order : orders) {
-        if (order.username == username) {
-            order.display();
-            found = true;
-        }
+void LatencyStats::stopDump() {
+    if (!dumper.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dumping = false;
     }
-    if (!found) std::cout << "You have no pending limit orders.\n";
+    dumpWake.notify_all();
+    dumper.join();
+    if (!dump()) std::cerr << "Warning: could not write latency stats\n";
 }
 
-void LimitOrderManager::checkAndExecuteUserOrders(User& user, Exchange& ex) {
-    bool ordersChanged = false;
-    try {
-        auto it = std::remove_if(orders.begin(), orders.end(), [&](LimitOrder& order) {
-            if (order.username != user.getName()) return false;
+// Records the lifetime of the enclosing scope under one probe.
+class LatencyTimer {
+private:
+    LatencyProbe probe;
+    std::uint64_t started;
 
-            double currentPrice = ex.priceOf(order.symbol);
-            if (currentPrice < 0) return false;
+public:
+    explicit LatencyTimer(LatencyProbe probe) : probe(probe), started(latencyTicks()) {}
+    ~LatencyTimer() { LatencyStats::instance().record(probe, latencyTicks() - started); }
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+};
 
-            bool shouldExecute = (order.isBuyOrder && currentPrice <= order.desiredPrice) ||
-                                 (!order.isBuyOrder && currentPrice >= order.desiredPrice);
+#if defined(CRYPTO_SIM_NO_LATENCY)
+#define LATENCY_SCOPE(probe) ((void)0)
+#else
+#define LATENCY_SCOPE_JOIN2(a, b) a##b
+#define LATENCY_SCOPE_JOIN(a, b) LATENCY_SCOPE_JOIN2(a, b)
+#define LATENCY_SCOPE(probe) LatencyTimer LATENCY_SCOPE_JOIN(latencyScope, __LINE__)(probe)
+#endif
+
+// --- Trade stats ---
+// Per-symbol totals over every fill: count, base and quote volume (VWAP is
+// their ratio), the last price, and a 24h high/low kept as 24 hourly ranges,
+// so the window rolls forward an hour at a time. Totals are kept for the
+// session only.
+//
+// Each thread owns one padded slot per symbol and records a fill in O(1)
+// under a per-slot sequence lock that only readers ever retry on. Readers
+// keep a running aggregate per symbol and fold in just what each slot gained
+// since the previous fold; the 24h range is redone only when the fold brought
+// new fills or the hour rolled over.
+
+// An exact non-negative running total that can outgrow Fixed (whose raw
+// int64 wraps near 92 billion): whole units plus ticks below Fixed::SCALE.
+class Amount {
+private:
+    std::int64_t whole = 0;
+    std::int64_t ticks = 0;
 
-            if (shouldExecute) {
-                std::cout << "\n[!] EXECUTING YOUR LIMIT ORDER ID: " << order.orderId << std::endl;
-                bool success = order.isBuyOrder ? BuyTrade(order.symbol, order.units).execute(user, ex)
-                                                : SellTrade(order.symbol, order.units).execute(user, ex);
-                if (success) ordersChanged = true;
-                else std::cout << "[!] Limit Order ID " << order.orderId << " failed (insufficient funds/units).\n";
-                return success;
-            }
-            return false;
-        });
+public:
+    Amount() = default;
+    Amount(std::int64_t whole, std::int64_t ticks);
 
-        if (ordersChanged) {
-            orders.erase(it, orders.end());
-            saveOrders();
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "An unexpected error occurred while checking user orders: " << e.what() << '\n';
+    std::int64_t getWhole() const { return whole; }
+    std::int64_t getTicks() const { return ticks; }
+    long double toLongDouble() const;
+    std::string toString() const;
+
+    Amount& operator+=(Fixed amount);
+    Amount& operator+=(const Amount& other);
+    Amount operator-(const Amount& other) const; // other must not exceed this
+    bool operator==(const Amount& other) const { return whole == other.whole && ticks == other.ticks; }
+
+    friend std::ostream& operator<<(std::ostream& os, const Amount& a);
+};
+
+Amount::Amount(std::int64_t w, std::int64_t t) : whole(w + t / Fixed::SCALE), ticks(t % Fixed::SCALE) {
+    if (ticks < 0) {
+        ticks += Fixed::SCALE;
+        --whole;
     }
 }
 
-void LimitOrderManager::checkAndExecuteAllOrders(Exchange& ex, AuthManager& auth) {
-    bool ordersChanged = false;
-    try {
-        auto it = std::remove_if(orders.begin(), orders.end(), [&](LimitOrder& order) {
-            double currentPrice = ex.priceOf(order.symbol);
-            if (currentPrice < 0) return false;
+long double Amount::toLongDouble() const {
+    return static_cast<long double>(whole) + static_cast<long double>(ticks) / Fixed::SCALE;
+}
 
-            bool shouldExecute = (order.isBuyOrder && currentPrice <= order.desiredPrice) ||
-                                 (!order.isBuyOrder && currentPrice >= order.desiredPrice);
+std::string Amount::toString() const {
+    std::string text = std::to_string(whole);
+    if (ticks != 0) text += Fixed::fromRaw(ticks).toString().substr(1);
+    return text;
+}
 
-            if (shouldExecute) {
-                User* owner = auth.loadUserData(order.username);
-                if (!owner) return false;
+Amount& Amount::operator+=(Fixed amount) { return *this = Amount(whole, ticks + amount.getRaw()); }
+Amount& Amount::operator+=(const Amount& other) { return *this = Amount(whole + other.whole, ticks + other.ticks); }
+Amount Amount::operator-(const Amount& other) const { return Amount(whole - other.whole, ticks - other.ticks); }
+
+// Honours std::fixed/setprecision the way Fixed does.
+std::ostream& operator<<(std::ostream& os, const Amount& a) {
+    if (!(os.flags() & std::ios::fixed)) return os << a.toString();
+    int precision = static_cast<int>(std::min<std::streamsize>(os.precision(), 18));
+    std::int64_t step = 1;
+    for (int d = precision; d < Fixed::DECIMALS; ++d) step *= 10;
+    Amount shown(a.whole, (a.ticks + step / 2) / step * step);
+    std::string text = std::to_string(shown.whole);
+    if (precision > 0) {
+        std::string digits = std::to_string(Fixed::SCALE + shown.ticks).substr(1);
+        digits.resize(static_cast<std::size_t>(precision), '0');
+        text += "." + digits;
+    }
+    return os << text;
+}
 
-                std::cout << "\n[!] EXECUTING GLOBAL LIMIT ORDER ID: " << order.orderId << " for user " << order.username << std::endl;
-                bool success = order.isBuyOrder ? BuyTrade(order.symbol, order.units).execute(*owner, ex)
-                                                : SellTrade(order.symbol, order.units).execute(*owner, ex);
+struct TradeSummary {
+    std::uint64_t count = 0;
+    Amount baseVolume;
+    Amount quoteVolume;
+    Fixed lastPrice;
+    Fixed high; // over the last 24h; zero when nothing traded in that time
+    Fixed low;
 
-                if (success) {
-                    auth.saveUserData(*owner);
-                    ordersChanged = true;
-                } else {
-                    std::cout << "[!] Global Limit Order ID " << order.orderId << " failed.\n";
-                }
-                delete owner;
-                return success;
-            }
-            return false;
-        });
+    Fixed vwap() const;
+};
 
-        if (ordersChanged) {
-            orders.erase(it, orders.end());
-            saveOrders();
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "An unexpected error occurred while checking all orders: " << e.what() << '\n';
-    }
+Fixed TradeSummary::vwap() const {
+    if (count == 0) return Fixed();
+    long double ratio = quoteVolume.toLongDouble() / baseVolume.toLongDouble();
+    return Fixed::fromRaw(static_cast<std::int64_t>(std::llround(ratio * Fixed::SCALE)));
 }
 
-void clearInput() {
-    std::cin.clear();
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+class TradeStats {
+public:
+    static constexpr std::int64_t HOUR_MS = 3600000;
+    static constexpr std::size_t WINDOW_HOURS = 24;
+
+private:
+    struct HourRange {
+        std::atomic<std::int64_t> hour{-1};
+        std::atomic<std::int64_t> high{0};
+        std::atomic<std::int64_t> low{0};
+    };
+
+    // Written only by its thread; `version` is odd while a fill is going in.
+    struct alignas(64) Slot {
+        std::atomic<std::uint32_t> version{0};
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<std::int64_t> baseWhole{0}, baseTicks{0};
+        std::atomic<std::int64_t> quoteWhole{0}, quoteTicks{0};
+        std::atomic<std::int64_t> lastPrice{0};
+        std::atomic<std::int64_t> lastTimeMs{0};
+        std::array<HourRange, WINDOW_HOURS> hours;
+    };
+
+    // A consistent copy of a slot, plus what the aggregate has taken from it.
+    struct Folded {
+        std::uint64_t count = 0;
+        Amount base, quote;
+        std::int64_t lastPrice = 0, lastTimeMs = 0;
+        std::array<std::int64_t, WINDOW_HOURS> hour{}, high{}, low{};
+    };
+
+    struct ThreadSet {
+        std::vector<std::unique_ptr<Slot>> slots; // indexed by SymbolId; grown under the mutex
+        std::vector<Folded> folded;               // readers only, under the mutex
+    };
+
+    struct Aggregate {
+        TradeSummary summary;
+        std::int64_t lastTimeMs = -1;
+        std::array<std::int64_t, WINDOW_HOURS> hour, high, low;
+        std::int64_t windowHour = -1; // hour `summary.high/low` were taken at
+        bool rangeStale = false;
+
+        Aggregate() { hour.fill(-1); }
+    };
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadSet>> sets; // kept after their thread exits
+    mutable std::vector<Aggregate> aggregates;    // indexed by SymbolId
+
+    TradeStats() = default;
+    Slot& slot(SymbolId symbol);
+    static void read(const Slot& slot, Folded& out);
+
+public:
+    static TradeStats& instance();
+    TradeStats(const TradeStats&) = delete;
+    TradeStats& operator=(const TradeStats&) = delete;
+
+    void record(SymbolId symbol, Fixed price, Fixed units, std::int64_t timeMs);
+    TradeSummary summary(SymbolId symbol, std::int64_t nowMs) const;
+};
+
+TradeStats& TradeStats::instance() {
+    static TradeStats stats;
+    return stats;
 }
 
-template <typename T>
-T getNumericInput(const std::string& prompt) {
-    T value;
-    std::cout << prompt;
-    while (!(std::cin >> value)) {
-        std::cout << "Wrong input, enter a numeric value: ";
-        clearInput();
+TradeStats::Slot& TradeStats::slot(SymbolId symbol) {
+    thread_local ThreadSet* set = nullptr;
+    if (!set) {
+        std::unique_ptr<ThreadSet> fresh(new ThreadSet());
+        set = fresh.get();
+        std::lock_guard<std::mutex> lock(mutex);
+        sets.push_back(std::move(fresh));
     }
-    return value;
+    if (symbol >= set->slots.size() || !set->slots[symbol]) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (symbol >= set->slots.size()) set->slots.resize(symbol + 1);
+        set->slots[symbol].reset(new Slot());
+    }
+    return *set->slots[symbol];
 }
 
-void saveCryptoData(const Exchange& ex) {
-    try {
-        std::ofstream file("crypto_data.csv");
-        if (!file) return;
+void TradeStats::record(SymbolId symbol, Fixed price, Fixed units, std::int64_t timeMs) {
+    // Data stores are release so a reader that sees any of them also sees the
+    // odd version before them; on x86 these are plain stores.
+    constexpr auto relaxed = std::memory_order_relaxed;
+    constexpr auto release = std::memory_order_release;
+    auto add = [](std::atomic<std::int64_t>& whole, std::atomic<std::int64_t>& ticks, Fixed amount) {
+        Amount sum(whole.load(relaxed), ticks.load(relaxed));
+        sum += amount;
+        whole.store(sum.getWhole(), release);
+        ticks.store(sum.getTicks(), release);
+    };
+    Slot& s = slot(symbol);
+    const std::uint32_t version = s.version.load(relaxed);
+    s.version.store(version + 1, relaxed);
+
+    s.count.store(s.count.load(relaxed) + 1, release);
+    add(s.baseWhole, s.baseTicks, units);
+    add(s.quoteWhole, s.quoteTicks, price * units);
+    s.lastPrice.store(price.getRaw(), release);
+    s.lastTimeMs.store(timeMs, release);
+    const std::int64_t hour = timeMs / HOUR_MS;
+    HourRange& range = s.hours[static_cast<std::size_t>(hour) % WINDOW_HOURS];
+    if (range.hour.load(relaxed) != hour) {
+        range.hour.store(hour, release);
+        range.high.store(price.getRaw(), release);
+        range.low.store(price.getRaw(), release);
+    } else if (price.getRaw() > range.high.load(relaxed)) {
+        range.high.store(price.getRaw(), release);
+    } else if (price.getRaw() < range.low.load(relaxed)) {
+        range.low.store(price.getRaw(), release);
+    }
 
-        for (const auto& crypto : ex.getListings()) {
-            file << crypto.getName() << "," << crypto.getSymbol() << "," << crypto.getPrice() << std::endl;
+    s.version.store(version + 2, std::memory_order_release);
+}
+
+void TradeStats::read(const Slot& s, Folded& out) {
+    constexpr auto acquire = std::memory_order_acquire;
+    while (true) {
+        std::uint32_t before = s.version.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
         }
-    } catch (const std::ofstream::failure& e) {
-        std::cerr << "Exception writing to crypto data file: " << e.what() << '\n';
+        out.count = s.count.load(acquire);
+        out.base = Amount(s.baseWhole.load(acquire), s.baseTicks.load(acquire));
+        out.quote = Amount(s.quoteWhole.load(acquire), s.quoteTicks.load(acquire));
+        out.lastPrice = s.lastPrice.load(acquire);
+        out.lastTimeMs = s.lastTimeMs.load(acquire);
+        for (std::size_t i = 0; i < WINDOW_HOURS; ++i) {
+            out.hour[i] = s.hours[i].hour.load(acquire);
+            out.high[i] = s.hours[i].high.load(acquire);
+            out.low[i] = s.hours[i].low.load(acquire);
+        }
+        if (s.version.load(std::memory_order_relaxed) == before) return;
     }
 }
 
-void loadCryptoData(Exchange& ex) {
-    try {
-        std::ifstream file("crypto_data.csv");
-        if (!file) return;
-
-        std::string line;
-        while (std::getline(file, line)) {
-            if (line.empty()) continue;
-            std::stringstream ss(line);
-            std::string name, symbol, price_str;
-            std::getline(ss, name, ',');
-            std::getline(ss, symbol, ',');
-            std::getline(ss, price_str);
-            if (!name.empty() && !symbol.empty() && !price_str.empty()) {
-                try {
-                    ex.add_crypto_listing(Crypto_currency(name, symbol, std::stod(price_str)));
-                } catch (const std::invalid_argument& ia) {
-                    std::cerr << "Invalid argument: " << ia.what() << " for price: " << price_str << '\n';
-                } catch (const std::out_of_range& oor) {
-                    std::cerr << "Out of Range error: " << oor.what() << " for price: " << price_str << '\n';
-                }
+TradeSummary TradeStats::summary(SymbolId symbol, std::int64_t nowMs) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (symbol >= aggregates.size()) aggregates.resize(symbol + 1);
+    Aggregate& agg = aggregates[symbol];
+    Folded now;
+    for (const auto& set : sets) {
+        if (symbol >= set->slots.size() || !set->slots[symbol]) continue;
+        if (set->folded.size() < set->slots.size()) set->folded.resize(set->slots.size());
+        Folded& seen = set->folded[symbol];
+        if (set->slots[symbol]->count.load(std::memory_order_relaxed) == seen.count) continue;
+        read(*set->slots[symbol], now);
+
+        agg.summary.count += now.count - seen.count;
+        agg.summary.baseVolume += now.base - seen.base;
+        agg.summary.quoteVolume += now.quote - seen.quote;
+        if (now.lastTimeMs >= agg.lastTimeMs) {
+            agg.lastTimeMs = now.lastTimeMs;
+            agg.summary.lastPrice = Fixed::fromRaw(now.lastPrice);
+        }
+        // Ranges merge by max/min within the same hour, so folding one twice is harmless.
+        for (std::size_t i = 0; i < WINDOW_HOURS; ++i) {
+            if (now.hour[i] < agg.hour[i]) continue;
+            if (now.hour[i] > agg.hour[i]) {
+                agg.hour[i] = now.hour[i];
+                agg.high[i] = now.high[i];
+                agg.low[i] = now.low[i];
+            } else {
+                agg.high[i] = std::max(agg.high[i], now.high[i]);
+                agg.low[i] = std::min(agg.low[i], now.low[i]);
             }
         }
-    } catch (const std::ifstream::failure& e) {
-        std::cerr << "Exception reading crypto data file: " << e.what() << '\n';
+        agg.rangeStale = true;
+        seen = now;
     }
-}
 
-void seedExchange(Exchange& ex) {
-    ex.add_crypto_listing(Crypto_currency("Bitcoin", "BTC", 60000.0));
-    ex.add_crypto_listing(Crypto_currency("Ether", "ETH", 2500.0));
-    ex.add_crypto_listing(Crypto_currency("Solana", "SOL", 150.0));
+    const std::int64_t nowHour = nowMs / HOUR_MS;
+    if (agg.rangeStale || agg.windowHour != nowHour) {
+        std::int64_t high = std::numeric_limits<std::int64_t>::min(), low = std::numeric_limits<std::int64_t>::max();
+        for (std::size_t i = 0; i < WINDOW_HOURS; ++i) {
+            if (agg.hour[i] < 0 || agg.hour[i] > nowHour || agg.hour[i] <= nowHour - std::int64_t(WINDOW_HOURS)) continue;
+            high = std::max(high, agg.high[i]);
+            low = std::min(low, agg.low[i]);
+        }
+        agg.summary.high = low <= high ? Fixed::fromRaw(high) : Fixed();
+        agg.summary.low = low <= high ? Fixed::fromRaw(low) : Fixed();
+        agg.windowHour = nowHour;
+        agg.rangeStale = false;
+    }
+    return agg.summary;
 }
 
-void adminMenu(Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager) {
-    while (true) {
-        std::cout << "\n--- Admin Menu ---\n"
-                  << "1) Update Crypto Price\n"
-                  << "0) Logout\n> ";
-        int choice = getNumericInput<int>("");
+class Crypto_currency {
+private:
+    std::string name;
+    std::string symbol;
+    SymbolId id;
+    Fixed price;
+    Fixed tickSize; // smallest price increment
+    Fixed lotSize;  // smallest tradable quantity
 
-        if (choice == 0) break;
+public:
+    static const Fixed DEFAULT_TICK;
+    static const Fixed DEFAULT_LOT;
 
-        if (choice == 1) {
-            std::string sym;
-            std::cout << "Update % for which symbol? ";
-            std::cin >> sym;
-            double pct = getNumericInput<double>("Percent change (+/-): ");
-            int inc = getNumericInput<int>("Increase? (1=yes, 0=no): ");
+    Crypto_currency(const std::string& name, const std::string& symbol, Fixed price,
+                    Fixed tickSize = DEFAULT_TICK, Fixed lotSize = DEFAULT_LOT);
 
-            Crypto_currency* crypto = ex.find(sym);
-            if (crypto) {
-                double p = crypto->getPrice();
-                double delta = p * (pct / 100.0);
-                crypto->setPrice(inc == 1 ? p + delta : p - delta);
-                std::cout << "[OK] " << sym << " is now $" << crypto->getPrice() << "\n";
+    const std::string& getName() const;
+    const std::string& getSymbol() const;
+    SymbolId getId() const;
+    Fixed getPrice() const;
+    void setPrice(Fixed newPrice);
+    Fixed getTickSize() const;
+    Fixed getLotSize() const;
+    // Positive and on the lot (and tick) grid.
+    bool acceptsUnits(Fixed units) const;
+    bool acceptsLimit(Fixed units, Fixed limitPrice) const;
+
+    bool operator==(const Crypto_currency& other) const { return id == other.id; }
+    bool operator!=(const Crypto_currency& other) const { return !(*this == other); }
 
-                std::cout << "Checking all pending limit orders against new price...\n";
-                limitManager.checkAndExecuteAllOrders(ex, auth);
+    friend std::ostream& operator<<(std::ostream& os, const Crypto_currency& c);
+};
 
-            } else {
-                std::cout << "[ERR] Symbol not found\n";
-            }
-        } else {
-            std::cout << "Unknown option.\n";
-        }
-    }
+// A 0.01 tick times a 0.000001 lot is exactly 1e-8, so every price * units
+// product is representable without rounding.
+const Fixed Crypto_currency::DEFAULT_TICK = Fixed::fromRaw(Fixed::SCALE / 100);
+const Fixed Crypto_currency::DEFAULT_LOT = Fixed::fromRaw(Fixed::SCALE / 1000000);
+
+Crypto_currency::Crypto_currency(const std::string& name, const std::string& symbol, Fixed price,
+                                 Fixed tickSize, Fixed lotSize)
+    : name(name), symbol(symbol), id(SymbolRegistry::instance().intern(symbol)), price(price),
+      tickSize(tickSize), lotSize(lotSize) {}
+
+const std::string& Crypto_currency::getName() const { return name; }
+const std::string& Crypto_currency::getSymbol() const { return symbol; }
+SymbolId Crypto_currency::getId() const { return id; }
+Fixed Crypto_currency::getPrice() const { return price; }
+void Crypto_currency::setPrice(Fixed newPrice) { price = newPrice; }
+Fixed Crypto_currency::getTickSize() const { return tickSize; }
+Fixed Crypto_currency::getLotSize() const { return lotSize; }
+
+bool Crypto_currency::acceptsUnits(Fixed units) const {
+    return units > Fixed() && units.isMultipleOf(lotSize);
 }
 
-void userMenu(User& user, Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager) {
-    while (true) {
-        try {
-            limitManager.checkAndExecuteUserOrders(user, ex);
+bool Crypto_currency::acceptsLimit(Fixed units, Fixed limitPrice) const {
+    return acceptsUnits(units) && limitPrice > Fixed() && limitPrice.isMultipleOf(tickSize);
+}
 
-            std::cout << "\n=========== USER MENU ============\n"
-                      << "1) List Market\n"
-                      << "2) View Portfolio\n"
-                      << "3) Deposit Funds\n"
-                      << "4) Buy Crypto (Market Order)\n"
-                      << "5) Sell Crypto (Market Order)\n"
-                      << "6) Place Limit Order\n"
-                      << "7) View My Limit Orders\n"
-                      << "0) Save & Logout\n> ";
-            int choice = getNumericInput<int>("");
+inline std::ostream& operator<<(std::ostream& os, const Crypto_currency& c) {
+    os << c.getSymbol() << " (" << c.getName() << ") $" << std::fixed << std::setprecision(2) << c.getPrice();
+    return os;
+}
 
-            if (choice == 0) {
-                auth.saveUserData(user);
-                std::cout << "Data saved. Logging out.\n";
-                break;
-            }
+class Wallet {
+public:
+    using Holding = std::pair<SymbolId, Fixed>;
 
-            switch (choice) {
-                case 1: ex.print(); break;
-                case 2: user.printSummary(); break;
-                case 3: {
-                    double amt = getNumericInput<double>("Enter amount to deposit: ");
-                    user.getWallet().deposit(amt);
-                    std::cout << "[OK] Deposited. New cash: $" << user.getWallet().getCash() << "\n";
-                    break;
-                }
-                case 4: {
-                    std::string sym;
-                    std::cout << "Enter symbol to BUY (e.g., ETH): ";
-                    std::cin >> sym;
-                    double units = getNumericInput<double>("Enter units to buy: ");
-                    BuyTrade(sym, units).execute(user, ex);
-                    break;
-                }
-                case 5: {
-                    std::string sym;
-                    std::cout << "Enter symbol to SELL (e.g., ETH): ";
-                    std::cin >> sym;
-                    double units = getNumericInput<double>("Enter units to sell: ");
-                    SellTrade(sym, units).execute(user, ex);
-                    break;
-                }
-                case 6: {
-                    std::string sym;
-                    std::cout << "Place a new Limit Order\n";
-                    std::cout << "Enter symbol (e.g., BTC): ";
-                    std::cin >> sym;
+private:
+    Fixed cashBalance;
+    std::vector<Holding> holdings; // sorted by symbol id
+    bool dirty = false;            // changed since the last markClean()
 
-                    if (ex.find(sym) == nullptr) {
-                        std::cout << "Error: Symbol '" << sym << "' is not listed on the market.\n";
-                        continue;
-                    }
-                    double units = getNumericInput<double>("Enter units: ");
-                    double price = getNumericInput<double>("Enter target price: $");
-                    int type = getNumericInput<int>("Is this a BUY or SELL order? (1 for Buy, 2 for Sell): ");
+    std::vector<Holding>::iterator holdingOf(SymbolId symbol);
 
-                    if (type == 1 || type == 2) {
-                        limitManager.addOrder(user.getName(), sym, units, price, (type == 1));
-                    } else {
-                        std::cout << "Invalid order type.\n";
-                    }
-                    break;
-                }
-                case 7: {
-                    limitManager.displayUserOrders(user.getName());
-                    break;
-                }
-                default:
-                    std::cout << "Unknown option.\n";
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "An error occurred in the user menu: " << e.what() << '\n';
-            clearInput(); // Clear any bad input
-        }
-    }
-}
+public:
+    Wallet() : cashBalance() {}
+    explicit Wallet(Fixed initialCash) : cashBalance(initialCash) {}
 
-// --- Main Application ---
-int main() {
-    try {
-        Exchange ex;
-        AuthManager auth;
-        LimitOrderManager limitManager;
+    Fixed getCash() const;
+    bool deposit(Fixed amount); // false if not positive or the balance would overflow
+    bool withdraw(Fixed amount);
 
-        loadCryptoData(ex);
-        if (ex.isListingsEmpty()) {
-            seedExchange(ex);
-        }
+    Fixed getQty(SymbolId symbol) const;
+    bool addQty(SymbolId symbol, Fixed units);
+    bool removeQty(SymbolId symbol, Fixed units);
 
-        std::cout << "====== Crypto Trading Simulator ======\n";
+    Fixed getQty(const std::string& symbol) const;
+    bool addQty(const std::string& symbol, Fixed units);
+    bool removeQty(const std::string& symbol, Fixed units);
 
-        while (true) {
-            std::cout << "\n--- Welcome ---\n"
-                      << "1. Admin Login\n"
-                      << "2. User Login\n"
-                      << "3. User Sign Up\n"
-                      << "0. Exit\n> ";
-            int choice;
-
-            if (!(std::cin >> choice)) {
-                std::cout << "Invalid input. Please enter a number.\n";
-                clearInput();
-                continue;
-            }
+    // Applies signed cash and unit deltas without validation; only for
+    // reversing a change this wallet has already accepted.
+    void adjust(SymbolId symbol, Fixed cash, Fixed units);
 
-            if (choice == 0) {
-                break;
-            }
+    void print(std::ostream& os = std::cout) const;
+    const std::vector<Holding>& getHoldings() const;
+    bool isDirty() const;
+    void markClean();
 
-            switch(choice) {
-                case 1: {
-                    std::string user, pass;
-                    std::cout << "--- Admin Login ---\n";
-                    std::cout << "Username: "; std::cin >> user;
-                    std::cout << "Password: "; std::cin >> pass;
-                    if (user == "admin" && pass == "letmein") {
-                        std::cout << "Admin login successful.\n";
-                        adminMenu(ex, auth, limitManager);
+    Wallet& operator+=(Fixed amount) { deposit(amount); return *this; }
+    Wallet& operator-=(Fixed amount) { withdraw(amount); return *this; }
+
+    Wallet& operator+=(const std::pair<std::string,Fixed>& asset) { addQty(asset.first, asset.second); return *this; }
+    Wallet& operator-=(const std::pair<std::string,Fixed>& asset) { removeQty(asset.first, asset.second); return *this; }
+
+    bool operator==(const Wallet& other) const { return cashBalance == other.cashBalance && holdings == other.holdings; }
+    bool operator!=(const Wallet& other) const { return !(*this == other); }
+
+    friend std::ostream& operator<<(std::ostream& os, const Wallet& w);
+};
+
+Fixed Wallet::getCash() const { return cashBalance; }
+
+bool Wallet::deposit(Fixed amount) {
+    if (amount <= Fixed() || !Fixed::checkedAdd(cashBalance, amount, cashBalance)) return false;
+    dirty = true;
+    return true;
+}
+
+bool Wallet::withdraw(Fixed amount) {
+    if (amount > Fixed() && amount <= cashBalance) {
+        cashBalance -= amount;
+        dirty = true;
+        return true;
+    }
+    return false;
+}
+
+std::vector<Wallet::Holding>::iterator Wallet::holdingOf(SymbolId symbol) {
+    return std::lower_bound(holdings.begin(), holdings.end(), symbol,
+                            [](const Holding& h, SymbolId id) { return h.first < id; });
+}
+
+Fixed Wallet::getQty(SymbolId symbol) const {
+    auto it = std::lower_bound(holdings.begin(), holdings.end(), symbol,
+                               [](const Holding& h, SymbolId id) { return h.first < id; });
+    return (it != holdings.end() && it->first == symbol) ? it->second : Fixed();
+}
+
+bool Wallet::addQty(SymbolId symbol, Fixed units) {
+    if (units <= Fixed()) return false;
+    auto it = holdingOf(symbol);
+    if (it != holdings.end() && it->first == symbol) {
+        if (!Fixed::checkedAdd(it->second, units, it->second)) return false;
+    } else {
+        holdings.insert(it, Holding(symbol, units));
+    }
+    dirty = true;
+    return true;
+}
+
+bool Wallet::removeQty(SymbolId symbol, Fixed units) {
+    auto it = holdingOf(symbol);
+    if (units > Fixed() && it != holdings.end() && it->first == symbol && it->second >= units) {
+        it->second -= units;
+        if (it->second == Fixed()) {
+            holdings.erase(it);
+        }
+        dirty = true;
+        return true;
+    }
+    return false;
+}
+
+void Wallet::adjust(SymbolId symbol, Fixed cash, Fixed units) {
+    cashBalance += cash;
+    if (units != Fixed()) {
+        auto it = holdingOf(symbol);
+        if (it != holdings.end() && it->first == symbol) {
+            it->second += units;
+            if (it->second == Fixed()) holdings.erase(it);
+        } else {
+            holdings.insert(it, Holding(symbol, units));
+        }
+    }
+    dirty = true;
+}
+
+Fixed Wallet::getQty(const std::string& symbol) const {
+    SymbolId id = SymbolRegistry::instance().lookup(symbol);
+    return (id != SymbolRegistry::npos) ? getQty(id) : Fixed();
+}
+
+bool Wallet::addQty(const std::string& symbol, Fixed units) {
+    return addQty(SymbolRegistry::instance().intern(symbol), units);
+}
+
+bool Wallet::removeQty(const std::string& symbol, Fixed units) {
+    SymbolId id = SymbolRegistry::instance().lookup(symbol);
+    return (id != SymbolRegistry::npos) && removeQty(id, units);
+}
+
+void Wallet::print(std::ostream& os) const {
+    os << "Cash: $" << std::fixed << std::setprecision(2) << cashBalance << "\n";
+    os << "Holdings:\n";
+    if (holdings.empty()) {
+        os << "  No holdings yet.\n";
+    } else {
+        for (const auto& pair : holdings) {
+            os << "  " << symbolName(pair.first) << ": " << pair.second << " units\n";
+        }
+    }
+}
+
+const std::vector<Wallet::Holding>& Wallet::getHoldings() const { return holdings; }
+bool Wallet::isDirty() const { return dirty; }
+void Wallet::markClean() { dirty = false; }
+
+inline std::ostream& operator<<(std::ostream& os, const Wallet& w) {
+    os << "Cash: $" << std::fixed << std::setprecision(2) << w.cashBalance << "\nHoldings:\n";
+    if (w.holdings.empty()) {
+        os << "  No holdings yet.\n";
+    } else {
+        for (const auto& h : w.holdings) {
+            os << "  " << symbolName(h.first) << ": " << h.second << " units\n";
+        }
+    }
+    return os;
+}
+
+class User {
+private:
+    std::string name;
+    Wallet wallet;
+    mutable UserId id = NameRegistry::npos; // interned on first use
+
+public:
+    User(const std::string& name, Fixed cash = Fixed());
+
+    const std::string& getName() const;
+    UserId getId() const;
+    Wallet& getWallet();
+    const Wallet& getWallet() const;
+    void printSummary(std::ostream& os = std::cout) const;
+
+    friend std::ostream& operator<<(std::ostream& os, const User& u);
+};
+
+User::User(const std::string& name, Fixed cash) : name(name), wallet(cash) {}
+const std::string& User::getName() const { return name; }
+
+UserId User::getId() const {
+    if (id == NameRegistry::npos) id = UserRegistry::instance().intern(name);
+    return id;
+}
+Wallet& User::getWallet() { return wallet; }
+const Wallet& User::getWallet() const { return wallet; }
+
+void User::printSummary(std::ostream& os) const {
+    os << "\n--- User Portfolio ---\n";
+    os << "Welcome, " << name << "!\n";
+    wallet.print(os);
+    os << "----------------------\n";
+}
+
+inline std::ostream& operator<<(std::ostream& os, const User& u) {
+    os << "--- User Portfolio ---\n";
+    os << "User: " << u.name << "\n";
+    os << u.wallet;
+    os << "----------------------\n";
+    return os;
+}
+
+// --- Central limit order book ---
+struct BookFill {
+    std::uint64_t makerTag;
+    std::uint64_t takerTag;
+    std::uint32_t maker;
+    std::uint32_t taker;
+    bool takerIsBuy;
+    bool makerDone; // the resting order was filled completely and removed
+    Fixed price;    // always the resting order's price
+    Fixed units;
+};
+
+struct BookEntry {
+    std::uint64_t tag;
+    std::uint32_t trader;
+    bool isBuy;
+    Fixed price;
+    Fixed remaining;
+};
+
+// Price-time priority book for one symbol. Levels are a contiguous array
+// indexed by price tick, each holding an intrusive FIFO of slots in a pooled
+// order array, so adding, matching and cancelling never allocate once warm.
+// A bitmap marks the non-empty levels, with a summary bit per bitmap word,
+// so finding the next best price skips empty ticks 64 or 4096 at a time.
+// Handles encode slot and generation, so a stale handle never hits a reused slot.
+class OrderBook {
+private:
+    static constexpr std::uint32_t NIL = 0xFFFFFFFFu;
+    static constexpr std::int64_t MAX_LEVELS = std::int64_t(1) << 22;
+    static constexpr std::int64_t NO_BID = std::numeric_limits<std::int64_t>::min();
+    static constexpr std::int64_t NO_ASK = std::numeric_limits<std::int64_t>::max();
+
+    struct Order {
+        std::uint64_t tag;
+        std::int64_t remaining; // raw units
+        std::int64_t tick;
+        std::uint32_t trader;
+        std::uint32_t generation;
+        std::uint32_t prev;
+        std::uint32_t next; // also links the free list
+        bool isBuy;
+        bool live;
+    };
+    struct Level {
+        std::uint32_t head = NIL;
+        std::uint32_t tail = NIL;
+        std::int64_t quantity = 0; // raw units resting at this price
+    };
+
+    Fixed tickSize;
+    std::int64_t baseTick = 0; // tick of levels[0]
+    std::vector<Level> levels;
+    std::vector<std::uint64_t> occupied; // bit per level: its FIFO is non-empty
+    std::vector<std::uint64_t> summary;  // bit per occupied word: any bit set
+    std::vector<Order> orders;
+    std::uint32_t freeList = NIL;
+    std::int64_t bestBid = NO_BID;
+    std::int64_t bestAsk = NO_ASK;
+    std::size_t bids = 0, asks = 0;
+
+    bool cover(std::int64_t tick);
+    Level& level(std::int64_t tick);
+    void mark(std::int64_t tick);
+    void unmark(std::int64_t tick);
+    void remap();
+    std::uint32_t allocate();
+    void unlink(std::uint32_t slot);
+    void release(std::uint32_t slot);
+    std::int64_t bidAtOrBelow(std::int64_t tick) const;
+    std::int64_t askAtOrAbove(std::int64_t tick) const;
+    const Order* resolve(std::uint64_t handle) const;
+
+public:
+    explicit OrderBook(Fixed tickSize);
+
+    // Matches against the opposite side, then rests any remainder; `handle`
+    // is 0 when nothing rests. False if the order is off the tick grid or
+    // would stretch the level array past MAX_LEVELS.
+    bool submit(std::uint32_t trader, std::uint64_t tag, bool isBuy, Fixed price, Fixed units,
+                std::vector<BookFill>& fills, std::uint64_t& handle);
+    bool find(std::uint64_t handle, BookEntry& out) const;
+    bool cancel(std::uint64_t handle);
+    void drain(std::vector<BookEntry>& out); // removes every resting order
+
+    Fixed getBestBid() const; // Fixed() when the side is empty
+    Fixed getBestAsk() const;
+    void depth(bool isBuy, std::size_t maxLevels, std::vector<std::pair<Fixed, Fixed>>& out) const;
+    std::size_t size() const;
+};
+
+OrderBook::OrderBook(Fixed tickSize) : tickSize(tickSize) {}
+
+bool OrderBook::cover(std::int64_t tick) {
+    const std::size_t before = levels.size();
+    if (levels.empty()) {
+        baseTick = std::max<std::int64_t>(0, tick - 512);
+        levels.resize(1024);
+    }
+    std::int64_t size = static_cast<std::int64_t>(levels.size());
+    if (tick < baseTick) {
+        std::int64_t newBase = std::max<std::int64_t>(0, std::min(tick, baseTick - size));
+        if (baseTick + size - newBase > MAX_LEVELS) return false;
+        levels.insert(levels.begin(), static_cast<std::size_t>(baseTick - newBase), Level());
+        baseTick = newBase;
+    } else if (tick >= baseTick + size) {
+        std::int64_t needed = tick - baseTick + 1;
+        if (needed > MAX_LEVELS) return false;
+        levels.resize(static_cast<std::size_t>(std::min(MAX_LEVELS, std::max(needed, size * 2))));
+    }
+    if (levels.size() != before) remap();
+    return true;
+}
+
+OrderBook::Level& OrderBook::level(std::int64_t tick) { return levels[static_cast<std::size_t>(tick - baseTick)]; }
+
+void OrderBook::mark(std::int64_t tick) {
+    std::size_t i = static_cast<std::size_t>(tick - baseTick);
+    occupied[i / 64] |= std::uint64_t(1) << (i % 64);
+    summary[i / 4096] |= std::uint64_t(1) << (i / 64 % 64);
+}
+
+void OrderBook::unmark(std::int64_t tick) {
+    std::size_t i = static_cast<std::size_t>(tick - baseTick);
+    occupied[i / 64] &= ~(std::uint64_t(1) << (i % 64));
+    if (occupied[i / 64] == 0) summary[i / 4096] &= ~(std::uint64_t(1) << (i / 64 % 64));
+}
+
+// Rebuilds both bitmaps after the level array grew or shifted.
+void OrderBook::remap() {
+    occupied.assign((levels.size() + 63) / 64, 0);
+    summary.assign((occupied.size() + 63) / 64, 0);
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+        if (levels[i].head != NIL) mark(baseTick + static_cast<std::int64_t>(i));
+    }
+}
+
+std::uint32_t OrderBook::allocate() {
+    if (freeList != NIL) {
+        std::uint32_t slot = freeList;
+        freeList = orders[slot].next;
+        return slot;
+    }
+    orders.push_back(Order{0, 0, 0, 0, 1, NIL, NIL, false, false});
+    return static_cast<std::uint32_t>(orders.size() - 1);
+}
+
+void OrderBook::unlink(std::uint32_t slot) {
+    Order& o = orders[slot];
+    Level& lv = level(o.tick);
+    if (o.prev != NIL) orders[o.prev].next = o.next;
+    else lv.head = o.next;
+    if (o.next != NIL) orders[o.next].prev = o.prev;
+    else lv.tail = o.prev;
+    lv.quantity -= o.remaining;
+    if (lv.head == NIL) unmark(o.tick);
+}
+
+void OrderBook::release(std::uint32_t slot) {
+    Order& o = orders[slot];
+    if (o.isBuy) --bids;
+    else --asks;
+    o.live = false;
+    ++o.generation;
+    o.next = freeList;
+    freeList = slot;
+}
+
+std::int64_t OrderBook::bidAtOrBelow(std::int64_t tick) const {
+    if (bids == 0) return NO_BID;
+    std::int64_t top = std::min(tick, baseTick + static_cast<std::int64_t>(levels.size()) - 1);
+    if (top < baseTick) return NO_BID;
+    std::size_t i = static_cast<std::size_t>(top - baseTick);
+    std::size_t word = i / 64;
+    std::uint64_t bits = occupied[word] & (~std::uint64_t(0) >> (63 - i % 64));
+    if (bits == 0) {
+        std::size_t group = word / 64;
+        std::uint64_t words = summary[group] & ((std::uint64_t(1) << (word % 64)) - 1);
+        while (words == 0) {
+            if (group == 0) return NO_BID;
+            words = summary[--group];
+        }
+        word = group * 64 + 63 - static_cast<std::size_t>(__builtin_clzll(words));
+        bits = occupied[word];
+    }
+    return baseTick + static_cast<std::int64_t>(word * 64 + 63 - static_cast<std::size_t>(__builtin_clzll(bits)));
+}
+
+std::int64_t OrderBook::askAtOrAbove(std::int64_t tick) const {
+    if (asks == 0) return NO_ASK;
+    std::int64_t from = std::max(tick, baseTick);
+    if (from >= baseTick + static_cast<std::int64_t>(levels.size())) return NO_ASK;
+    std::size_t i = static_cast<std::size_t>(from - baseTick);
+    std::size_t word = i / 64;
+    std::uint64_t bits = occupied[word] & (~std::uint64_t(0) << (i % 64));
+    if (bits == 0) {
+        std::size_t group = word / 64;
+        std::uint64_t words = word % 64 == 63 ? 0 : summary[group] & (~std::uint64_t(0) << (word % 64 + 1));
+        while (words == 0) {
+            if (++group == summary.size()) return NO_ASK;
+            words = summary[group];
+        }
+        word = group * 64 + static_cast<std::size_t>(__builtin_ctzll(words));
+        bits = occupied[word];
+    }
+    return baseTick + static_cast<std::int64_t>(word * 64 + static_cast<std::size_t>(__builtin_ctzll(bits)));
+}
+
+const OrderBook::Order* OrderBook::resolve(std::uint64_t handle) const {
+    std::uint32_t slot = static_cast<std::uint32_t>(handle);
+    std::uint32_t generation = static_cast<std::uint32_t>(handle >> 32);
+    if (slot >= orders.size() || !orders[slot].live || orders[slot].generation != generation) return nullptr;
+    return &orders[slot];
+}
+
+bool OrderBook::submit(std::uint32_t trader, std::uint64_t tag, bool isBuy, Fixed price, Fixed units,
+                       std::vector<BookFill>& fills, std::uint64_t& handle) {
+    handle = 0;
+    if (units <= Fixed() || price <= Fixed() || !price.isMultipleOf(tickSize)) return false;
+    const std::int64_t tick = price.getRaw() / tickSize.getRaw();
+    if (!cover(tick)) return false;
+
+    std::int64_t remaining = units.getRaw();
+    std::int64_t& best = isBuy ? bestAsk : bestBid;
+    while (remaining > 0 && (isBuy ? best <= tick : best >= tick)) {
+        Level& lv = level(best);
+        while (remaining > 0 && lv.head != NIL) {
+            std::uint32_t slot = lv.head;
+            Order& maker = orders[slot];
+            std::int64_t qty = std::min(remaining, maker.remaining);
+            maker.remaining -= qty;
+            lv.quantity -= qty;
+            remaining -= qty;
+            bool done = maker.remaining == 0;
+            fills.push_back(BookFill{maker.tag, tag, maker.trader, trader, isBuy, done,
+                                     Fixed::fromRaw(best * tickSize.getRaw()), Fixed::fromRaw(qty)});
+            if (done) {
+                unlink(slot);
+                release(slot);
+            }
+        }
+        if (lv.head == NIL) best = isBuy ? askAtOrAbove(best + 1) : bidAtOrBelow(best - 1);
+    }
+    if (remaining == 0) return true;
+
+    std::uint32_t slot = allocate();
+    Order& o = orders[slot];
+    Level& lv = level(tick);
+    o.tag = tag;
+    o.remaining = remaining;
+    o.tick = tick;
+    o.trader = trader;
+    o.isBuy = isBuy;
+    o.live = true;
+    o.prev = lv.tail;
+    o.next = NIL;
+    if (lv.tail != NIL) {
+        orders[lv.tail].next = slot;
+    } else {
+        lv.head = slot;
+        mark(tick);
+    }
+    lv.tail = slot;
+    lv.quantity += remaining;
+    if (isBuy) {
+        ++bids;
+        bestBid = std::max(bestBid, tick);
+    } else {
+        ++asks;
+        bestAsk = std::min(bestAsk, tick);
+    }
+    handle = (static_cast<std::uint64_t>(o.generation) << 32) | slot;
+    return true;
+}
+
+bool OrderBook::find(std::uint64_t handle, BookEntry& out) const {
+    const Order* o = resolve(handle);
+    if (!o) return false;
+    out = BookEntry{o->tag, o->trader, o->isBuy, Fixed::fromRaw(o->tick * tickSize.getRaw()), Fixed::fromRaw(o->remaining)};
+    return true;
+}
+
+bool OrderBook::cancel(std::uint64_t handle) {
+    if (!resolve(handle)) return false;
+    std::uint32_t slot = static_cast<std::uint32_t>(handle);
+    Order& o = orders[slot];
+    const std::int64_t tick = o.tick;
+    const bool isBuy = o.isBuy;
+    unlink(slot);
+    release(slot);
+    if (level(tick).head == NIL) {
+        if (isBuy && bestBid == tick) bestBid = bidAtOrBelow(tick - 1);
+        if (!isBuy && bestAsk == tick) bestAsk = askAtOrAbove(tick + 1);
+    }
+    return true;
+}
+
+void OrderBook::drain(std::vector<BookEntry>& out) {
+    for (std::size_t slot = 0; slot < orders.size(); ++slot) {
+        const Order& o = orders[slot];
+        if (o.live) {
+            out.push_back(BookEntry{o.tag, o.trader, o.isBuy, Fixed::fromRaw(o.tick * tickSize.getRaw()),
+                                    Fixed::fromRaw(o.remaining)});
+        }
+    }
+    levels.clear();
+    occupied.clear();
+    summary.clear();
+    orders.clear();
+    freeList = NIL;
+    bestBid = NO_BID;
+    bestAsk = NO_ASK;
+    bids = asks = 0;
+}
+
+Fixed OrderBook::getBestBid() const { return bestBid == NO_BID ? Fixed() : Fixed::fromRaw(bestBid * tickSize.getRaw()); }
+Fixed OrderBook::getBestAsk() const { return bestAsk == NO_ASK ? Fixed() : Fixed::fromRaw(bestAsk * tickSize.getRaw()); }
+
+void OrderBook::depth(bool isBuy, std::size_t maxLevels, std::vector<std::pair<Fixed, Fixed>>& out) const {
+    std::int64_t t = isBuy ? bestBid : bestAsk;
+    while (out.size() < maxLevels && t != NO_BID && t != NO_ASK) {
+        const Level& lv = levels[static_cast<std::size_t>(t - baseTick)];
+        out.emplace_back(Fixed::fromRaw(t * tickSize.getRaw()), Fixed::fromRaw(lv.quantity));
+        t = isBuy ? bidAtOrBelow(t - 1) : askAtOrAbove(t + 1);
+    }
+}
+
+std::size_t OrderBook::size() const { return bids + asks; }
+
+// --- Candles ---
+// Per-symbol OHLCV candles at 1s, 1m and 1h, fed by price updates and fills.
+// Each resolution is a fixed-capacity ring kept column-wise (start, open,
+// high, low, close, volume as raw Fixed ticks). Every slot is written twice,
+// at i and i + capacity, so the newest `capacity` candles - and any run of
+// them - sit contiguously and a range query hands back pointers, not copies.
+// Memory per symbol is 2 * 6 * 8 bytes per candle of configured capacity.
+
+// A run of consecutive candles, oldest first; each pointer has `size` entries.
+struct CandleSpan {
+    const std::int64_t* start = nullptr; // ms since the epoch, bucket-aligned
+    const std::int64_t* open = nullptr;
+    const std::int64_t* high = nullptr;
+    const std::int64_t* low = nullptr;
+    const std::int64_t* close = nullptr;
+    const std::int64_t* volume = nullptr;
+    std::size_t size = 0;
+};
+
+class CandleSeries {
+private:
+    std::int64_t periodMs;
+    std::size_t capacity;
+    std::uint64_t count = 0; // candles ever opened; the newest is count - 1
+    std::vector<std::int64_t> start, open, high, low, close, volume;
+
+    void store(std::vector<std::int64_t>& column, std::size_t slot, std::int64_t value);
+
+public:
+    CandleSeries(std::int64_t periodMs, std::size_t capacity);
+
+    // O(1); ticks older than the newest candle are dropped.
+    void add(std::int64_t timeMs, Fixed price, Fixed units);
+    std::size_t size() const;
+    std::int64_t getPeriodMs() const;
+    CandleSpan latest(std::size_t n) const;
+    CandleSpan range(std::int64_t fromMs, std::int64_t toMs) const; // candles starting in [from, to)
+};
+
+CandleSeries::CandleSeries(std::int64_t periodMs, std::size_t capacity)
+    : periodMs(periodMs), capacity(std::max<std::size_t>(1, capacity)),
+      start(2 * this->capacity), open(2 * this->capacity), high(2 * this->capacity),
+      low(2 * this->capacity), close(2 * this->capacity), volume(2 * this->capacity) {}
+
+void CandleSeries::store(std::vector<std::int64_t>& column, std::size_t slot, std::int64_t value) {
+    column[slot] = value;
+    column[slot + capacity] = value;
+}
+
+void CandleSeries::add(std::int64_t timeMs, Fixed price, Fixed units) {
+    std::int64_t bucket = timeMs - ((timeMs % periodMs) + periodMs) % periodMs;
+    std::size_t slot = static_cast<std::size_t>((count == 0 ? 0 : count - 1) % capacity);
+    if (count == 0 || bucket > start[slot]) {
+        slot = static_cast<std::size_t>(count++ % capacity);
+        store(start, slot, bucket);
+        store(open, slot, price.getRaw());
+        store(high, slot, price.getRaw());
+        store(low, slot, price.getRaw());
+        store(close, slot, price.getRaw());
+        store(volume, slot, units.getRaw());
+        return;
+    }
+    if (bucket < start[slot]) return;
+    if (price.getRaw() > high[slot]) store(high, slot, price.getRaw());
+    if (price.getRaw() < low[slot]) store(low, slot, price.getRaw());
+    store(close, slot, price.getRaw());
+    store(volume, slot, volume[slot] + units.getRaw());
+}
+
+std::size_t CandleSeries::size() const { return static_cast<std::size_t>(std::min<std::uint64_t>(count, capacity)); }
+std::int64_t CandleSeries::getPeriodMs() const { return periodMs; }
+
+CandleSpan CandleSeries::latest(std::size_t n) const {
+    n = std::min(n, size());
+    CandleSpan span;
+    if (n == 0) return span;
+    std::size_t first = static_cast<std::size_t>((count - n) % capacity);
+    span.start = &start[first];
+    span.open = &open[first];
+    span.high = &high[first];
+    span.low = &low[first];
+    span.close = &close[first];
+    span.volume = &volume[first];
+    span.size = n;
+    return span;
+}
+
+CandleSpan CandleSeries::range(std::int64_t fromMs, std::int64_t toMs) const {
+    CandleSpan all = latest(size());
+    const std::int64_t* begin = std::lower_bound(all.start, all.start + all.size, fromMs);
+    const std::int64_t* end = std::lower_bound(begin, all.start + all.size, toMs);
+    std::size_t offset = static_cast<std::size_t>(begin - all.start);
+    CandleSpan span;
+    span.size = static_cast<std::size_t>(end - begin);
+    if (span.size == 0) return span;
+    span.start = begin;
+    span.open = all.open + offset;
+    span.high = all.high + offset;
+    span.low = all.low + offset;
+    span.close = all.close + offset;
+    span.volume = all.volume + offset;
+    return span;
+}
+
+class CandleStore {
+public:
+    enum Resolution { SECOND, MINUTE, HOUR, RESOLUTIONS };
+    static constexpr std::int64_t PERIOD_MS[RESOLUTIONS] = {1000, 60000, 3600000};
+
+private:
+    std::size_t capacity[RESOLUTIONS] = {3600, 1440, 720}; // an hour, a day, a month
+    std::vector<std::unique_ptr<std::array<CandleSeries, RESOLUTIONS>>> series; // indexed by SymbolId
+
+    CandleStore() = default;
+
+public:
+    static CandleStore& instance();
+    CandleStore(const CandleStore&) = delete;
+    CandleStore& operator=(const CandleStore&) = delete;
+
+    static std::int64_t nowMs();
+    static bool parseResolution(const std::string& text, Resolution& out);
+
+    // Applies to symbols first seen afterwards; clear() to resize existing ones.
+    void configure(std::size_t perSecond, std::size_t perMinute, std::size_t perHour);
+    void clear();
+    std::size_t bytesPerSymbol() const;
+
+    // Creates the symbol's series now; once every listing has one, adds to
+    // distinct symbols from several threads never grow the table.
+    void reserve(SymbolId symbol);
+    void add(SymbolId symbol, std::int64_t timeMs, Fixed price, Fixed units);
+    const CandleSeries* find(SymbolId symbol, Resolution resolution) const;
+    void print(SymbolId symbol, Resolution resolution, std::size_t n, std::ostream& os = std::cout) const;
+};
+
+constexpr std::int64_t CandleStore::PERIOD_MS[CandleStore::RESOLUTIONS];
+
+CandleStore& CandleStore::instance() {
+    static CandleStore store;
+    return store;
+}
+
+std::int64_t CandleStore::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool CandleStore::parseResolution(const std::string& text, Resolution& out) {
+    if (text == "1s") out = SECOND;
+    else if (text == "1m") out = MINUTE;
+    else if (text == "1h") out = HOUR;
+    else return false;
+    return true;
+}
+
+void CandleStore::configure(std::size_t perSecond, std::size_t perMinute, std::size_t perHour) {
+    capacity[SECOND] = std::max<std::size_t>(1, perSecond);
+    capacity[MINUTE] = std::max<std::size_t>(1, perMinute);
+    capacity[HOUR] = std::max<std::size_t>(1, perHour);
+}
+
+void CandleStore::clear() { series.clear(); }
+
+std::size_t CandleStore::bytesPerSymbol() const {
+    return 2 * 6 * sizeof(std::int64_t) * (capacity[SECOND] + capacity[MINUTE] + capacity[HOUR]);
+}
+
+void CandleStore::reserve(SymbolId symbol) {
+    if (symbol >= series.size()) series.resize(symbol + 1);
+    if (series[symbol]) return;
+    series[symbol].reset(new std::array<CandleSeries, RESOLUTIONS>{
+        CandleSeries(PERIOD_MS[SECOND], capacity[SECOND]), CandleSeries(PERIOD_MS[MINUTE], capacity[MINUTE]),
+        CandleSeries(PERIOD_MS[HOUR], capacity[HOUR])});
+}
+
+void CandleStore::add(SymbolId symbol, std::int64_t timeMs, Fixed price, Fixed units) {
+    if (symbol >= series.size() || !series[symbol]) reserve(symbol);
+    for (CandleSeries& s : *series[symbol]) s.add(timeMs, price, units);
+}
+
+const CandleSeries* CandleStore::find(SymbolId symbol, Resolution resolution) const {
+    if (symbol >= series.size() || !series[symbol]) return nullptr;
+    return &(*series[symbol])[resolution];
+}
+
+void CandleStore::print(SymbolId symbol, Resolution resolution, std::size_t n, std::ostream& os) const {
+    const CandleSeries* s = find(symbol, resolution);
+    CandleSpan span = s ? s->latest(n) : CandleSpan();
+    os << "\n--- " << symbolName(symbol) << " candles (" << span.size << ") ---\n";
+    for (std::size_t i = 0; i < span.size; ++i) {
+        os << span.start[i] << "  O " << Fixed::fromRaw(span.open[i]).toString()
+           << "  H " << Fixed::fromRaw(span.high[i]).toString()
+           << "  L " << Fixed::fromRaw(span.low[i]).toString()
+           << "  C " << Fixed::fromRaw(span.close[i]).toString()
+           << "  V " << Fixed::fromRaw(span.volume[i]).toString() << "\n";
+    }
+    os << "-------------------------------\n";
+}
+
+// --- Portfolio valuation ---
+// Every user's holdings, held in holding columns: column k stores each user's
+// k-th holding (symbol, units and a copy of that symbol's price) in arrays
+// indexed by a dense user slot, next to flat cash and equity arrays. A full
+// revaluation is then a unit-stride multiply-add per column. A price change
+// walks only that symbol's holder list, adjusting equity by the delta; the
+// cells' price copies catch up at the next revaluation. A column is as long
+// as the user table, so memory grows with the most symbols any single wallet
+// holds. Values are doubles because they only rank and display; wallets
+// remain the exact record.
+//
+// The engine is filled on first use from every stored wallet, then kept
+// current by Exchange::setPrice and AuthManager::saveUserData.
+class ValuationEngine {
+public:
+    struct Entry {
+        UserId user;
+        double equity;
+    };
+
+private:
+    struct HoldingColumn {
+        std::vector<SymbolId> symbol; // npos past the end of a user's holdings
+        std::vector<std::uint32_t> holderIndex; // into holdersOf[symbol]
+        std::vector<double> units; // 0 where empty, so revalue needs no mask
+        std::vector<double> price;
+    };
+    struct Holder {
+        std::uint32_t slot;
+        std::uint32_t column;
+        double units;
+    };
+
+    bool loaded = false;
+    std::vector<double> prices; // indexed by SymbolId
+    std::vector<HoldingColumn> holdingColumns;
+    std::vector<std::vector<Holder>> holdersOf; // SymbolId -> where it is held
+    std::vector<SymbolId> repriced; // symbols whose cells still hold an old price
+    std::vector<char> isRepriced; // indexed by SymbolId
+    std::vector<std::uint32_t> slotOf; // UserId -> slot, npos if absent
+    std::vector<UserId> users; // slot -> UserId
+    std::vector<std::uint32_t> holdingCount; // slot -> columns in use
+    std::vector<double> cash;
+    std::vector<double> equity;
+
+    ValuationEngine() = default;
+    std::uint32_t slotFor(UserId user);
+    void growSymbols(SymbolId symbol);
+    void removeHoldings(std::uint32_t slot);
+
+public:
+    static constexpr std::uint32_t npos = 0xFFFFFFFFu;
+
+    static ValuationEngine& instance();
+    ValuationEngine(const ValuationEngine&) = delete;
+    ValuationEngine& operator=(const ValuationEngine&) = delete;
+
+    // Reads every user's wallet through `auth`; a no-op once loaded.
+    void load(const Exchange& ex, AuthManager& auth);
+    void clear();
+    bool isLoaded() const;
+    std::size_t size() const;
+
+    void update(const User& user); // replaces the user's row
+    void setPrice(SymbolId symbol, Fixed price);
+    void revalue();
+    double equityOf(UserId user) const;
+    std::vector<Entry> top(std::size_t n) const;
+    void printLeaderboard(std::size_t n, std::ostream& os = std::cout) const;
+};
+
+ValuationEngine& ValuationEngine::instance() {
+    static ValuationEngine engine;
+    return engine;
+}
+
+void ValuationEngine::clear() {
+    loaded = false;
+    prices.clear();
+    holdingColumns.clear();
+    holdersOf.clear();
+    repriced.clear();
+    isRepriced.clear();
+    slotOf.clear();
+    users.clear();
+    holdingCount.clear();
+    cash.clear();
+    equity.clear();
+}
+
+bool ValuationEngine::isLoaded() const { return loaded; }
+std::size_t ValuationEngine::size() const { return users.size(); }
+
+std::uint32_t ValuationEngine::slotFor(UserId user) {
+    if (user >= slotOf.size()) slotOf.resize(user + 1, npos);
+    if (slotOf[user] == npos) {
+        slotOf[user] = static_cast<std::uint32_t>(users.size());
+        users.push_back(user);
+        holdingCount.push_back(0);
+        cash.push_back(0);
+        equity.push_back(0);
+        for (HoldingColumn& column : holdingColumns) {
+            column.symbol.push_back(npos);
+            column.holderIndex.push_back(0);
+            column.units.push_back(0);
+            column.price.push_back(0);
+        }
+    }
+    return slotOf[user];
+}
+
+void ValuationEngine::growSymbols(SymbolId symbol) {
+    if (symbol < prices.size()) return;
+    prices.resize(symbol + 1, 0.0);
+    holdersOf.resize(symbol + 1);
+    isRepriced.resize(symbol + 1, 0);
+}
+
+// Clears the slot's cells and swap-removes it from each symbol's holder list,
+// repointing whichever holder moved into the gap.
+void ValuationEngine::removeHoldings(std::uint32_t slot) {
+    for (std::uint32_t k = 0; k < holdingCount[slot]; ++k) {
+        HoldingColumn& column = holdingColumns[k];
+        std::vector<Holder>& holders = holdersOf[column.symbol[slot]];
+        const std::uint32_t index = column.holderIndex[slot];
+        const Holder moved = holders.back();
+        holders[index] = moved;
+        holdingColumns[moved.column].holderIndex[moved.slot] = index;
+        holders.pop_back();
+        column.symbol[slot] = npos;
+        column.units[slot] = 0;
+        column.price[slot] = 0;
+    }
+    holdingCount[slot] = 0;
+}
+
+void ValuationEngine::update(const User& user) {
+    if (!loaded) return;
+    std::uint32_t slot = slotFor(user.getId());
+    removeHoldings(slot);
+    const Wallet& wallet = user.getWallet();
+    cash[slot] = wallet.getCash().toDouble();
+    double total = cash[slot];
+    std::uint32_t k = 0;
+    for (const auto& holding : wallet.getHoldings()) {
+        growSymbols(holding.first);
+        if (k == holdingColumns.size()) {
+            holdingColumns.emplace_back();
+            HoldingColumn& added = holdingColumns.back();
+            added.symbol.assign(users.size(), npos);
+            added.holderIndex.assign(users.size(), 0);
+            added.units.assign(users.size(), 0.0);
+            added.price.assign(users.size(), 0.0);
+        }
+        HoldingColumn& column = holdingColumns[k];
+        std::vector<Holder>& holders = holdersOf[holding.first];
+        column.symbol[slot] = holding.first;
+        column.holderIndex[slot] = static_cast<std::uint32_t>(holders.size());
+        column.units[slot] = holding.second.toDouble();
+        column.price[slot] = prices[holding.first];
+        holders.push_back(Holder{slot, k, column.units[slot]});
+        total += column.units[slot] * column.price[slot];
+        ++k;
+    }
+    holdingCount[slot] = k;
+    equity[slot] = total;
+}
+
+// Touches only the symbol's holders; their cells' price copies are left for
+// revalue() to refresh.
+void ValuationEngine::setPrice(SymbolId symbol, Fixed price) {
+    if (!loaded) return;
+    growSymbols(symbol);
+    const double delta = price.toDouble() - prices[symbol];
+    prices[symbol] = price.toDouble();
+    for (const Holder& holder : holdersOf[symbol]) equity[holder.slot] += holder.units * delta;
+    if (!isRepriced[symbol]) {
+        isRepriced[symbol] = 1;
+        repriced.push_back(symbol);
+    }
+}
+
+// eq[i] += units[i] * price[i]. Written four wide over non-aliasing arrays
+// because GCC's -O2 cost model will not vectorise a loop of unknown length
+// that needs a scalar epilogue; kept out of line so inlining does not drop
+// the __restrict qualifiers.
+__attribute__((noinline)) static void multiplyAdd(double* __restrict eq, const double* __restrict units, const double* __restrict price,
+                        std::size_t n) {
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        eq[i] += units[i] * price[i];
+        eq[i + 1] += units[i + 1] * price[i + 1];
+        eq[i + 2] += units[i + 2] * price[i + 2];
+        eq[i + 3] += units[i + 3] * price[i + 3];
+    }
+    for (; i < n; ++i) eq[i] += units[i] * price[i];
+}
+
+// Recomputes every equity from cash and the cells' prices, discarding any
+// rounding drift the incremental updates have accumulated: one unit-stride
+// pass per holding column.
+void ValuationEngine::revalue() {
+    for (SymbolId symbol : repriced) {
+        for (const Holder& holder : holdersOf[symbol]) holdingColumns[holder.column].price[holder.slot] = prices[symbol];
+        isRepriced[symbol] = 0;
+    }
+    repriced.clear();
+    std::copy(cash.begin(), cash.end(), equity.begin());
+    for (const HoldingColumn& column : holdingColumns) {
+        multiplyAdd(equity.data(), column.units.data(), column.price.data(), users.size());
+    }
+}
+
+double ValuationEngine::equityOf(UserId user) const {
+    if (user >= slotOf.size() || slotOf[user] == npos) return 0.0;
+    return equity[slotOf[user]];
+}
+
+std::vector<ValuationEngine::Entry> ValuationEngine::top(std::size_t n) const {
+    std::vector<std::uint32_t> order(users.size());
+    for (std::uint32_t slot = 0; slot < order.size(); ++slot) order[slot] = slot;
+    n = std::min(n, order.size());
+    auto richer = [this](std::uint32_t a, std::uint32_t b) {
+        return equity[a] != equity[b] ? equity[a] > equity[b] : users[a] < users[b];
+    };
+    std::nth_element(order.begin(), order.begin() + n, order.end(), richer);
+    std::sort(order.begin(), order.begin() + n, richer);
+
+    std::vector<Entry> out;
+    out.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) out.push_back(Entry{users[order[i]], equity[order[i]]});
+    return out;
+}
+
+void ValuationEngine::printLeaderboard(std::size_t n, std::ostream& os) const {
+    os << "\n--- Leaderboard (top " << n << " of " << users.size() << ") ---\n";
+    std::size_t rank = 0;
+    for (const Entry& entry : top(n)) {
+        os << std::setw(4) << ++rank << ". " << std::left << std::setw(16) << userName(entry.user) << std::right
+           << " $" << std::fixed << std::setprecision(2) << Fixed::fromDouble(entry.equity) << "\n";
+    }
+    os << "------------------------------------\n";
+}
+
+// An append-only journal file. Copies start closed, so a copied Exchange (a
+// backtest run, an engine shard) never writes to its original's journal.
+struct JournalStream {
+    std::ofstream file;
+    std::size_t records = 0;
+
+    JournalStream() = default;
+    JournalStream(const JournalStream&) {}
+    JournalStream& operator=(const JournalStream&) { return *this; }
+};
+
+class Exchange {
+private:
+    std::vector<Crypto_currency> listings;
+    std::vector<int> slotOf; // SymbolId -> index into listings, -1 if unlisted
+
+    // One book per listing, parallel to `listings`. Book orders are
+    // session-scoped: their escrow is refunded by closeBooks() at shutdown,
+    // or by recoverBooks() on the next start if the process died first.
+    std::vector<OrderBook> books;
+    std::vector<std::string> traders; // book trader id -> username
+    std::unordered_map<std::string, std::uint32_t> traderIds;
+    std::unordered_map<std::uint64_t, std::pair<SymbolId, std::uint64_t>> bookOrders; // order id -> symbol, handle
+    std::uint64_t nextBookOrderId = 1;
+    std::vector<BookFill> fillBuffer;
+
+    // Records: "A id user symbol isBuy price units" (resting), "F id units"
+    // (a maker fill), "C id" (cancelled). Only open after recoverBooks().
+    static const std::string bookJournalFile;
+    JournalStream bookJournal;
+
+    std::uint32_t traderId(const std::string& username);
+    void settleBookFills(User& taker, SymbolId symbol, Fixed limitPrice, AuthManager& auth);
+    void journalAdd(std::uint64_t orderId, SymbolId symbol, const BookEntry& entry);
+    void journalRemove(char tag, std::uint64_t orderId, Fixed units = Fixed());
+    void flushJournal();
+    void compactJournal();
+
+public:
+    static std::atomic<int> totalTrades;
+
+    void add_crypto_listing(const Crypto_currency& c);
+    Crypto_currency* find(SymbolId symbol);
+    Crypto_currency* find(const std::string& symbol);
+    const Crypto_currency* find(SymbolId symbol) const;
+    const Crypto_currency* find(const std::string& symbol) const;
+    // Also re-marks holders and feeds the candles; timeMs 0 means now.
+    bool setPrice(SymbolId symbol, Fixed price, std::int64_t timeMs = 0);
+    Fixed priceOf(SymbolId symbol) const;
+    Fixed priceOf(const std::string& symbol) const;
+    bool isListingsEmpty() const;
+    void print(std::ostream& os = std::cout) const;
+    const std::vector<Crypto_currency>& getListings() const;
+
+    const OrderBook* bookOf(SymbolId symbol) const;
+    void printBook(SymbolId symbol, std::size_t maxLevels, std::ostream& os = std::cout) const;
+    bool placeBookOrder(User& user, SymbolId symbol, bool isBuy, Fixed units, Fixed price, AuthManager& auth,
+                        std::ostream& os = std::cout);
+    bool cancelBookOrder(User& user, std::uint64_t orderId, AuthManager& auth, std::ostream& os = std::cout);
+    void closeBooks(AuthManager& auth);
+    void recoverBooks(AuthManager& auth); // refunds what a crash left open, then starts the journal
+};
+
+std::atomic<int> Exchange::totalTrades{0};
+const std::string Exchange::bookJournalFile = "book_orders.journal";
+
+void Exchange::add_crypto_listing(const Crypto_currency& c) {
+    if (c.getId() >= slotOf.size()) slotOf.resize(c.getId() + 1, -1);
+    if (slotOf[c.getId()] >= 0) {
+        listings[slotOf[c.getId()]] = c;
+        ValuationEngine::instance().setPrice(c.getId(), c.getPrice());
+        return;
+    }
+    slotOf[c.getId()] = static_cast<int>(listings.size());
+    listings.push_back(c);
+    books.emplace_back(c.getTickSize());
+    ValuationEngine::instance().setPrice(c.getId(), c.getPrice());
+}
+
+Crypto_currency* Exchange::find(SymbolId symbol) {
+    if (symbol >= slotOf.size() || slotOf[symbol] < 0) return nullptr;
+    return &listings[slotOf[symbol]];
+}
+
+Crypto_currency* Exchange::find(const std::string& symbol) {
+    return find(SymbolRegistry::instance().lookup(symbol));
+}
+
+const Crypto_currency* Exchange::find(SymbolId symbol) const {
+    if (symbol >= slotOf.size() || slotOf[symbol] < 0) return nullptr;
+    return &listings[slotOf[symbol]];
+}
+
+const Crypto_currency* Exchange::find(const std::string& symbol) const {
+    return find(SymbolRegistry::instance().lookup(symbol));
+}
+
+bool Exchange::setPrice(SymbolId symbol, Fixed price, std::int64_t timeMs) {
+    Crypto_currency* crypto = find(symbol);
+    if (!crypto) return false;
+    crypto->setPrice(price);
+    ValuationEngine::instance().setPrice(symbol, price);
+    CandleStore::instance().add(symbol, timeMs ? timeMs : CandleStore::nowMs(), price, Fixed());
+    return true;
+}
+
+Fixed Exchange::priceOf(SymbolId symbol) const {
+    if (symbol >= slotOf.size() || slotOf[symbol] < 0) return Fixed::fromInt(-1);
+    return listings[slotOf[symbol]].getPrice();
+}
+
+Fixed Exchange::priceOf(const std::string& symbol) const {
+    return priceOf(SymbolRegistry::instance().lookup(symbol));
+}
+
+bool Exchange::isListingsEmpty() const { return listings.empty(); }
+
+void Exchange::print(std::ostream& os) const {
+    os << "\n--- Crypto Exchange Listings ---\n";
+    for (const auto& c : listings) {
+        os << "  " << std::setw(5) << c.getSymbol()
+           << "  " << std::setw(12) << c.getName()
+           << "  $" << std::fixed << std::setprecision(2) << c.getPrice() << "\n";
+    }
+    os << "Total Trades on Exchange: " << totalTrades.load() << "\n";
+
+    const std::int64_t nowMs = CandleStore::nowMs();
+    os << "\n  " << std::setw(5) << "Sym" << std::setw(8) << "Trades" << std::setw(16) << "Volume"
+       << std::setw(15) << "Notional" << std::setw(12) << "VWAP" << std::setw(12) << "Last" << std::setw(12)
+       << "24h High" << std::setw(12) << "24h Low" << "\n";
+    for (const auto& c : listings) {
+        TradeSummary stats = TradeStats::instance().summary(c.getId(), nowMs);
+        os << "  " << std::setw(5) << c.getSymbol() << std::setw(8) << stats.count;
+        if (stats.count == 0) {
+            os << std::setw(16) << "-" << std::setw(15) << "-" << std::setw(12) << "-" << std::setw(12) << "-"
+               << std::setw(12) << "-" << std::setw(12) << "-" << "\n";
+            continue;
+        }
+        os << std::setw(16) << stats.baseVolume.toString() << std::setw(15) << stats.quoteVolume
+           << std::setw(12) << stats.vwap() << std::setw(12) << stats.lastPrice;
+        if (stats.high > Fixed()) os << std::setw(12) << stats.high << std::setw(12) << stats.low << "\n";
+        else os << std::setw(12) << "-" << std::setw(12) << "-" << "\n";
+    }
+    os << "-------------------------------\n";
+}
+
+const std::vector<Crypto_currency>& Exchange::getListings() const { return listings; }
+
+const OrderBook* Exchange::bookOf(SymbolId symbol) const {
+    if (symbol >= slotOf.size() || slotOf[symbol] < 0) return nullptr;
+    return &books[slotOf[symbol]];
+}
+
+void Exchange::printBook(SymbolId symbol, std::size_t maxLevels, std::ostream& os) const {
+    const OrderBook* book = bookOf(symbol);
+    if (!book) {
+        os << "Symbol not found.\n";
+        return;
+    }
+    std::vector<std::pair<Fixed, Fixed>> bids, asks;
+    book->depth(true, maxLevels, bids);
+    book->depth(false, maxLevels, asks);
+    os << "\n--- Order Book: " << symbolName(symbol) << " ---\n";
+    for (auto it = asks.rbegin(); it != asks.rend(); ++it) {
+        os << "  ASK  $" << std::setw(12) << it->first.toString() << "  x " << it->second.toString() << "\n";
+    }
+    os << "  ----\n";
+    for (const auto& level : bids) {
+        os << "  BID  $" << std::setw(12) << level.first.toString() << "  x " << level.second.toString() << "\n";
+    }
+    os << "-------------------------------\n";
+}
+
+std::uint32_t Exchange::traderId(const std::string& username) {
+    auto res = traderIds.emplace(username, static_cast<std::uint32_t>(traders.size()));
+    if (res.second) traders.push_back(username);
+    return res.first->second;
+}
+
+// A market order on one side of the book. The side is a template parameter,
+// so execute() and settle() bind at compile time.
+template <bool IsBuy>
+class MarketTrade {
+private:
+    SymbolId symbol;
+    Fixed units;
+
+public:
+    MarketTrade(SymbolId sym, Fixed u);
+    MarketTrade(const std::string& sym, Fixed u);
+    bool execute(User& user, Exchange& ex, std::ostream& os = std::cout);
+
+    // Moves `units` at total `value` through the wallet; false leaves it untouched.
+    static bool settle(Wallet& wallet, SymbolId symbol, Fixed units, Fixed value);
+    static void report(const User& user, SymbolId symbol, Fixed units, Fixed price, Fixed value);
+};
+
+using BuyTrade = MarketTrade<true>;
+using SellTrade = MarketTrade<false>;
+
+template <bool IsBuy>
+MarketTrade<IsBuy>::MarketTrade(SymbolId sym, Fixed u) : symbol(sym), units(u) {}
+
+template <bool IsBuy>
+MarketTrade<IsBuy>::MarketTrade(const std::string& sym, Fixed u)
+    : symbol(SymbolRegistry::instance().lookup(sym)), units(u) {}
+
+template <bool IsBuy>
+bool MarketTrade<IsBuy>::settle(Wallet& wallet, SymbolId symbol, Fixed units, Fixed value) {
+    if constexpr (IsBuy) {
+        if (!wallet.withdraw(value)) return false;
+        if (!wallet.addQty(symbol, units)) {
+            wallet.deposit(value);
+            return false;
+        }
+    } else {
+        if (!wallet.removeQty(symbol, units)) return false;
+        if (!wallet.deposit(value)) {
+            wallet.addQty(symbol, units);
+            return false;
+        }
+    }
+    return true;
+}
+
+template <bool IsBuy>
+void MarketTrade<IsBuy>::report(const User& user, SymbolId symbol, Fixed units, Fixed price, Fixed value) {
+    const std::int64_t nowMs = CandleStore::nowMs();
+    Exchange::totalTrades++;
+    TradeStats::instance().record(symbol, price, units, nowMs);
+    CandleStore::instance().add(symbol, nowMs, price, units);
+    EventLog::instance().record(TradeEvent{0, units.getRaw(), price.getRaw(), value.getRaw(), 0, user.getId(), symbol,
+                                           IsBuy ? TradeEvent::Bought : TradeEvent::Sold, IsBuy, {}});
+}
+
+template <bool IsBuy>
+bool MarketTrade<IsBuy>::execute(User& user, Exchange& ex, std::ostream& os) {
+    LATENCY_SCOPE(IsBuy ? LatencyProbe::BuyTrade : LatencyProbe::SellTrade);
+    const Crypto_currency* crypto = ex.find(symbol);
+    if (!crypto) {
+        os << "Symbol not found.\n";
+        return false;
+    }
+    if (!crypto->acceptsUnits(units)) {
+        os << "Units must be a positive multiple of the lot size (" << crypto->getLotSize().toString() << ").\n";
+        return false;
+    }
+    Wallet& wallet = user.getWallet();
+    Fixed value;
+    if (!Fixed::checkedMul(crypto->getPrice(), units, value)) {
+        os << "Trade value is out of range.\n";
+        return false;
+    }
+    if (!settle(wallet, symbol, units, value)) {
+        if (IsBuy ? wallet.getCash() >= value : wallet.getQty(symbol) >= units) os << "Trade would overflow the wallet.\n";
+        else os << (IsBuy ? "Insufficient cash to complete purchase.\n" : "Insufficient units to sell.\n");
+        return false;
+    }
+    report(user, symbol, units, crypto->getPrice(), value);
+    return true;
+}
+
+struct MarketOrder {
+    SymbolId symbol;
+    Fixed units;
+    bool isBuy;
+};
+
+// A basket of market orders for one user. Every leg is priced from a single
+// snapshot taken when the batch executes and checked in order against the
+// wallet; either all legs fill or the wallet is left as it was.
+class TradeBatch {
+private:
+    std::vector<MarketOrder> orders;
+
+public:
+    void add(SymbolId symbol, Fixed units, bool isBuy);
+    bool parse(std::istream& in, std::string& error); // "buy|sell <SYM> <units>" repeated
+    std::size_t size() const;
+    bool execute(User& user, Exchange& ex, std::string& error);
+};
+
+void TradeBatch::add(SymbolId symbol, Fixed units, bool isBuy) { orders.push_back(MarketOrder{symbol, units, isBuy}); }
+
+bool TradeBatch::parse(std::istream& in, std::string& error) {
+    std::string side, sym;
+    Fixed units;
+    while (in >> side) {
+        if ((side != "buy" && side != "sell") || !(in >> sym >> units)) {
+            error = "expected buy|sell <SYM> <units>";
+            return false;
+        }
+        add(SymbolRegistry::instance().lookup(sym), units, side == "buy");
+    }
+    if (orders.empty()) {
+        error = "empty batch";
+        return false;
+    }
+    return true;
+}
+
+std::size_t TradeBatch::size() const { return orders.size(); }
+
+bool TradeBatch::execute(User& user, Exchange& ex, std::string& error) {
+    std::vector<Fixed> prices, values;
+    prices.reserve(orders.size());
+    values.reserve(orders.size());
+    for (std::size_t i = 0; i < orders.size(); ++i) {
+        const Crypto_currency* crypto = ex.find(orders[i].symbol);
+        if (!crypto) {
+            error = "leg " + std::to_string(i + 1) + ": symbol not found";
+            return false;
+        }
+        if (!crypto->acceptsUnits(orders[i].units)) {
+            error = "leg " + std::to_string(i + 1) + ": units must be a positive multiple of " +
+                    crypto->getLotSize().toString();
+            return false;
+        }
+        Fixed value;
+        if (!Fixed::checkedMul(crypto->getPrice(), orders[i].units, value)) {
+            error = "leg " + std::to_string(i + 1) + ": value out of range";
+            return false;
+        }
+        prices.push_back(crypto->getPrice());
+        values.push_back(value);
+    }
+
+    // Legs settle in submission order, so a sell can fund a later buy. If one
+    // fails, the earlier legs are reversed newest-first by restoring their
+    // exact cash and unit deltas, which cannot fail.
+    Wallet& wallet = user.getWallet();
+    for (std::size_t i = 0; i < orders.size(); ++i) {
+        const MarketOrder& order = orders[i];
+        bool ok = order.isBuy ? BuyTrade::settle(wallet, order.symbol, order.units, values[i])
+                              : SellTrade::settle(wallet, order.symbol, order.units, values[i]);
+        if (ok) continue;
+
+        if (order.isBuy ? wallet.getCash() >= values[i] : wallet.getQty(order.symbol) >= order.units)
+            error = "leg " + std::to_string(i + 1) + ": would overflow the wallet";
+        else
+            error = "leg " + std::to_string(i + 1) + ": " +
+                    (order.isBuy ? std::string("insufficient cash") : "insufficient units of " + symbolName(order.symbol));
+        while (i-- > 0) {
+            const MarketOrder& done = orders[i];
+            if (done.isBuy) wallet.adjust(done.symbol, values[i], -done.units);
+            else wallet.adjust(done.symbol, -values[i], done.units);
+        }
+        return false;
+    }
+
+    for (std::size_t i = 0; i < orders.size(); ++i) {
+        const MarketOrder& order = orders[i];
+        if (order.isBuy) BuyTrade::report(user, order.symbol, order.units, prices[i], values[i]);
+        else SellTrade::report(user, order.symbol, order.units, prices[i], values[i]);
+    }
+    return true;
+}
+
+// --- Binary state snapshot ---
+// state.snap is a native little-endian image that is mapped and read in
+// place: a header, then fixed-size record arrays and one string pool, each
+// section 8-byte aligned. Only the symbol table needs fixing up on load;
+// wallets are decoded lazily when their owner logs in.
+struct SnapshotString {
+    std::uint32_t offset;
+    std::uint32_t length;
+};
+
+struct SnapshotHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t symbolCount;
+    std::uint32_t listingCount;
+    std::uint64_t userCount;
+    std::uint64_t holdingCount;
+    std::uint64_t orderCount;
+    std::int64_t nextOrderId;
+    std::int64_t totalTrades;
+    std::uint64_t symbolsOffset;
+    std::uint64_t listingsOffset;
+    std::uint64_t usersOffset;
+    std::uint64_t holdingsOffset;
+    std::uint64_t ordersOffset;
+    std::uint64_t stringsOffset;
+    std::uint64_t stringsSize;
+};
+
+struct SnapshotListing {
+    SnapshotString name;
+    std::uint32_t symbol;
+    std::uint32_t reserved;
+    std::int64_t price;
+    std::int64_t tickSize;
+    std::int64_t lotSize;
+};
+
+// Users are sorted by name so a login is a binary search over the mapping.
+struct SnapshotUser {
+    SnapshotString name;
+    std::int64_t cash;
+    std::uint64_t firstHolding;
+    std::uint32_t holdingCount;
+    std::uint32_t reserved;
+};
+
+struct SnapshotHolding {
+    std::int64_t qty;
+    std::uint32_t symbol;
+    std::uint32_t reserved;
+};
+
+// Order ids are 64-bit: the low half sits where version 1 kept the whole
+// (positive, 32-bit) id, and the high half in what was a zero reserved word.
+struct SnapshotOrder {
+    std::int64_t units;
+    std::int64_t price;
+    SnapshotString username;
+    std::uint32_t orderIdLow;
+    std::uint32_t symbol;
+    std::uint32_t isBuy;
+    std::uint32_t orderIdHigh;
+
+    std::int64_t orderId() const {
+        return static_cast<std::int64_t>((std::uint64_t(orderIdHigh) << 32) | orderIdLow);
+    }
+};
+
+static_assert(sizeof(SnapshotHeader) == 112, "snapshot header layout changed");
+static_assert(sizeof(SnapshotListing) == 40, "snapshot listing layout changed");
+static_assert(sizeof(SnapshotUser) == 32, "snapshot user layout changed");
+static_assert(sizeof(SnapshotHolding) == 16, "snapshot holding layout changed");
+static_assert(sizeof(SnapshotOrder) == 40, "snapshot order layout changed");
+
+class StateSnapshot {
+private:
+    MappedFile file;
+    const SnapshotHeader* header = nullptr;
+    std::vector<SymbolId> symbolIds; // snapshot symbol index -> interned id
+
+    template <typename T>
+    const T* section(std::uint64_t offset, std::uint64_t count) const;
+
+public:
+    static constexpr char MAGIC[4] = {'C', 'S', 'N', 'P'};
+    static const std::uint32_t VERSION = 1;
+
+    // Returns false when there is no snapshot; throws if it is unreadable.
+    bool open(const std::string& path);
+    bool isOpen() const;
+
+    std::int64_t nextOrderId() const;
+    std::int64_t totalTrades() const;
+    void restoreListings(Exchange& ex) const;
+
+    std::uint64_t userCount() const;
+    const SnapshotUser& userAt(std::uint64_t index) const;
+    const SnapshotUser* findUser(const std::string& username) const;
+    User* loadUser(const SnapshotUser& record) const;
+
+    std::uint64_t orderCount() const;
+    const SnapshotOrder& orderAt(std::uint64_t index) const;
+
+    std::string text(SnapshotString s) const;
+    SymbolId symbolAt(std::uint32_t index) const;
+};
+
+constexpr char StateSnapshot::MAGIC[4];
+
+template <typename T>
+const T* StateSnapshot::section(std::uint64_t offset, std::uint64_t count) const {
+    if (offset % alignof(T) != 0 || offset > file.size() || count > (file.size() - offset) / sizeof(T)) {
+        throw std::runtime_error("snapshot section out of bounds");
+    }
+    return reinterpret_cast<const T*>(file.data() + offset);
+}
+
+bool StateSnapshot::open(const std::string& path) {
+    header = nullptr;
+    symbolIds.clear();
+    if (!std::filesystem::exists(path)) return false;
+    if (!file.open(path)) throw std::runtime_error("cannot map " + path);
+    if (file.size() < sizeof(SnapshotHeader)) throw std::runtime_error(path + " is truncated");
+
+    const SnapshotHeader* h = reinterpret_cast<const SnapshotHeader*>(file.data());
+    if (std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0) throw std::runtime_error(path + " is not a state snapshot");
+    if (h->version != VERSION) {
+        throw std::runtime_error(path + " has unsupported version " + std::to_string(h->version));
+    }
+    header = h;
+    try {
+        section<SnapshotString>(h->symbolsOffset, h->symbolCount);
+        section<SnapshotListing>(h->listingsOffset, h->listingCount);
+        section<SnapshotUser>(h->usersOffset, h->userCount);
+        section<SnapshotHolding>(h->holdingsOffset, h->holdingCount);
+        section<SnapshotOrder>(h->ordersOffset, h->orderCount);
+        section<char>(h->stringsOffset, h->stringsSize);
+
+        const SnapshotString* symbols = section<SnapshotString>(h->symbolsOffset, h->symbolCount);
+        symbolIds.reserve(h->symbolCount);
+        for (std::uint32_t i = 0; i < h->symbolCount; ++i) {
+            symbolIds.push_back(SymbolRegistry::instance().intern(text(symbols[i])));
+        }
+    } catch (const std::exception&) {
+        header = nullptr;
+        throw;
+    }
+    return true;
+}
+
+bool StateSnapshot::isOpen() const { return header != nullptr; }
+std::int64_t StateSnapshot::nextOrderId() const { return header->nextOrderId; }
+std::int64_t StateSnapshot::totalTrades() const { return header->totalTrades; }
+
+void StateSnapshot::restoreListings(Exchange& ex) const {
+    const SnapshotListing* listings = section<SnapshotListing>(header->listingsOffset, header->listingCount);
+    for (std::uint32_t i = 0; i < header->listingCount; ++i) {
+        const SnapshotListing& l = listings[i];
+        ex.add_crypto_listing(Crypto_currency(text(l.name), symbolName(symbolAt(l.symbol)), Fixed::fromRaw(l.price),
+                                              Fixed::fromRaw(l.tickSize), Fixed::fromRaw(l.lotSize)));
+    }
+}
+
+std::uint64_t StateSnapshot::userCount() const { return header->userCount; }
+
+const SnapshotUser& StateSnapshot::userAt(std::uint64_t index) const {
+    return section<SnapshotUser>(header->usersOffset, header->userCount)[index];
+}
+
+const SnapshotUser* StateSnapshot::findUser(const std::string& username) const {
+    const SnapshotUser* users = section<SnapshotUser>(header->usersOffset, header->userCount);
+    const SnapshotUser* end = users + header->userCount;
+    auto it = std::lower_bound(users, end, username, [&](const SnapshotUser& u, const std::string& name) {
+        return text(u.name) < name;
+    });
+    if (it == end || text(it->name) != username) return nullptr;
+    return it;
+}
+
+User* StateSnapshot::loadUser(const SnapshotUser& record) const {
+    if (record.firstHolding > header->holdingCount || record.holdingCount > header->holdingCount - record.firstHolding) {
+        throw std::runtime_error("snapshot holdings out of bounds");
+    }
+    const SnapshotHolding* holdings = section<SnapshotHolding>(header->holdingsOffset, header->holdingCount);
+    User* user = new User(text(record.name), Fixed::fromRaw(record.cash));
+    for (std::uint32_t i = 0; i < record.holdingCount; ++i) {
+        const SnapshotHolding& h = holdings[record.firstHolding + i];
+        user->getWallet().addQty(symbolAt(h.symbol), Fixed::fromRaw(h.qty));
+    }
+    return user;
+}
+
+std::uint64_t StateSnapshot::orderCount() const { return header->orderCount; }
+
+const SnapshotOrder& StateSnapshot::orderAt(std::uint64_t index) const {
+    return section<SnapshotOrder>(header->ordersOffset, header->orderCount)[index];
+}
+
+std::string StateSnapshot::text(SnapshotString s) const {
+    if (s.offset > header->stringsSize || s.length > header->stringsSize - s.offset) {
+        throw std::runtime_error("snapshot string out of bounds");
+    }
+    return std::string(file.data() + header->stringsOffset + s.offset, s.length);
+}
+
+SymbolId StateSnapshot::symbolAt(std::uint32_t index) const {
+    if (index >= symbolIds.size()) throw std::runtime_error("snapshot symbol out of bounds");
+    return symbolIds[index];
+}
+
+// --- Wallet store ---
+// wallets.db keeps every wallet in one paged file instead of a CSV per user.
+// Page 0 holds the header; the rest of the file is tiled by cells aligned to
+// 64 bytes, each a WalletCell header followed by the encoded wallet and
+// covered by a CRC-32. The file grows a page at a time.
+//
+// A save never overwrites the live copy: it writes the wallet to another cell
+// under a higher generation and only then frees the old one. An interrupted
+// or torn write therefore damages only a cell nobody reads yet; on the next
+// open it fails its checksum and is reclaimed, and if both copies survived
+// the higher generation wins.
+//
+// A clean close writes the name index and free list to wallets.db.idx, and
+// the next open adopts it instead of scanning every cell. Open deletes it
+// again, so after a crash there is none and the cells are scanned (and
+// verified) as before.
+struct WalletStoreHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t pageSize;
+    std::uint32_t reserved;
+};
+
+struct WalletCell {
+    std::uint32_t capacity; // bytes, header included
+    std::uint32_t length;   // payload bytes; 0 marks a free cell
+    std::uint64_t generation;
+    std::uint32_t checksum; // CRC-32 of this header, checksum zeroed, then the payload
+    std::uint32_t reserved;
+};
+
+struct LegacyWalletCell { // version 1, unchecksummed
+    std::uint32_t capacity;
+    std::uint32_t length;
+    std::uint64_t generation;
+};
+
+static_assert(sizeof(WalletStoreHeader) == 16, "wallet store header layout changed");
+static_assert(sizeof(WalletCell) == 24, "wallet cell layout changed");
+static_assert(sizeof(LegacyWalletCell) == 16, "legacy wallet cell layout changed");
+
+// CRC-32 (IEEE 802.3, reflected), continuing from `crc`; start from 0.
+std::uint32_t crc32(std::uint32_t crc, const void* data, std::size_t size) {
+    static const std::array<std::uint32_t, 256> table = [] {
+        std::array<std::uint32_t, 256> t{};
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t c = i;
+            for (int bit = 0; bit < 8; ++bit) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i) crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+class WalletStore {
+private:
+    struct Slot {
+        std::uint64_t offset;
+        std::uint32_t capacity;
+        std::uint64_t generation;
+    };
+
+    mutable std::fstream file;
+    std::string path;
+    std::uint64_t fileSize = 0;
+    std::uint64_t generation = 0;
+    std::unordered_map<std::string, Slot> index;
+    std::multimap<std::uint32_t, std::uint64_t> freeCells; // capacity -> offset
+    mutable std::string buffer;
+
+    void create();
+    std::uint32_t storedVersion() const;
+    void upgrade();
+    void rebuild();
+    bool readIndex();
+    void writeIndex() const;
+    std::string indexPath() const;
+    static std::uint32_t checksumOf(WalletCell cell, const char* payload);
+    static bool validCell(const char* at, std::uint64_t room, WalletCell& cell);
+    static void encode(const User& user, std::string& out);
+    static User* decode(const char* payload, std::uint32_t length);
+    static std::string keyOf(const char* payload, std::uint32_t length);
+    bool write(std::uint64_t offset, const std::string& bytes);
+    void release(const Slot& slot);
+
+public:
+    static constexpr std::uint32_t PAGE_SIZE = 4096;
+    static constexpr std::uint32_t CELL_ALIGN = 64;
+    static constexpr char MAGIC[4] = {'C', 'W', 'A', 'L'};
+    static constexpr char INDEX_MAGIC[4] = {'C', 'W', 'I', 'X'};
+    static const std::uint32_t VERSION = 2; // 1: cells without checksums, upgraded on open
+
+    WalletStore() = default;
+    ~WalletStore();
+    WalletStore(const WalletStore&) = delete;
+    WalletStore& operator=(const WalletStore&) = delete;
+
+    // Creates the file if it is missing; throws if it is not a wallet store.
+    bool open(const std::string& path);
+    void close(); // writes the index for the next open
+    bool isOpen() const;
+
+    std::size_t size() const;
+    std::uint64_t bytes() const;
+    bool contains(const std::string& name) const;
+    User* load(const std::string& name) const; // nullptr when absent
+    bool save(const User& user);
+    bool erase(const std::string& name);
+    bool clear();
+    std::vector<std::string> names() const; // sorted
+
+    // Visits every stored wallet in file order with one sequential pass.
+    template <typename Fn>
+    void scan(Fn fn) const;
+};
+
+constexpr char WalletStore::MAGIC[4];
+constexpr char WalletStore::INDEX_MAGIC[4];
+
+WalletStore::~WalletStore() { close(); }
+
+bool WalletStore::open(const std::string& storePath) {
+    file.close();
+    path = storePath;
+    index.clear();
+    freeCells.clear();
+    generation = 0;
+    if (!std::filesystem::exists(path)) {
+        std::filesystem::remove(indexPath());
+        create();
+    }
+    if (storedVersion() == 1) upgrade();
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file) return false;
+    if (!readIndex()) rebuild();
+    std::filesystem::remove(indexPath());
+    return true;
+}
+
+void WalletStore::close() {
+    if (!file.is_open()) return;
+    file.close();
+    writeIndex();
+}
+
+std::string WalletStore::indexPath() const { return path + ".idx"; }
+
+void WalletStore::create() {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    std::string page(PAGE_SIZE, '\0');
+    WalletStoreHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.pageSize = PAGE_SIZE;
+    std::memcpy(&page[0], &header, sizeof(header));
+    out.write(page.data(), page.size());
+    if (!out.flush()) throw std::runtime_error("cannot create " + path);
+}
+
+std::uint32_t WalletStore::storedVersion() const {
+    std::ifstream in(path, std::ios::binary);
+    WalletStoreHeader header{};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) throw std::runtime_error(path + " is truncated");
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) throw std::runtime_error(path + " is not a wallet store");
+    if ((header.version != VERSION && header.version != 1) || header.pageSize != PAGE_SIZE) {
+        throw std::runtime_error(path + " has unsupported version " + std::to_string(header.version));
+    }
+    return header.version;
+}
+
+// Rewrites a version 1 store as the current version, keeping the newest copy
+// of each wallet, and swaps it in under the same name.
+void WalletStore::upgrade() {
+    MappedFile map;
+    if (!map.open(path)) throw std::runtime_error("cannot map " + path);
+    std::unordered_map<std::string, std::pair<std::uint64_t, std::uint64_t>> newest; // name -> generation, offset
+    for (std::uint64_t offset = PAGE_SIZE; offset + sizeof(LegacyWalletCell) <= map.size();) {
+        LegacyWalletCell cell;
+        std::memcpy(&cell, map.data() + offset, sizeof(cell));
+        if (cell.capacity < CELL_ALIGN || cell.capacity % CELL_ALIGN != 0 || cell.capacity > map.size() - offset ||
+            cell.length > cell.capacity - sizeof(cell)) {
+            throw std::runtime_error(path + " is corrupt at " + std::to_string(offset));
+        }
+        if (cell.length != 0) {
+            auto& entry = newest[keyOf(map.data() + offset + sizeof(cell), cell.length)];
+            if (cell.generation >= entry.first) entry = {cell.generation, offset};
+        }
+        offset += cell.capacity;
+    }
+
+    const std::string temp = path + ".upgrade";
+    std::filesystem::remove(temp);
+    {
+        WalletStore upgraded;
+        if (!upgraded.open(temp)) throw std::runtime_error("cannot create " + temp);
+        for (const auto& entry : newest) {
+            LegacyWalletCell cell;
+            std::memcpy(&cell, map.data() + entry.second.second, sizeof(cell));
+            std::unique_ptr<User> user(decode(map.data() + entry.second.second + sizeof(cell), cell.length));
+            if (!upgraded.save(*user)) throw std::runtime_error("cannot write " + temp);
+        }
+    }
+    map.close();
+    std::filesystem::rename(temp, path);
+    std::filesystem::rename(temp + ".idx", indexPath());
+}
+
+std::uint32_t WalletStore::checksumOf(WalletCell cell, const char* payload) {
+    cell.checksum = 0;
+    return crc32(crc32(0, &cell, sizeof(cell)), payload, cell.length);
+}
+
+bool WalletStore::validCell(const char* at, std::uint64_t room, WalletCell& cell) {
+    if (room < sizeof(cell)) return false;
+    std::memcpy(&cell, at, sizeof(cell));
+    return cell.capacity >= CELL_ALIGN && cell.capacity % CELL_ALIGN == 0 && cell.capacity <= room &&
+           cell.length <= cell.capacity - sizeof(cell) && cell.checksum == checksumOf(cell, at + sizeof(cell));
+}
+
+// Walks every cell. A cell that fails its checksum was being written when the
+// process stopped: the region up to the next valid cell is reclaimed as free.
+void WalletStore::rebuild() {
+    MappedFile map;
+    if (!map.open(path)) throw std::runtime_error("cannot map " + path);
+    fileSize = map.size() / CELL_ALIGN * CELL_ALIGN;
+    if (fileSize < PAGE_SIZE) throw std::runtime_error(path + " is truncated");
+
+    std::vector<Slot> stale;
+    std::vector<Slot> torn;
+    for (std::uint64_t offset = PAGE_SIZE; offset < fileSize;) {
+        WalletCell cell;
+        if (!validCell(map.data() + offset, fileSize - offset, cell)) {
+            std::uint64_t next = offset + CELL_ALIGN;
+            while (next < fileSize && !validCell(map.data() + next, fileSize - next, cell)) next += CELL_ALIGN;
+            torn.push_back(Slot{offset, static_cast<std::uint32_t>(next - offset), 0});
+            offset = next;
+            continue;
+        }
+        Slot slot{offset, cell.capacity, cell.generation};
+        if (cell.length == 0) {
+            freeCells.emplace(cell.capacity, offset);
+        } else {
+            generation = std::max(generation, cell.generation);
+            auto inserted = index.emplace(keyOf(map.data() + offset + sizeof(cell), cell.length), slot);
+            if (!inserted.second) {
+                // A move interrupted before the old cell was freed.
+                Slot& current = inserted.first->second;
+                if (current.generation < slot.generation) std::swap(current, slot);
+                stale.push_back(slot);
+            }
+        }
+        offset += cell.capacity;
+    }
+    const bool ragged = map.size() != fileSize;
+    map.close();
+    if (ragged) std::filesystem::resize_file(path, fileSize);
+    if (!torn.empty()) {
+        std::cerr << "Warning: reclaimed " << torn.size() << " damaged cell(s) in " << path << "\n";
+    }
+    for (const Slot& slot : torn) release(slot);
+    for (const Slot& slot : stale) release(slot);
+}
+
+// wallets.db.idx: INDEX_MAGIC, the store's size and generation, the index
+// and the free list, then a CRC-32 of everything before it.
+void WalletStore::writeIndex() const {
+    std::string out;
+    auto put = [&out](const void* data, std::size_t size) { out.append(static_cast<const char*>(data), size); };
+    const std::uint32_t version = VERSION;
+    put(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    put(&version, sizeof(version));
+    put(&fileSize, sizeof(fileSize));
+    put(&generation, sizeof(generation));
+    std::uint64_t count = index.size();
+    put(&count, sizeof(count));
+    for (const auto& entry : index) {
+        std::uint16_t length = static_cast<std::uint16_t>(entry.first.size());
+        put(&length, sizeof(length));
+        put(entry.first.data(), length);
+        put(&entry.second.offset, sizeof(entry.second.offset));
+        put(&entry.second.capacity, sizeof(entry.second.capacity));
+        put(&entry.second.generation, sizeof(entry.second.generation));
+    }
+    count = freeCells.size();
+    put(&count, sizeof(count));
+    for (const auto& cell : freeCells) {
+        put(&cell.first, sizeof(cell.first));
+        put(&cell.second, sizeof(cell.second));
+    }
+    std::uint32_t checksum = crc32(0, out.data(), out.size());
+    put(&checksum, sizeof(checksum));
+
+    const std::string temp = indexPath() + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file.write(out.data(), static_cast<std::streamsize>(out.size())) || !file.flush()) return;
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, indexPath(), ec);
+}
+
+// False, leaving the index empty, unless wallets.db.idx is intact and was
+// written for the store as it is now.
+bool WalletStore::readIndex() {
+    MappedFile map;
+    if (!map.open(indexPath())) return false;
+    const char* p = map.data();
+    std::size_t left = map.size();
+    auto get = [&](void* out, std::size_t size) {
+        if (size > left) return false;
+        std::memcpy(out, p, size);
+        p += size;
+        left -= size;
+        return true;
+    };
+    std::uint32_t checksum;
+    if (left < sizeof(checksum)) return false;
+    std::memcpy(&checksum, map.data() + left - sizeof(checksum), sizeof(checksum));
+    if (checksum != crc32(0, map.data(), left - sizeof(checksum))) return false;
+    left -= sizeof(checksum);
+
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t size, count;
+    if (!get(magic, sizeof(magic)) || std::memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 ||
+        !get(&version, sizeof(version)) || version != VERSION || !get(&size, sizeof(size)) ||
+        size != std::filesystem::file_size(path) || !get(&generation, sizeof(generation)) ||
+        !get(&count, sizeof(count))) {
+        generation = 0;
+        return false;
+    }
+    fileSize = size;
+    bool ok = true;
+    index.reserve(count);
+    for (std::uint64_t i = 0; ok && i < count; ++i) {
+        std::uint16_t length;
+        Slot slot;
+        ok = get(&length, sizeof(length)) && length <= left;
+        if (!ok) break;
+        std::string name(p, length);
+        p += length;
+        left -= length;
+        ok = get(&slot.offset, sizeof(slot.offset)) && get(&slot.capacity, sizeof(slot.capacity)) &&
+             get(&slot.generation, sizeof(slot.generation));
+        if (ok) index.emplace(std::move(name), slot);
+    }
+    ok = ok && get(&count, sizeof(count));
+    for (std::uint64_t i = 0; ok && i < count; ++i) {
+        std::uint32_t capacity;
+        std::uint64_t offset;
+        ok = get(&capacity, sizeof(capacity)) && get(&offset, sizeof(offset));
+        if (ok) freeCells.emplace(capacity, offset);
+    }
+    if (!ok || left != 0) {
+        index.clear();
+        freeCells.clear();
+        generation = 0;
+        return false;
+    }
+    return true;
+}
+
+void WalletStore::encode(const User& user, std::string& out) {
+    auto put = [&out](const void* data, std::size_t size) { out.append(static_cast<const char*>(data), size); };
+    auto putString = [&](const std::string& s) {
+        std::uint16_t length = static_cast<std::uint16_t>(std::min<std::size_t>(s.size(), 0xFFFF));
+        put(&length, sizeof(length));
+        put(s.data(), length);
+    };
+    const Wallet& wallet = user.getWallet();
+    putString(user.getName());
+    std::int64_t cash = wallet.getCash().getRaw();
+    put(&cash, sizeof(cash));
+    std::uint32_t count = static_cast<std::uint32_t>(wallet.getHoldings().size());
+    put(&count, sizeof(count));
+    for (const auto& holding : wallet.getHoldings()) {
+        putString(symbolName(holding.first));
+        std::int64_t qty = holding.second.getRaw();
+        put(&qty, sizeof(qty));
+    }
+}
+
+std::string WalletStore::keyOf(const char* payload, std::uint32_t length) {
+    std::uint16_t size;
+    if (length < sizeof(size)) throw std::runtime_error("wallet record too short");
+    std::memcpy(&size, payload, sizeof(size));
+    if (size > length - sizeof(size)) throw std::runtime_error("wallet record too short");
+    return std::string(payload + sizeof(size), size);
+}
+
+User* WalletStore::decode(const char* payload, std::uint32_t length) {
+    std::size_t at = 0;
+    auto get = [&](void* out, std::size_t size) {
+        if (size > length - at) throw std::runtime_error("wallet record too short");
+        std::memcpy(out, payload + at, size);
+        at += size;
+    };
+    auto getString = [&]() {
+        std::uint16_t size;
+        get(&size, sizeof(size));
+        if (size > length - at) throw std::runtime_error("wallet record too short");
+        std::string s(payload + at, size);
+        at += size;
+        return s;
+    };
+    std::string name = getString();
+    std::int64_t cash;
+    get(&cash, sizeof(cash));
+    std::uint32_t count;
+    get(&count, sizeof(count));
+    std::unique_ptr<User> user(new User(name, Fixed::fromRaw(cash)));
+    for (std::uint32_t i = 0; i < count; ++i) {
+        std::string symbol = getString();
+        std::int64_t qty;
+        get(&qty, sizeof(qty));
+        user->getWallet().addQty(symbol, Fixed::fromRaw(qty));
+    }
+    return user.release();
+}
+
+bool WalletStore::write(std::uint64_t offset, const std::string& bytes) {
+    file.clear();
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(file.flush());
+}
+
+void WalletStore::release(const Slot& slot) {
+    WalletCell cell{slot.capacity, 0, 0, 0, 0};
+    cell.checksum = checksumOf(cell, nullptr);
+    write(slot.offset, std::string(reinterpret_cast<const char*>(&cell), sizeof(cell)));
+    freeCells.emplace(slot.capacity, slot.offset);
+}
+
+bool WalletStore::isOpen() const { return file.is_open(); }
+std::size_t WalletStore::size() const { return index.size(); }
+std::uint64_t WalletStore::bytes() const { return fileSize; }
+bool WalletStore::contains(const std::string& name) const { return index.count(name) != 0; }
+
+User* WalletStore::load(const std::string& name) const {
+    auto it = index.find(name);
+    if (it == index.end()) return nullptr;
+    buffer.resize(it->second.capacity);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(it->second.offset));
+    if (!file.read(&buffer[0], static_cast<std::streamsize>(buffer.size()))) {
+        throw std::runtime_error("cannot read wallet of " + name + " from " + path);
+    }
+    WalletCell cell;
+    if (!validCell(buffer.data(), buffer.size(), cell) || cell.length == 0) {
+        throw std::runtime_error("wallet of " + name + " is corrupt in " + path);
+    }
+    return decode(buffer.data() + sizeof(cell), cell.length);
+}
+
+bool WalletStore::save(const User& user) {
+    buffer.assign(sizeof(WalletCell), '\0');
+    encode(user, buffer);
+    const std::uint32_t length = static_cast<std::uint32_t>(buffer.size() - sizeof(WalletCell));
+    const std::uint32_t needed = static_cast<std::uint32_t>((buffer.size() + CELL_ALIGN - 1) / CELL_ALIGN * CELL_ALIGN);
+
+    auto existing = index.find(user.getName());
+    // Always a new cell: the smallest free one that fits, split if
+    // worthwhile, else fresh pages at the end. The cell and any free
+    // remainder after it go out in one write.
+    Slot slot{0, needed, ++generation};
+    std::uint32_t remainder = 0;
+    std::uint64_t grownTo = fileSize;
+    auto fit = freeCells.lower_bound(needed);
+    if (fit != freeCells.end()) {
+        slot.offset = fit->second;
+        remainder = fit->first - needed;
+        if (remainder < CELL_ALIGN) {
+            slot.capacity = fit->first;
+            remainder = 0;
+        }
+        freeCells.erase(fit);
+    } else {
+        slot.offset = fileSize;
+        grownTo = fileSize + (needed + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+        remainder = static_cast<std::uint32_t>(grownTo - fileSize - needed);
+    }
+    WalletCell cell{slot.capacity, length, slot.generation, 0, 0};
+    cell.checksum = checksumOf(cell, buffer.data() + sizeof(cell));
+    std::memcpy(&buffer[0], &cell, sizeof(cell));
+    if (remainder > 0) {
+        buffer.resize(slot.capacity, '\0');
+        WalletCell free{remainder, 0, 0, 0, 0};
+        free.checksum = checksumOf(free, nullptr);
+        buffer.append(reinterpret_cast<const char*>(&free), sizeof(free));
+        freeCells.emplace(remainder, slot.offset + slot.capacity);
+    }
+    if (grownTo > fileSize) buffer.resize(grownTo - fileSize, '\0');
+    if (!write(slot.offset, buffer)) return false;
+    fileSize = grownTo;
+
+    if (existing != index.end()) {
+        release(existing->second);
+        existing->second = slot;
+    } else {
+        index.emplace(user.getName(), slot);
+    }
+    return true;
+}
+
+bool WalletStore::erase(const std::string& name) {
+    auto it = index.find(name);
+    if (it == index.end()) return false;
+    release(it->second);
+    index.erase(it);
+    return true;
+}
+
+bool WalletStore::clear() {
+    file.close();
+    std::filesystem::remove(indexPath());
+    create();
+    return open(path);
+}
+
+std::vector<std::string> WalletStore::names() const {
+    std::vector<std::string> out;
+    out.reserve(index.size());
+    for (const auto& entry : index) out.push_back(entry.first);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+template <typename Fn>
+void WalletStore::scan(Fn fn) const {
+    MappedFile map;
+    if (!map.open(path)) throw std::runtime_error("cannot map " + path);
+    for (std::uint64_t offset = PAGE_SIZE; offset < fileSize;) {
+        WalletCell cell;
+        if (!validCell(map.data() + offset, fileSize - offset, cell)) {
+            throw std::runtime_error(path + " is corrupt at " + std::to_string(offset));
+        }
+        if (cell.length != 0) {
+            std::unique_ptr<User> user(decode(map.data() + offset + sizeof(cell), cell.length));
+            fn(*user);
+        }
+        offset += cell.capacity;
+    }
+}
+
+// --- Wallet cache ---
+// Keeps loaded users resident so every path shares one User per name. A
+// load pins the entry until release(). commit() is the save point: a dirty
+// wallet is copied into the pending set, which the flusher thread writes to
+// the store every flush interval, or sooner once it reaches the threshold.
+// Entries that are unpinned, clean and not pending are evicted, least
+// recently used first, while the resident set is over the memory budget.
+//
+// Entries are touched only by the engine thread (or under the server's
+// exclusive engine lock); the flusher sees only the pending copies and the store.
+struct WalletCacheConfig {
+    std::size_t budgetBytes = std::size_t(64) << 20;
+    std::uint32_t flushIntervalMs = 1000;
+    std::size_t flushThreshold = 4096; // pending wallets that trigger an early flush
+
+    // "<MB>,<flush ms>,<pending threshold>", e.g. "64,1000,4096".
+    static bool parse(const std::string& text, WalletCacheConfig& out);
+};
+
+class WalletCache {
+private:
+    struct Entry {
+        std::unique_ptr<User> user;
+        std::uint32_t pins = 0;
+        std::size_t bytes = 0;
+        std::list<const std::string*>::iterator lru; // valid while unpinned
+    };
+    struct Pending {
+        User user;
+        std::uint64_t version;
+    };
+
+    WalletStore& store;
+    WalletCacheConfig config;
+    std::unordered_map<std::string, Entry> entries;
+    std::list<const std::string*> lru; // unpinned entries, most recent first
+    std::size_t residentBytes = 0;
+
+    std::mutex storeMutex;           // the store's file position and index
+    mutable std::mutex pendingMutex; // pending, version, stopping, config timing
+    std::mutex flushMutex;   // one batch written at a time
+    std::condition_variable flushWanted;
+    std::unordered_map<std::string, Pending> pending;
+    std::uint64_t version = 0;
+    bool stopping = false;
+    std::thread flusher;
+
+    std::atomic<std::uint64_t> hits{0}, misses{0}, evictions{0}, writes{0};
+
+    static std::size_t footprint(const User& user);
+    User* fetch(const std::string& name); // pending copy, then the store
+    void enqueue(const User& user);
+    void trim();
+    void flushLoop();
+    void writePending();
+
+public:
+    explicit WalletCache(WalletStore& store);
+    ~WalletCache();
+    WalletCache(const WalletCache&) = delete;
+    WalletCache& operator=(const WalletCache&) = delete;
+
+    void configure(const WalletCacheConfig& config);
+    void start();
+    void stop(); // stops the flusher after a final flush
+
+    // Returns the resident user, loading it if needed, or nullptr if it is
+    // stored nowhere; `fallback` supplies it from elsewhere (the snapshot).
+    User* acquire(const std::string& name, const std::function<User*()>& fallback);
+    User* adopt(User* user, bool stored); // takes ownership; pinned
+    void release(User* user);
+    void commit(const User& user);
+    void flush(); // commits every dirty wallet and writes them all now
+    void sync();  // writes the committed wallets now
+    bool contains(const std::string& name); // committed: pending or stored; writes nothing
+
+    std::size_t size() const;
+    std::size_t bytes() const;
+    void printStats() const;
+
+    template <typename Fn>
+    auto withStore(Fn fn) -> decltype(fn(store));
+};
+
+bool WalletCacheConfig::parse(const std::string& text, WalletCacheConfig& out) {
+    std::size_t megabytes = 0, threshold = 0;
+    unsigned interval = 0;
+    if (std::sscanf(text.c_str(), "%zu,%u,%zu", &megabytes, &interval, &threshold) != 3 || interval == 0 ||
+        threshold == 0) {
+        return false;
+    }
+    out.budgetBytes = megabytes << 20;
+    out.flushIntervalMs = interval;
+    out.flushThreshold = threshold;
+    return true;
+}
+
+WalletCache::WalletCache(WalletStore& store) : store(store) {}
+
+WalletCache::~WalletCache() { stop(); }
+
+void WalletCache::configure(const WalletCacheConfig& newConfig) {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        config = newConfig;
+    }
+    flushWanted.notify_one();
+    trim();
+}
+
+void WalletCache::start() {
+    if (flusher.joinable()) return;
+    stopping = false;
+    flusher = std::thread(&WalletCache::flushLoop, this);
+}
+
+void WalletCache::stop() {
+    if (flusher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            stopping = true;
+        }
+        flushWanted.notify_one();
+        flusher.join();
+    }
+    flush();
+}
+
+std::size_t WalletCache::footprint(const User& user) {
+    return sizeof(Entry) + sizeof(User) + 2 * user.getName().capacity() +
+           user.getWallet().getHoldings().capacity() * sizeof(Wallet::Holding) + 64;
+}
+
+User* WalletCache::fetch(const std::string& name) {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        auto it = pending.find(name);
+        if (it != pending.end()) return new User(it->second.user);
+    }
+    std::lock_guard<std::mutex> lock(storeMutex);
+    return store.load(name);
+}
+
+User* WalletCache::acquire(const std::string& name, const std::function<User*()>& fallback) {
+    auto it = entries.find(name);
+    if (it != entries.end()) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+        Entry& entry = it->second;
+        if (entry.pins++ == 0) lru.erase(entry.lru);
+        return entry.user.get();
+    }
+    misses.fetch_add(1, std::memory_order_relaxed);
+    User* user = fetch(name);
+    if (!user && fallback) user = fallback();
+    if (!user) return nullptr;
+    return adopt(user, true);
+}
+
+User* WalletCache::adopt(User* user, bool stored) {
+    auto inserted = entries.emplace(user->getName(), Entry());
+    Entry& entry = inserted.first->second;
+    if (!inserted.second) {
+        // Already resident: the caller's copy replaces it.
+        *entry.user = *user;
+        delete user;
+        if (entry.pins++ == 0) lru.erase(entry.lru);
+        enqueue(*entry.user);
+        entry.user->getWallet().markClean();
+        return entry.user.get();
+    }
+    if (!stored) enqueue(*user);
+    user->getWallet().markClean();
+    entry.user.reset(user);
+    entry.pins = 1;
+    entry.bytes = footprint(*user);
+    residentBytes += entry.bytes;
+    trim();
+    return user;
+}
+
+void WalletCache::release(User* user) {
+    if (!user) return;
+    auto it = entries.find(user->getName());
+    if (it == entries.end() || it->second.user.get() != user) {
+        delete user; // not cache-owned
+        return;
+    }
+    Entry& entry = it->second;
+    if (entry.pins > 0 && --entry.pins == 0) {
+        lru.push_front(&it->first);
+        entry.lru = lru.begin();
+        residentBytes -= entry.bytes;
+        entry.bytes = footprint(*user);
+        residentBytes += entry.bytes;
+        trim();
+    }
+}
+
+// A resident wallet that has not changed since it was loaded or last
+// committed is skipped; any other User is taken as the newest state.
+void WalletCache::commit(const User& user) {
+    auto it = entries.find(user.getName());
+    User* resident = it != entries.end() ? it->second.user.get() : nullptr;
+    if (resident == &user && !user.getWallet().isDirty()) return;
+    if (resident && resident != &user) *resident = user;
+    enqueue(resident ? *resident : user);
+    if (resident) resident->getWallet().markClean();
+}
+
+void WalletCache::enqueue(const User& user) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        auto slot = pending.find(user.getName());
+        if (slot == pending.end()) pending.emplace(user.getName(), Pending{user, ++version});
+        else slot->second = Pending{user, ++version};
+        wake = pending.size() >= config.flushThreshold;
+    }
+    if (wake) flushWanted.notify_one();
+}
+
+// Evicts from the cold end; dirty or pending entries are skipped until the
+// flusher has written them.
+void WalletCache::trim() {
+    if (residentBytes <= config.budgetBytes) return;
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    for (auto it = lru.end(); it != lru.begin() && residentBytes > config.budgetBytes;) {
+        --it;
+        auto entry = entries.find(**it);
+        if (entry->second.user->getWallet().isDirty() || pending.count(entry->first)) continue;
+        residentBytes -= entry->second.bytes;
+        it = lru.erase(it);
+        entries.erase(entry);
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void WalletCache::flushLoop() {
+    std::unique_lock<std::mutex> lock(pendingMutex);
+    while (!stopping) {
+        flushWanted.wait_for(lock, std::chrono::milliseconds(config.flushIntervalMs),
+                             [this] { return stopping || pending.size() >= config.flushThreshold; });
+        if (pending.empty()) continue;
+        lock.unlock();
+        writePending();
+        lock.lock();
+    }
+}
+
+// Copies the batch out, writes it, then drops whatever was not saved again
+// in the meantime; until then a miss still finds the newest copy in pending.
+void WalletCache::writePending() {
+    std::lock_guard<std::mutex> batchLock(flushMutex);
+    std::vector<std::pair<User, std::uint64_t>> batch;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        batch.reserve(pending.size());
+        for (const auto& entry : pending) batch.emplace_back(entry.second.user, entry.second.version);
+    }
+    if (batch.empty()) return;
+    {
+        LATENCY_SCOPE(LatencyProbe::FlushWallets);
+        std::lock_guard<std::mutex> lock(storeMutex);
+        for (const auto& item : batch) {
+            if (!store.save(item.first)) std::cerr << "Error: Could not save user data for " << item.first.getName() << std::endl;
+        }
+    }
+    writes.fetch_add(batch.size(), std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    for (const auto& item : batch) {
+        auto it = pending.find(item.first.getName());
+        if (it != pending.end() && it->second.version == item.second) pending.erase(it);
+    }
+}
+
+void WalletCache::flush() {
+    for (auto& entry : entries) {
+        if (entry.second.user->getWallet().isDirty()) commit(*entry.second.user);
+    }
+    writePending();
+    trim();
+}
+
+void WalletCache::sync() { writePending(); }
+
+std::size_t WalletCache::size() const { return entries.size(); }
+std::size_t WalletCache::bytes() const { return residentBytes; }
+
+void WalletCache::printStats() const {
+    std::size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        queued = pending.size();
+    }
+    std::cout << "Wallet cache: " << entries.size() << " resident (" << residentBytes / 1024 << " KiB of "
+              << config.budgetBytes / 1024 << " KiB), " << queued << " pending\n"
+              << "  hits " << hits.load() << ", misses " << misses.load() << ", evictions " << evictions.load()
+              << ", wallets written " << writes.load() << "\n";
+}
+
+bool WalletCache::contains(const std::string& name) {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (pending.count(name)) return true;
+    }
+    std::lock_guard<std::mutex> lock(storeMutex);
+    return store.contains(name);
+}
+
+template <typename Fn>
+auto WalletCache::withStore(Fn fn) -> decltype(fn(store)) {
+    flush();
+    std::lock_guard<std::mutex> lock(storeMutex);
+    return fn(store);
+}
+
+class AuthManager {
+private:
+    const std::string user_file = "users.txt";
+    const std::string wallet_file = "wallets.db";
+    const StateSnapshot* snapshot = nullptr; // wallets not in wallets.db come from here
+    mutable WalletStore wallets;
+    mutable WalletCache cache; // in front of wallets; declared after it so it flushes first
+
+    // users.txt is read once into this index; signups append to both.
+    std::unordered_map<std::string, unsigned long> credentials;
+    std::ofstream userLog;
+
+    unsigned long simpleHash(const std::string& str) const;
+    void loadCredentials();
+    void migrateWalletFiles();
+    static User* readWalletCsv(const std::string& filename, const std::string& username);
+
+public:
+    static const Fixed STARTING_CASH;
+
+    AuthManager();
+    std::size_t userCount() const;
+    bool userExists(const std::string& username) const;
+
+    User* login();
+    User* login(const std::string& username, const std::string& password, std::ostream& os = std::cout);
+    User* signUp();
+    User* signUp(const std::string& username, const std::string& password, std::ostream& os = std::cout);
+    // Users come back resident and pinned: pass them to releaseUser, not
+    // delete. saveUserData queues the wallet for the background flusher.
+    void saveUserData(const User& user) const;
+    void persistUserData(const User& user) const; // saveUserData, written to wallets.db before it returns
+    User* loadUserData(const std::string& username) const;
+    void releaseUser(User* user) const;
+    void configureCache(const WalletCacheConfig& config);
+    void flushWallets(); // writes every unsaved wallet now
+    void printCacheStats() const;
+    void attachSnapshot(const StateSnapshot* snap);
+    std::vector<std::string> usernames() const;
+
+    bool hasStoredWallet(const std::string& username) const;
+    std::vector<std::string> storedWallets() const; // sorted
+    bool clearStoredWallets();
+    template <typename Fn>
+    void scanStoredWallets(Fn fn) const;
+    template <typename Fn>
+    void scanSnapshotWallets(Fn fn) const; // snapshot users not shadowed by wallets.db
+};
+
+const Fixed AuthManager::STARTING_CASH = Fixed::fromInt(10000);
+
+AuthManager::AuthManager() : cache(wallets) {
+    loadCredentials();
+    if (!wallets.open(wallet_file)) throw std::runtime_error("cannot open " + wallet_file);
+    migrateWalletFiles();
+    cache.start();
+}
+
+// Moves wallets left as <user>_wallet.csv by older builds into wallets.db.
+// A CSV is newer than anything stored for the same user, so it wins.
+void AuthManager::migrateWalletFiles() {
+    const std::string suffix = "_wallet.csv";
+    std::size_t migrated = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(".")) {
+        const std::string file = entry.path().filename().string();
+        if (!entry.is_regular_file() || file.size() <= suffix.size() ||
+            file.compare(file.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+        std::unique_ptr<User> user(readWalletCsv(file, file.substr(0, file.size() - suffix.size())));
+        if (!user || !wallets.save(*user)) {
+            std::cerr << "Warning: could not migrate " << file << '\n';
+            continue;
+        }
+        std::filesystem::remove(entry.path());
+        ++migrated;
+    }
+    if (migrated > 0) std::cout << "Migrated " << migrated << " wallet files into " << wallet_file << ".\n";
+}
+
+User* AuthManager::readWalletCsv(const std::string& filename, const std::string& username) {
+    std::ifstream file(filename);
+    if (!file) return nullptr;
+    Fixed cash;
+    file >> cash;
+    User* user = new User(username, cash);
+
+    std::string line;
+    std::getline(file, line); // Consume rest of the first line
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+        std::stringstream ss(line);
+        std::string symbol;
+        Fixed units;
+        std::getline(ss, symbol, ',');
+        ss >> units;
+        if (!symbol.empty()) {
+            user->getWallet().addQty(symbol, units);
+        }
+    }
+    return user;
+}
+
+// Parses "user hash" lines straight out of the mapping; the first entry for
+// a name wins, as it did when every login rescanned the file.
+void AuthManager::loadCredentials() {
+    MappedFile file;
+    if (!file.open(user_file)) return;
+    const char* p = file.data();
+    const char* end = p + file.size();
+    credentials.reserve(static_cast<std::size_t>(std::count(p, end, '\n')) + 1);
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        while (p < eol && (*p == ' ' || *p == '\t')) ++p;
+        const char* nameEnd = std::find_if(p, eol, [](char c) { return c == ' ' || c == '\t'; });
+        const char* hashBegin = nameEnd;
+        while (hashBegin < eol && (*hashBegin == ' ' || *hashBegin == '\t')) ++hashBegin;
+        unsigned long hash = 0;
+        const char* q = hashBegin;
+        for (; q < eol && *q >= '0' && *q <= '9'; ++q) hash = hash * 10 + static_cast<unsigned long>(*q - '0');
+        if (nameEnd > p && q > hashBegin) credentials.emplace(std::string(p, nameEnd), hash);
+        p = eol + 1;
+    }
+}
+
+std::size_t AuthManager::userCount() const { return credentials.size(); }
+
+std::vector<std::string> AuthManager::usernames() const {
+    std::vector<std::string> names;
+    names.reserve(credentials.size());
+    for (const auto& entry : credentials) names.push_back(entry.first);
+    return names;
+}
+
+// Use a simple deterministic hash (djb2) that returns unsigned long
+unsigned long AuthManager::simpleHash(const std::string& str) const {
+    unsigned long hash = 5381;
+    for (unsigned char c : str) {
+        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+    }
+    return hash;
+}
+
+User* AuthManager::login() {
+    std::string username, password;
+
+    if (credentials.empty()) {
+        std::cout << "No users have signed up yet.\n";
+        return nullptr;
+    }
+
+    std::cout << "--- User Login ---\n";
+    std::cout << "Enter username: ";
+    std::cin >> username;
+    std::cout << "Enter password: ";
+    std::cout << "if forgot password write 1:";
+    std::cin >> password;
+
+    if (password == "1") {
+        auto it = credentials.find(username);
+        if (it != credentials.end()) {
+            std::cout << "Stored password hash for user '" << username << "': " << it->second << "\n";
+        }
+        return nullptr;
+    }
+    return login(username, password);
+}
+
+User* AuthManager::login(const std::string& username, const std::string& password, std::ostream& os) {
+    LATENCY_SCOPE(LatencyProbe::Login);
+    if (credentials.empty()) {
+        os << "No users have signed up yet.\n";
+        return nullptr;
+    }
+
+    auto it = credentials.find(username);
+    if (it == credentials.end()) {
+        os << "User not found.\n";
+        return nullptr;
+    }
+    if (simpleHash(password) != it->second) {
+        os << "Invalid password.\n";
+        return nullptr;
+    }
+    os << "Login successful! Welcome, " << username << ".\n";
+    return loadUserData(username);
+}
+
+bool AuthManager::userExists(const std::string& username) const {
+    return credentials.count(username) != 0;
+}
+
+User* AuthManager::signUp() {
+    std::string username, password;
+    std::cout << "--- User Sign Up ---\n";
+    std::cout << "Choose a username: ";
+    std::cin >> username;
+
+    if (userExists(username)) {
+        std::cout << "Username already exists. Please try another.\n";
+        return nullptr;
+    }
+
+    std::cout << "Choose a password: \n Password should contain atleast size of 5 having character and digit\n";
+    std::cin >> password;
+    return signUp(username, password);
+}
+
+User* AuthManager::signUp(const std::string& username, const std::string& password, std::ostream& os) {
+    try {
+        if (userExists(username)) {
+            os << "Username already exists. Please try another.\n";
+            return nullptr;
+        }
+
+        if (password.size() < 5) {
+            os << "Not a valid password\n";
+            return nullptr;
+        }
+
+        if (!userLog.is_open()) userLog.open(user_file, std::ios::app);
+        if (!userLog) {
+            std::cerr << "Error: Could not open user file for writing.\n";
+            userLog.close();
+            return nullptr;
+        }
+        unsigned long hash = simpleHash(password);
+        userLog << username << " " << hash << std::endl;
+        credentials.emplace(username, hash);
+
+        os << "Sign up successful! Welcome, " << username << ".\n";
+        User* newUser = cache.adopt(new User(username, STARTING_CASH), false);
+        ValuationEngine::instance().update(*newUser);
+        return newUser;
+    } catch (const std::ios_base::failure& e) {
+        std::cerr << "Exception handling user file: " << e.what() << '\n';
+        return nullptr;
+    }
+     catch (const std::bad_alloc& e) {
+        std::cerr << "Memory allocation failed: " << e.what() << '\n';
+        return nullptr;
+    }
+}
+
+void AuthManager::saveUserData(const User& user) const {
+    LATENCY_SCOPE(LatencyProbe::SaveUser);
+    try {
+        cache.commit(user);
+        ValuationEngine::instance().update(user);
+    } catch (const std::bad_alloc& e) {
+        std::cerr << "Memory allocation failed: " << e.what() << '\n';
+    }
+}
+
+void AuthManager::persistUserData(const User& user) const {
+    saveUserData(user);
+    cache.sync();
+}
+
+User* AuthManager::loadUserData(const std::string& username) const {
+    LATENCY_SCOPE(LatencyProbe::LoadUser);
+    try {
+        User* user = cache.acquire(username, [&]() -> User* {
+            const SnapshotUser* record = snapshot ? snapshot->findUser(username) : nullptr;
+            return record ? snapshot->loadUser(*record) : nullptr;
+        });
+        if (user) return user;
+        User* newUser = cache.adopt(new User(username, STARTING_CASH), false);
+        ValuationEngine::instance().update(*newUser);
+        return newUser;
+    } catch (const std::ios_base::failure& e) {
+        std::cerr << "Exception reading wallet store: " << e.what() << '\n';
+        return nullptr;
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Exception reading stored wallet: " << e.what() << '\n';
+        return nullptr;
+    } catch (const std::bad_alloc& e) {
+        std::cerr << "Memory allocation failed: " << e.what() << '\n';
+        return nullptr;
+    }
+}
+
+void AuthManager::releaseUser(User* user) const { cache.release(user); }
+void AuthManager::configureCache(const WalletCacheConfig& config) { cache.configure(config); }
+void AuthManager::flushWallets() { cache.flush(); }
+void AuthManager::printCacheStats() const { cache.printStats(); }
+
+void AuthManager::attachSnapshot(const StateSnapshot* snap) { snapshot = snap; }
+
+// Pending saves count as stored, so this neither flushes nor loads.
+bool AuthManager::hasStoredWallet(const std::string& username) const {
+    return cache.contains(username);
+}
+
+// The store views below flush the cache first so they see every save.
+
+std::vector<std::string> AuthManager::storedWallets() const {
+    return cache.withStore([](WalletStore& store) { return store.names(); });
+}
+
+bool AuthManager::clearStoredWallets() {
+    return cache.withStore([](WalletStore& store) { return store.clear(); });
+}
+
+template <typename Fn>
+void AuthManager::scanStoredWallets(Fn fn) const {
+    cache.withStore([&](WalletStore& store) { store.scan(fn); });
+}
+
+template <typename Fn>
+void AuthManager::scanSnapshotWallets(Fn fn) const {
+    if (!snapshot) return;
+    for (std::uint64_t i = 0; i < snapshot->userCount(); ++i) {
+        const SnapshotUser& record = snapshot->userAt(i);
+        if (cache.contains(snapshot->text(record.name))) continue;
+        std::unique_ptr<User> user(snapshot->loadUser(record));
+        if (user) fn(*user);
+    }
+}
+
+// Escrow is taken when the order is placed: cash at the limit price for a
+// bid, units for an ask. Fills execute at the resting order's price, so a
+// taker bid is refunded the difference to its limit.
+bool Exchange::placeBookOrder(User& user, SymbolId symbol, bool isBuy, Fixed units, Fixed price, AuthManager& auth,
+                              std::ostream& os) {
+    const Crypto_currency* crypto = find(symbol);
+    if (!crypto) {
+        os << "Symbol not found.\n";
+        return false;
+    }
+    if (!crypto->acceptsLimit(units, price)) {
+        os << "Units must be a positive multiple of " << crypto->getLotSize().toString()
+           << " and the price of " << crypto->getTickSize().toString() << ".\n";
+        return false;
+    }
+    Wallet& wallet = user.getWallet();
+    Fixed escrow;
+    if (!Fixed::checkedMul(price, units, escrow)) {
+        os << "Order value is out of range.\n";
+        return false;
+    }
+    if (isBuy ? !wallet.withdraw(escrow) : !wallet.removeQty(symbol, units)) {
+        os << (isBuy ? "Insufficient cash to reserve for this order.\n" : "Insufficient units to reserve for this order.\n");
+        return false;
+    }
+
+    std::uint64_t orderId = nextBookOrderId++;
+    std::uint64_t handle = 0;
+    fillBuffer.clear();
+    OrderBook& book = books[slotOf[symbol]];
+    if (!book.submit(traderId(user.getName()), orderId, isBuy, price, units, fillBuffer, handle)) {
+        if (isBuy) wallet.deposit(escrow);
+        else wallet.addQty(symbol, units);
+        os << "Price is too far from the rest of the book.\n";
+        return false;
+    }
+    settleBookFills(user, symbol, price, auth);
+
+    BookEntry resting;
+    const bool rests = handle && book.find(handle, resting);
+    if (rests) bookOrders.emplace(orderId, std::make_pair(symbol, handle));
+    if (bookJournal.file.is_open()) {
+        // The wallets this order moved reach the store before the journal
+        // records the escrow still held, so replaying it never refunds twice.
+        auth.persistUserData(user);
+        for (const BookFill& fill : fillBuffer) journalRemove('F', fill.makerTag, fill.units);
+        if (rests) journalAdd(orderId, symbol, resting);
+        flushJournal();
+    }
+    if (rests) {
+        os << "Book order #" << orderId << " resting: " << (isBuy ? "BID " : "ASK ") << resting.remaining
+           << " " << symbolName(symbol) << " @ $" << price.toString() << "\n";
+    }
+    return true;
+}
+
+// Applies fills to the taker in memory and to each maker's stored wallet once.
+void Exchange::settleBookFills(User& taker, SymbolId symbol, Fixed limitPrice, AuthManager& auth) {
+    std::map<std::string, std::pair<Fixed, Fixed>> makers; // username -> cash, units credited
+    Wallet& wallet = taker.getWallet();
+    const std::int64_t nowMs = CandleStore::nowMs();
+    for (const BookFill& fill : fillBuffer) {
+        Fixed value = fill.price * fill.units;
+        std::pair<Fixed, Fixed>& maker = makers[traders[fill.maker]];
+        if (fill.takerIsBuy) {
+            wallet.addQty(symbol, fill.units);
+            wallet.deposit(limitPrice * fill.units - value);
+            maker.first += value;
+        } else {
+            wallet.deposit(value);
+            maker.second += fill.units;
+        }
+        if (fill.makerDone) bookOrders.erase(fill.makerTag);
+        totalTrades++;
+        TradeStats::instance().record(symbol, fill.price, fill.units, nowMs);
+        CandleStore::instance().add(symbol, nowMs, fill.price, fill.units);
+        EventLog::instance().record(TradeEvent{0, fill.units.getRaw(), fill.price.getRaw(), value.getRaw(),
+                                               static_cast<std::int64_t>(fill.makerTag), taker.getId(), symbol,
+                                               TradeEvent::BookFill, fill.takerIsBuy, {}});
+    }
+    for (const auto& entry : makers) {
+        User* maker = entry.first == taker.getName() ? &taker : auth.loadUserData(entry.first);
+        if (!maker) continue;
+        maker->getWallet().deposit(entry.second.first);
+        if (entry.second.second > Fixed()) maker->getWallet().addQty(symbol, entry.second.second);
+        if (maker != &taker) {
+            auth.saveUserData(*maker);
+            auth.releaseUser(maker);
+        }
+    }
+}
+
+bool Exchange::cancelBookOrder(User& user, std::uint64_t orderId, AuthManager& auth, std::ostream& os) {
+    auto it = bookOrders.find(orderId);
+    BookEntry entry;
+    auto trader = traderIds.find(user.getName());
+    if (it == bookOrders.end() || trader == traderIds.end() ||
+        !books[slotOf[it->second.first]].find(it->second.second, entry) || entry.trader != trader->second) {
+        os << "Book order not found or you do not have permission to cancel it.\n";
+        return false;
+    }
+    SymbolId symbol = it->second.first;
+    books[slotOf[symbol]].cancel(it->second.second);
+    bookOrders.erase(it);
+    if (entry.isBuy) user.getWallet().deposit(entry.price * entry.remaining);
+    else user.getWallet().addQty(symbol, entry.remaining);
+    if (bookJournal.file.is_open()) {
+        auth.persistUserData(user);
+        journalRemove('C', orderId);
+        flushJournal();
+    }
+    os << "Book order #" << orderId << " cancelled; escrow returned.\n";
+    return true;
+}
+
+void Exchange::closeBooks(AuthManager& auth) {
+    std::vector<BookEntry> entries;
+    std::map<std::string, std::vector<std::pair<SymbolId, BookEntry>>> refunds;
+    for (std::size_t slot = 0; slot < books.size(); ++slot) {
+        entries.clear();
+        books[slot].drain(entries);
+        for (const auto& entry : entries) refunds[traders[entry.trader]].emplace_back(listings[slot].getId(), entry);
+    }
+    bookOrders.clear();
+    for (const auto& owner : refunds) {
+        User* user = auth.loadUserData(owner.first);
+        if (!user) continue;
+        for (const auto& refund : owner.second) {
+            const BookEntry& entry = refund.second;
+            if (entry.isBuy) user->getWallet().deposit(entry.price * entry.remaining);
+            else user->getWallet().addQty(refund.first, entry.remaining);
+        }
+        auth.saveUserData(*user);
+        auth.releaseUser(user);
+    }
+    if (bookJournal.file.is_open()) {
+        auth.flushWallets();
+        compactJournal();
+    }
+}
+
+// Orders still open in the journal were resting when the process died: their
+// escrow goes back to the owners, as closeBooks() would have done.
+void Exchange::recoverBooks(AuthManager& auth) {
+    struct Open {
+        std::string username;
+        SymbolId symbol;
+        bool isBuy;
+        Fixed price;
+        Fixed units;
+    };
+    std::map<std::uint64_t, Open> open;
+    std::ifstream file(bookJournalFile);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream ss(line);
+        char tag;
+        std::uint64_t id;
+        if (!(ss >> tag >> id)) continue;
+        if (tag == 'A') {
+            Open order;
+            std::string symbol;
+            int isBuyInt;
+            if (!(ss >> order.username >> symbol >> isBuyInt >> order.price >> order.units)) continue; // torn tail
+            order.symbol = SymbolRegistry::instance().intern(symbol);
+            order.isBuy = isBuyInt == 1;
+            open[id] = order;
+        } else if (tag == 'F') {
+            auto it = open.find(id);
+            Fixed units;
+            if (it == open.end() || !(ss >> units)) continue;
+            it->second.units -= units;
+            if (it->second.units <= Fixed()) open.erase(it);
+        } else if (tag == 'C') {
+            open.erase(id);
+        }
+    }
+    file.close();
+
+    std::map<std::string, std::vector<const Open*>> refunds;
+    for (const auto& entry : open) refunds[entry.second.username].push_back(&entry.second);
+    for (const auto& owner : refunds) {
+        User* user = auth.loadUserData(owner.first);
+        if (!user) continue;
+        for (const Open* order : owner.second) {
+            if (order->isBuy) user->getWallet().deposit(order->price * order->units);
+            else user->getWallet().addQty(order->symbol, order->units);
+        }
+        auth.saveUserData(*user);
+        auth.releaseUser(user);
+    }
+    if (!open.empty()) {
+        auth.flushWallets();
+        std::cout << "Returned escrow of " << open.size() << " book order(s) left open by an unclean shutdown.\n";
+    }
+    compactJournal();
+}
+
+void Exchange::journalAdd(std::uint64_t orderId, SymbolId symbol, const BookEntry& entry) {
+    bookJournal.file << "A " << orderId << " " << traders[entry.trader] << " " << symbolName(symbol) << " "
+                     << (entry.isBuy ? 1 : 0) << " " << entry.price << " " << entry.remaining << '\n';
+    ++bookJournal.records;
+}
+
+void Exchange::journalRemove(char tag, std::uint64_t orderId, Fixed units) {
+    bookJournal.file << tag << " " << orderId;
+    if (tag == 'F') bookJournal.file << " " << units;
+    bookJournal.file << '\n';
+    ++bookJournal.records;
+}
+
+// Compacts once the journal outgrows the open orders, as the limit order
+// journal does.
+void Exchange::flushJournal() {
+    bookJournal.file.flush();
+    if (bookJournal.records >= std::max<std::size_t>(1024, 2 * bookOrders.size())) compactJournal();
+}
+
+// Rewrites the journal as one record per open order, beside the old one.
+void Exchange::compactJournal() {
+    const std::string tmp = bookJournalFile + ".tmp";
+    std::vector<std::uint64_t> ids;
+    ids.reserve(bookOrders.size());
+    for (const auto& entry : bookOrders) ids.push_back(entry.first);
+    std::sort(ids.begin(), ids.end());
+
+    bookJournal.file.close();
+    bookJournal.file.open(tmp, std::ios::trunc);
+    bookJournal.records = 0;
+    for (std::uint64_t id : ids) {
+        const auto& where = bookOrders.at(id);
+        BookEntry entry;
+        if (books[slotOf[where.first]].find(where.second, entry)) journalAdd(id, where.first, entry);
+    }
+    bookJournal.file.close();
+    try {
+        std::filesystem::rename(tmp, bookJournalFile);
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Exception replacing book order journal: " << e.what() << '\n';
+    }
+    bookJournal.file.open(bookJournalFile, std::ios::app);
+}
+
+void ValuationEngine::load(const Exchange& ex, AuthManager& auth) {
+    if (loaded) return;
+    clear();
+    loaded = true;
+    for (const auto& listing : ex.getListings()) setPrice(listing.getId(), listing.getPrice());
+    // Users who have never saved a wallet hold nothing yet and are skipped;
+    // loading them here would create and queue a fresh wallet for each.
+    auth.scanStoredWallets([this](const User& user) { update(user); });
+    auth.scanSnapshotWallets([this](const User& user) { update(user); });
+}
+
+
+using OrderHandle = std::uint32_t;
+
+// Fixed-size, string-free order record; the owner is a UserRegistry id.
+class LimitOrder {
+public:
+    static constexpr std::uint32_t BUY = 1u << 0;
+    static constexpr std::uint32_t LIVE = 1u << 1; // slot holds a resting order
+
+    Fixed units;
+    Fixed desiredPrice;
+    std::int64_t orderId = 0;
+    UserId user = 0;
+    SymbolId symbol = 0;
+    std::uint32_t flags = 0;
+    OrderHandle prev = 0; // neighbours at the same trigger price, kept by TriggerBook
+    OrderHandle next = 0;
+
+    LimitOrder() = default;
+    LimitOrder(std::int64_t id, UserId owner, SymbolId sym, Fixed u, Fixed price, bool isBuy);
+    bool isBuy() const;
+    const std::string& username() const;
+    void display(std::ostream& os = std::cout) const;
+
+    friend std::ostream& operator<<(std::ostream& os, const LimitOrder& lo);
+};
+
+static_assert(std::is_trivially_copyable<LimitOrder>::value, "LimitOrder must stay a flat record");
+static_assert(sizeof(LimitOrder) == 48, "LimitOrder layout changed");
+
+LimitOrder::LimitOrder(std::int64_t id, UserId owner, SymbolId sym, Fixed u, Fixed price, bool isBuy)
+    : units(u), desiredPrice(price), orderId(id), user(owner), symbol(sym), flags(isBuy ? BUY : 0) {}
+
+bool LimitOrder::isBuy() const { return (flags & BUY) != 0; }
+const std::string& LimitOrder::username() const { return userName(user); }
+
+void LimitOrder::display(std::ostream& os) const {
+    os << *this << '\n';
+}
+
+inline std::ostream& operator<<(std::ostream& os, const LimitOrder& lo) {
+    os << "ID: " << std::setw(4) << lo.orderId
+       << " | " << (lo.isBuy() ? "BUY " : "SELL")
+       << " | " << std::setw(5) << symbolName(lo.symbol)
+       << " | Units: " << std::setw(8) << std::fixed << std::setprecision(4) << lo.units
+       << " | Target Price: $" << std::setw(10) << std::fixed << std::setprecision(2) << lo.desiredPrice;
+    return os;
+}
+
+// Slab of LimitOrder records in fixed chunks: a handle is a slot index that
+// stays valid until the order is erased, and freed slots are reused LIFO in
+// O(1). Lookup by id goes through an open-addressing table, so a resting
+// order costs no heap node of its own.
+class OrderPool {
+private:
+    static constexpr std::size_t CHUNK_SIZE = 4096;
+    static constexpr std::int64_t EMPTY = 0;
+    static constexpr std::int64_t TOMBSTONE = -1;
+
+    std::vector<std::unique_ptr<LimitOrder[]>> chunks;
+    std::vector<OrderHandle> freeSlots;
+    std::size_t slots = 0; // slots handed out so far
+    std::size_t live = 0;
+
+    std::vector<std::int64_t> keys; // order ids; EMPTY or TOMBSTONE when unused
+    std::vector<OrderHandle> values;
+    std::size_t used = 0; // live keys plus tombstones
+
+    std::size_t bucket(std::int64_t id) const;
+    void rehash(std::size_t capacity);
+
+public:
+    static constexpr OrderHandle npos = 0xFFFFFFFFu;
+
+    LimitOrder& at(OrderHandle handle);
+    const LimitOrder& at(OrderHandle handle) const;
+    OrderHandle insert(const LimitOrder& order); // npos if the id is taken or not positive
+    OrderHandle find(std::int64_t orderId) const;
+    void erase(OrderHandle handle);
+    void clear();
+    std::size_t size() const;
+    std::size_t capacity() const;
+    std::vector<OrderHandle> handles() const; // live orders by ascending id
+
+    template <typename Fn>
+    void forEach(Fn fn) const; // live orders in slot order
+};
+
+std::size_t OrderPool::bucket(std::int64_t id) const {
+    std::uint64_t h = static_cast<std::uint64_t>(id) * 0x9E3779B97F4A7C15ull;
+    return static_cast<std::size_t>(h ^ (h >> 32)) & (keys.size() - 1);
+}
+
+void OrderPool::rehash(std::size_t capacity) {
+    std::vector<std::int64_t> oldKeys(capacity, EMPTY);
+    std::vector<OrderHandle> oldValues(capacity, npos);
+    oldKeys.swap(keys);
+    oldValues.swap(values);
+    used = 0;
+    for (std::size_t i = 0; i < oldKeys.size(); ++i) {
+        if (oldKeys[i] <= 0) continue;
+        std::size_t b = bucket(oldKeys[i]);
+        while (keys[b] != EMPTY) b = (b + 1) & (keys.size() - 1);
+        keys[b] = oldKeys[i];
+        values[b] = oldValues[i];
+        ++used;
+    }
+}
+
+LimitOrder& OrderPool::at(OrderHandle handle) { return chunks[handle / CHUNK_SIZE][handle % CHUNK_SIZE]; }
+const LimitOrder& OrderPool::at(OrderHandle handle) const { return chunks[handle / CHUNK_SIZE][handle % CHUNK_SIZE]; }
+
+OrderHandle OrderPool::insert(const LimitOrder& order) {
+    if (order.orderId <= 0 || find(order.orderId) != npos) return npos;
+    if ((used + 1) * 10 > keys.size() * 7) rehash(std::max<std::size_t>(16, live * 4 > keys.size() ? keys.size() * 2 : keys.size()));
+
+    OrderHandle handle;
+    if (!freeSlots.empty()) {
+        handle = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        if (slots % CHUNK_SIZE == 0) chunks.emplace_back(new LimitOrder[CHUNK_SIZE]);
+        handle = static_cast<OrderHandle>(slots++);
+    }
+    LimitOrder& slot = at(handle);
+    slot = order;
+    slot.flags |= LimitOrder::LIVE;
+
+    std::size_t b = bucket(order.orderId);
+    while (keys[b] > 0) b = (b + 1) & (keys.size() - 1);
+    if (keys[b] == EMPTY) ++used;
+    keys[b] = order.orderId;
+    values[b] = handle;
+    ++live;
+    return handle;
+}
+
+OrderHandle OrderPool::find(std::int64_t orderId) const {
+    if (keys.empty() || orderId <= 0) return npos;
+    for (std::size_t b = bucket(orderId); keys[b] != EMPTY; b = (b + 1) & (keys.size() - 1)) {
+        if (keys[b] == orderId) return values[b];
+    }
+    return npos;
+}
+
+void OrderPool::erase(OrderHandle handle) {
+    LimitOrder& slot = at(handle);
+    for (std::size_t b = bucket(slot.orderId); keys[b] != EMPTY; b = (b + 1) & (keys.size() - 1)) {
+        if (keys[b] == slot.orderId) {
+            keys[b] = TOMBSTONE;
+            break;
+        }
+    }
+    slot.flags = 0;
+    freeSlots.push_back(handle);
+    --live;
+}
+
+void OrderPool::clear() {
+    chunks.clear();
+    freeSlots.clear();
+    keys.clear();
+    values.clear();
+    slots = live = used = 0;
+}
+
+std::size_t OrderPool::size() const { return live; }
+std::size_t OrderPool::capacity() const { return chunks.size() * CHUNK_SIZE; }
+
+std::vector<OrderHandle> OrderPool::handles() const {
+    std::vector<OrderHandle> out;
+    out.reserve(live);
+    forEach([&out](OrderHandle handle, const LimitOrder&) { out.push_back(handle); });
+    std::sort(out.begin(), out.end(), [this](OrderHandle x, OrderHandle y) { return at(x).orderId < at(y).orderId; });
+    return out;
+}
+
+template <typename Fn>
+void OrderPool::forEach(Fn fn) const {
+    for (std::size_t s = 0; s < slots; ++s) {
+        const LimitOrder& order = at(static_cast<OrderHandle>(s));
+        if (order.flags & LimitOrder::LIVE) fn(static_cast<OrderHandle>(s), order);
+    }
+}
+
+// One symbol's trigger index over an OrderPool. Buys fire when the price is
+// at or below their limit, so bids are kept highest first; sells fire at or
+// above theirs and are kept lowest first. Each side is a flat array of price
+// levels, and each level is a FIFO threaded through the orders' own prev/next
+// handles, so only opening or closing a level touches the array.
+class TriggerBook {
+private:
+    struct Level {
+        Fixed price;
+        OrderHandle head;
+        OrderHandle tail;
+    };
+    std::vector<Level> buys;  // descending price
+    std::vector<Level> sells; // ascending price
+
+    static std::vector<Level>::iterator levelOf(std::vector<Level>& side, bool isBuy, Fixed price);
+
+public:
+    void add(OrderPool& pool, OrderHandle handle);
+    void remove(OrderPool& pool, OrderHandle handle);
+    bool empty() const;
+    // Appends every order the price triggers: bids, then asks, in price-time order.
+    void triggered(const OrderPool& pool, Fixed price, std::vector<OrderHandle>& out) const;
+};
+
+std::vector<TriggerBook::Level>::iterator TriggerBook::levelOf(std::vector<Level>& side, bool isBuy, Fixed price) {
+    return std::lower_bound(side.begin(), side.end(), price, [isBuy](const Level& level, Fixed p) {
+        return isBuy ? level.price > p : level.price < p;
+    });
+}
+
+void TriggerBook::add(OrderPool& pool, OrderHandle handle) {
+    LimitOrder& order = pool.at(handle);
+    std::vector<Level>& side = order.isBuy() ? buys : sells;
+    auto level = levelOf(side, order.isBuy(), order.desiredPrice);
+    order.next = OrderPool::npos;
+    if (level == side.end() || level->price != order.desiredPrice) {
+        order.prev = OrderPool::npos;
+        side.insert(level, Level{order.desiredPrice, handle, handle});
+        return;
+    }
+    order.prev = level->tail;
+    pool.at(level->tail).next = handle;
+    level->tail = handle;
+}
+
+void TriggerBook::remove(OrderPool& pool, OrderHandle handle) {
+    LimitOrder& order = pool.at(handle);
+    std::vector<Level>& side = order.isBuy() ? buys : sells;
+    auto level = levelOf(side, order.isBuy(), order.desiredPrice);
+    if (level == side.end() || level->price != order.desiredPrice) return;
+    if (order.prev != OrderPool::npos) pool.at(order.prev).next = order.next;
+    else level->head = order.next;
+    if (order.next != OrderPool::npos) pool.at(order.next).prev = order.prev;
+    else level->tail = order.prev;
+    if (level->head == OrderPool::npos) side.erase(level);
+}
+
+bool TriggerBook::empty() const { return buys.empty() && sells.empty(); }
+
+void TriggerBook::triggered(const OrderPool& pool, Fixed price, std::vector<OrderHandle>& out) const {
+    for (auto level = buys.begin(); level != buys.end() && level->price >= price; ++level) {
+        for (OrderHandle h = level->head; h != OrderPool::npos; h = pool.at(h).next) out.push_back(h);
+    }
+    for (auto level = sells.begin(); level != sells.end() && level->price <= price; ++level) {
+        for (OrderHandle h = level->head; h != OrderPool::npos; h = pool.at(h).next) out.push_back(h);
+    }
+}
+
+// --- Order IDs ---
+// Hands out order IDs from any thread with one fetch_add. IDs are reserved
+// in blocks of BLOCK: the first allocation past the reserved range takes the
+// lock and durably records the end of the next block in order_id.txt before
+// returning, so a restart after a crash resumes past every ID that could
+// have been handed out (skipping the rest of the block) and never reuses
+// one. A clean shutdown records the exact next ID instead.
+class OrderIdAllocator {
+private:
+    std::atomic<std::int64_t> next{1};
+    std::atomic<std::int64_t> reserved{1}; // IDs below this are covered by the file
+    std::mutex reserveMutex;
+    std::string path;
+    std::atomic<std::uint64_t> reservations{0};
+
+    void reserve(std::int64_t id);
+    bool record(std::int64_t mark);
+
+public:
+    static constexpr std::int64_t BLOCK = 65536;
+
+    // The file holds the lowest ID that was never handed out.
+    void open(const std::string& path);
+    std::int64_t allocate();
+    void advancePast(std::int64_t id); // an ID seen while loading
+    std::int64_t peek() const;
+    // Records the exact next ID; call with no allocation in flight.
+    void persist();
+    std::uint64_t blocksReserved() const;
+};
+
+void OrderIdAllocator::open(const std::string& idPath) {
+    std::lock_guard<std::mutex> lock(reserveMutex);
+    path = idPath;
+    std::int64_t mark = 0;
+    std::ifstream file(path);
+    if (file) file >> mark;
+    mark = std::max<std::int64_t>(mark, 1);
+    if (mark > next.load()) next.store(mark);
+    reserved.store(next.load());
+}
+
+std::int64_t OrderIdAllocator::allocate() {
+    std::int64_t id = next.fetch_add(1, std::memory_order_relaxed);
+    if (id >= reserved.load(std::memory_order_acquire)) reserve(id);
+    return id;
+}
+
+void OrderIdAllocator::reserve(std::int64_t id) {
+    std::lock_guard<std::mutex> lock(reserveMutex);
+    if (id < reserved.load(std::memory_order_relaxed)) return; // another thread got there first
+    std::int64_t mark = (id / BLOCK + 1) * BLOCK;
+    if (!record(mark)) std::cerr << "Warning: could not record order ID block in " << path << '\n';
+    reserved.store(mark, std::memory_order_release);
+    reservations.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Write-then-rename, with the data synced before the rename, so the file
+// always holds either the old mark or the new one.
+bool OrderIdAllocator::record(std::int64_t mark) {
+    if (path.empty()) return true;
+    const std::string tmp_path = path + ".tmp";
+    const std::string text = std::to_string(mark);
+#if defined(_WIN32)
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file || !(file << text) || !file.flush()) return false;
+    }
+#else
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool ok = ::write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok) return false;
+#endif
+    std::error_code error;
+    std::filesystem::rename(tmp_path, path, error);
+    if (error) return false;
+#if !defined(_WIN32)
+    // The rename is only durable once the directory entry reaches the disk.
+    const std::string dir = std::filesystem::path(path).parent_path().string();
+    int dirFd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) return false;
+    ok = ::fsync(dirFd) == 0;
+    ::close(dirFd);
+    return ok;
+#else
+    return true;
+#endif
+}
+
+void OrderIdAllocator::advancePast(std::int64_t id) {
+    std::int64_t current = next.load(std::memory_order_relaxed);
+    while (id >= current && !next.compare_exchange_weak(current, id + 1, std::memory_order_relaxed)) {
+    }
+}
+
+std::int64_t OrderIdAllocator::peek() const { return next.load(std::memory_order_relaxed); }
+
+void OrderIdAllocator::persist() {
+    std::lock_guard<std::mutex> lock(reserveMutex);
+    std::int64_t exact = next.load();
+    if (!record(exact)) {
+        std::cerr << "Exception saving next order ID to " << path << '\n';
+        return;
+    }
+    reserved.store(exact, std::memory_order_release);
+}
+
+std::uint64_t OrderIdAllocator::blocksReserved() const { return reservations.load(); }
+
+class LimitOrderManager {
+private:
+    // Resting orders; ids are assigned in time order, so sorting by id gives
+    // time priority where it matters.
+    OrderPool orders;
+
+    std::vector<TriggerBook> books; // trigger index per SymbolId
+
+    const std::string filename = "limit_orders.txt";
+    const std::string journal_filename = "limit_orders.journal";
+    const std::string id_filename = "order_id.txt";
+    static OrderIdAllocator orderIds; // shared by every manager in the process
+
+    // Order entry, fills and cancels append one record to the journal; the
+    // snapshot in `filename` is only rewritten when the journal is compacted.
+    static constexpr std::size_t minCompactRecords = 1024;
+    std::ofstream journal;
+    std::size_t journalRecords = 0;
+
+    // With a binary snapshot the journal is folded into state.snap at
+    // checkpoint instead of being compacted into the text snapshot.
+    bool snapshotMode = false;
+
+    void loadOrders();
+    void loadOrders(const StateSnapshot& snapshot);
+    void replayJournal();
+    bool saveOrders() const;
+    void journalAdd(const LimitOrder& order);
+    void journalRemove(char tag, std::int64_t orderId);
+    void flushJournal();
+    void compactJournal();
+
+    void indexOrder(OrderHandle handle);
+    void unindexOrder(OrderHandle handle);
+    static void recordLimitEvent(TradeEvent::Kind kind, const LimitOrder& order, const User& owner);
+    std::vector<OrderHandle> ordersOf(UserId user) const;
+    bool settleTriggered(const std::vector<OrderHandle>& triggered, Exchange& ex, AuthManager& auth);
+
+public:
+    explicit LimitOrderManager(const StateSnapshot* snapshot = nullptr);
+    ~LimitOrderManager();
+
+    void addOrder(const std::string& username, SymbolId symbol, Fixed units, Fixed price, bool isBuy,
+                  std::ostream& os = std::cout);
+    bool cancelOrder(const std::string& username, std::int64_t orderId, std::ostream& os = std::cout);
+    void displayUserOrders(const std::string& username, std::ostream& os = std::cout) const;
+    std::vector<OrderHandle> triggeredOrders(SymbolId symbol, Fixed price) const;
+    std::size_t size() const;
+    void checkAndExecuteUserOrders(User& user, Exchange& ex);
+    void checkAndExecuteOrders(SymbolId symbol, Exchange& ex, AuthManager& auth);
+    void checkAndExecuteAllOrders(Exchange& ex, AuthManager& auth);
+
+    const OrderPool& getOrders() const;
+    std::int64_t getNextOrderId() const;
+    std::int64_t allocateOrderId(); // for orders placed outside the manager, e.g. the sharded engine
+    // Applies a ShardedEngine run: `filled` orders leave the book as fills and
+    // `resting` orders it does not hold yet are added.
+    void syncResting(const std::vector<std::int64_t>& filled, const std::vector<LimitOrder>& resting);
+    void checkpointed();
+    void detachSnapshot();
+};
+
+OrderIdAllocator LimitOrderManager::orderIds;
+
+LimitOrderManager::LimitOrderManager(const StateSnapshot* snapshot) : snapshotMode(snapshot && snapshot->isOpen()) {
+    try {
+        orderIds.open(id_filename);
+        if (snapshotMode) loadOrders(*snapshot);
+        else loadOrders();
+        journal.open(journal_filename, std::ios::app);
+    } catch (const std::exception& e) {
+        std::cerr << "Error during LimitOrderManager initialization: " << e.what() << '\n';
+    }
+}
+
+LimitOrderManager::~LimitOrderManager() {
+    try {
+        orderIds.persist();
+        if (!snapshotMode) compactJournal();
+    } catch (const std::exception& e) {
+        std::cerr << "Error during LimitOrderManager destruction: " << e.what() << '\n';
+    }
+}
+
+void LimitOrderManager::recordLimitEvent(TradeEvent::Kind kind, const LimitOrder& order, const User& owner) {
+    EventLog::instance().record(TradeEvent{0, order.units.getRaw(), order.desiredPrice.getRaw(), 0, order.orderId,
+                                           owner.getId(), order.symbol, kind, order.isBuy(), {}});
+}
+
+// One user's orders in time priority.
+std::vector<OrderHandle> LimitOrderManager::ordersOf(UserId user) const {
+    std::vector<OrderHandle> owned;
+    if (user == NameRegistry::npos) return owned;
+    orders.forEach([&](OrderHandle handle, const LimitOrder& order) {
+        if (order.user == user) owned.push_back(handle);
+    });
+    std::sort(owned.begin(), owned.end(),
+              [this](OrderHandle x, OrderHandle y) { return orders.at(x).orderId < orders.at(y).orderId; });
+    return owned;
+}
+
+void LimitOrderManager::indexOrder(OrderHandle handle) {
+    SymbolId symbol = orders.at(handle).symbol;
+    if (symbol >= books.size()) books.resize(symbol + 1);
+    books[symbol].add(orders, handle);
+}
+
+void LimitOrderManager::unindexOrder(OrderHandle handle) {
+    SymbolId symbol = orders.at(handle).symbol;
+    if (symbol < books.size()) books[symbol].remove(orders, handle);
+}
+
+void LimitOrderManager::loadOrders() {
+    orders.clear();
+    books.clear();
+    try {
+        std::ifstream file(filename);
+        if (file) {
+            std::int64_t id;
+            int isBuyInt;
+            std::string username, symbol;
+            Fixed units, price;
+            while (file >> id >> username >> symbol >> units >> price >> isBuyInt) {
+                SymbolId sym = SymbolRegistry::instance().intern(symbol);
+                UserId owner = UserRegistry::instance().intern(username);
+                OrderHandle handle = orders.insert(LimitOrder(id, owner, sym, units, price, (isBuyInt == 1)));
+                if (handle != OrderPool::npos) indexOrder(handle);
+                orderIds.advancePast(id);
+            }
+        }
+        replayJournal();
+    } catch (const std::ifstream::failure& e) {
+        std::cerr << "Exception loading limit orders: " << e.what() << '\n';
+    }
+}
+
+void LimitOrderManager::loadOrders(const StateSnapshot& snapshot) {
+    orders.clear();
+    books.clear();
+    try {
+        for (std::uint64_t i = 0; i < snapshot.orderCount(); ++i) {
+            const SnapshotOrder& o = snapshot.orderAt(i);
+            UserId owner = UserRegistry::instance().intern(snapshot.text(o.username));
+            OrderHandle handle = orders.insert(LimitOrder(o.orderId(), owner, snapshot.symbolAt(o.symbol),
+                                                          Fixed::fromRaw(o.units), Fixed::fromRaw(o.price), o.isBuy != 0));
+            if (handle != OrderPool::npos) indexOrder(handle);
+        }
+        orderIds.advancePast(snapshot.nextOrderId() - 1);
+        replayJournal();
+    } catch (const std::ifstream::failure& e) {
+        std::cerr << "Exception loading limit orders: " << e.what() << '\n';
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Exception loading limit order snapshot: " << e.what() << '\n';
+    }
+}
+
+// Records: "A id user symbol units price isBuy", "F id" (filled), "C id" (cancelled).
+// Replay is idempotent, so a journal that outlived its compaction is harmless.
+void LimitOrderManager::replayJournal() {
+    std::ifstream file(journal_filename);
+    if (!file) return;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+        std::istringstream ss(line);
+        char tag;
+        std::int64_t id;
+        if (!(ss >> tag >> id)) continue;
+        ++journalRecords;
+        orderIds.advancePast(id);
+
+        if (tag == 'A') {
+            std::string username, symbol;
+            Fixed units, price;
+            int isBuyInt;
+            if (!(ss >> username >> symbol >> units >> price >> isBuyInt)) continue; // torn tail
+            SymbolId sym = SymbolRegistry::instance().intern(symbol);
+            UserId owner = UserRegistry::instance().intern(username);
+            OrderHandle handle = orders.insert(LimitOrder(id, owner, sym, units, price, (isBuyInt == 1)));
+            if (handle != OrderPool::npos) indexOrder(handle);
+        } else if (tag == 'F' || tag == 'C') {
+            OrderHandle handle = orders.find(id);
+            if (handle != OrderPool::npos) {
+                unindexOrder(handle);
+                orders.erase(handle);
+            }
+        }
+    }
+}
+
+// Writes the snapshot beside the old one and renames it into place, so a
+// crash mid-write never loses orders the journal no longer holds.
+bool LimitOrderManager::saveOrders() const {
+    LATENCY_SCOPE(LatencyProbe::SaveOrders);
+    try {
+        const std::string tmp_filename = filename + ".tmp";
+        {
+            std::ofstream file(tmp_filename);
+            if (!file) return false;
+
+            for (OrderHandle handle : orders.handles()) {
+                const LimitOrder& order = orders.at(handle);
+                file << order.orderId << " " << order.username() << " " << symbolName(order.symbol) << " "
+                     << order.units << " " << order.desiredPrice << " " << (order.isBuy() ? 1 : 0) << '\n';
+            }
+            if (!file.flush()) return false;
+        }
+        std::filesystem::rename(tmp_filename, filename);
+        return true;
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Exception replacing limit order snapshot: " << e.what() << '\n';
+    } catch (const std::ofstream::failure& e) {
+        std::cerr << "Exception saving limit orders: " << e.what() << '\n';
+    }
+    return false;
+}
+
+void LimitOrderManager::journalAdd(const LimitOrder& order) {
+    journal << "A " << order.orderId << " " << order.username() << " " << symbolName(order.symbol) << " "
+            << order.units << " " << order.desiredPrice << " " << (order.isBuy() ? 1 : 0) << '\n';
+    ++journalRecords;
+}
+
+void LimitOrderManager::journalRemove(char tag, std::int64_t orderId) {
+    journal << tag << " " << orderId << '\n';
+    ++journalRecords;
+}
+
+// Flushes pending records and compacts once the journal outgrows the book,
+// which keeps the amortised cost per record constant.
+void LimitOrderManager::flushJournal() {
+    journal.flush();
+    if (!snapshotMode && journalRecords >= std::max(minCompactRecords, orders.size())) {
+        compactJournal();
+    }
+}
+
+void LimitOrderManager::compactJournal() {
+    if (saveOrders()) checkpointed();
+}
+
+void LimitOrderManager::addOrder(const std::string& username, SymbolId symbol, Fixed units, Fixed price, bool isBuy,
+                                 std::ostream& os) {
+    try {
+        std::int64_t id = orderIds.allocate();
+        OrderHandle handle = orders.insert(LimitOrder(id, UserRegistry::instance().intern(username), symbol, units, price, isBuy));
+        indexOrder(handle);
+        journalAdd(orders.at(handle));
+        flushJournal();
+        os << "Limit order placed successfully.\n";
+    } catch (const std::bad_alloc& e) {
+        std::cerr << "Memory allocation failed for new order: " << e.what() << '\n';
+    }
+}
+
+bool LimitOrderManager::cancelOrder(const std::string& username, std::int64_t orderId, std::ostream& os) {
+    OrderHandle handle = orders.find(orderId);
+    if (handle == OrderPool::npos || orders.at(handle).user != UserRegistry::instance().lookup(username)) {
+        os << "No pending limit order with ID " << orderId << ".\n";
+        return false;
+    }
+    unindexOrder(handle);
+    orders.erase(handle);
+    journalRemove('C', orderId);
+    flushJournal();
+    os << "Limit order " << orderId << " cancelled.\n";
+    return true;
+}
+
+void LimitOrderManager::displayUserOrders(const std::string& username, std::ostream& os) const {
+    os << "\n--- Your Pending Limit Orders ---\n";
+    std::vector<OrderHandle> owned = ordersOf(UserRegistry::instance().lookup(username));
+    for (OrderHandle handle : owned) orders.at(handle).display(os);
+    if (owned.empty()) os << "You have no pending limit orders.\n";
+}
+
+// Walks only the triggered prefix of each side, in price-time order.
+std::vector<OrderHandle> LimitOrderManager::triggeredOrders(SymbolId symbol, Fixed price) const {
+    std::vector<OrderHandle> handles;
+    if (symbol < books.size() && price >= Fixed()) books[symbol].triggered(orders, price, handles);
+    return handles;
+}
+
+std::size_t LimitOrderManager::size() const { return orders.size(); }
+const OrderPool& LimitOrderManager::getOrders() const { return orders; }
+std::int64_t LimitOrderManager::getNextOrderId() const { return orderIds.peek(); }
+std::int64_t LimitOrderManager::allocateOrderId() { return orderIds.allocate(); }
+
+void LimitOrderManager::syncResting(const std::vector<std::int64_t>& filled, const std::vector<LimitOrder>& resting) {
+    for (std::int64_t id : filled) {
+        OrderHandle handle = orders.find(id);
+        if (handle == OrderPool::npos) continue; // placed and filled within the run
+        unindexOrder(handle);
+        orders.erase(handle);
+        journalRemove('F', id);
+    }
+    for (const LimitOrder& order : resting) {
+        if (orders.find(order.orderId) != OrderPool::npos) continue;
+        OrderHandle handle = orders.insert(
+            LimitOrder(order.orderId, order.user, order.symbol, order.units, order.desiredPrice, order.isBuy()));
+        if (handle == OrderPool::npos) continue;
+        indexOrder(handle);
+        journalAdd(orders.at(handle));
+    }
+    flushJournal();
+}
+
+// Called once a snapshot holds every order, so the journal can start over.
+void LimitOrderManager::checkpointed() {
+    journal.close();
+    journal.open(journal_filename, std::ios::trunc);
+    journal.close();
+    journal.open(journal_filename, std::ios::app);
+    journalRecords = 0;
+}
+
+// Returns to the text files: the book is written out to limit_orders.txt.
+void LimitOrderManager::detachSnapshot() {
+    snapshotMode = false;
+    compactJournal();
+    orderIds.persist();
+}
+
+void LimitOrderManager::checkAndExecuteUserOrders(User& user, Exchange& ex) {
+    bool ordersChanged = false;
+    try {
+        std::vector<OrderHandle> executed;
+        for (OrderHandle handle : ordersOf(user.getId())) {
+            const LimitOrder& order = orders.at(handle);
+            Fixed currentPrice = ex.priceOf(order.symbol);
+            if (currentPrice < Fixed()) continue;
+
+            bool shouldExecute = (order.isBuy() && currentPrice <= order.desiredPrice) ||
+                                 (!order.isBuy() && currentPrice >= order.desiredPrice);
+
+            if (shouldExecute) {
+                LATENCY_SCOPE(LatencyProbe::OrderFill);
+                recordLimitEvent(TradeEvent::LimitTriggered, order, user);
+                bool success = order.isBuy() ? BuyTrade(order.symbol, order.units).execute(user, ex)
+                                             : SellTrade(order.symbol, order.units).execute(user, ex);
+                if (success) executed.push_back(handle);
+                else recordLimitEvent(TradeEvent::LimitFailed, order, user);
+            }
+        }
+
+        for (OrderHandle handle : executed) {
+            std::int64_t id = orders.at(handle).orderId;
+            unindexOrder(handle);
+            orders.erase(handle);
+            journalRemove('F', id);
+            ordersChanged = true;
+        }
+
+        if (ordersChanged) {
+            flushJournal();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "An unexpected error occurred while checking user orders: " << e.what() << '\n';
+    }
+}
+
+// Settles triggered orders grouped by owner: each wallet is loaded once,
+// receives its orders in the given (price-time) order and is saved once.
+// Wallets are independent, so this matches executing the orders one by one.
+bool LimitOrderManager::settleTriggered(const std::vector<OrderHandle>& triggered, Exchange& ex, AuthManager& auth) {
+    std::vector<UserId> owners;
+    std::unordered_map<UserId, std::vector<OrderHandle>> ordersByOwner;
+    for (OrderHandle handle : triggered) {
+        std::vector<OrderHandle>& owned = ordersByOwner[orders.at(handle).user];
+        if (owned.empty()) owners.push_back(orders.at(handle).user);
+        owned.push_back(handle);
+    }
+
+    bool ordersChanged = false;
+    for (UserId ownerId : owners) {
+        User* owner = auth.loadUserData(userName(ownerId));
+        if (!owner) continue;
+
+        bool walletChanged = false;
+        for (OrderHandle handle : ordersByOwner[ownerId]) {
+            const LimitOrder& order = orders.at(handle);
+            LATENCY_SCOPE(LatencyProbe::OrderFill);
+
+            recordLimitEvent(TradeEvent::LimitTriggered, order, *owner);
+            bool success = order.isBuy() ? BuyTrade(order.symbol, order.units).execute(*owner, ex)
+                                         : SellTrade(order.symbol, order.units).execute(*owner, ex);
+
+            if (success) {
+                journalRemove('F', order.orderId);
+                unindexOrder(handle);
+                orders.erase(handle);
+                walletChanged = true;
+            } else {
+                recordLimitEvent(TradeEvent::LimitFailed, order, *owner);
+            }
+        }
+
+        if (walletChanged) {
+            auth.saveUserData(*owner);
+            ordersChanged = true;
+        }
+        auth.releaseUser(owner);
+    }
+    return ordersChanged;
+}
+
+void LimitOrderManager::checkAndExecuteOrders(SymbolId symbol, Exchange& ex, AuthManager& auth) {
+    LATENCY_SCOPE(LatencyProbe::OrdersTick);
+    try {
+        if (settleTriggered(triggeredOrders(symbol, ex.priceOf(symbol)), ex, auth)) {
+            flushJournal();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "An unexpected error occurred while checking " << symbolName(symbol) << " orders: " << e.what() << '\n';
+    }
+}
+
+void LimitOrderManager::checkAndExecuteAllOrders(Exchange& ex, AuthManager& auth) {
+    LATENCY_SCOPE(LatencyProbe::OrdersTick);
+    try {
+        std::vector<OrderHandle> triggered;
+        for (SymbolId symbol = 0; symbol < books.size(); ++symbol) {
+            Fixed price = ex.priceOf(symbol);
+            if (!books[symbol].empty() && price >= Fixed()) books[symbol].triggered(orders, price, triggered);
+        }
+
+        if (settleTriggered(triggered, ex, auth)) {
+            flushJournal();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "An unexpected error occurred while checking all orders: " << e.what() << '\n';
+    }
+}
+
+// Builds a state.snap image in memory; users must be added in name order.
+class SnapshotWriter {
+private:
+    const Exchange& ex;
+    const LimitOrderManager& limitManager;
+    std::vector<SnapshotUser> users;
+    std::vector<SnapshotHolding> holdings;
+    std::string strings;
+
+    SnapshotString store(const std::string& s);
+
+public:
+    SnapshotWriter(const Exchange& ex, const LimitOrderManager& limitManager);
+    void addUser(const User& user);
+    bool write(const std::string& path);
+};
+
+SnapshotWriter::SnapshotWriter(const Exchange& ex, const LimitOrderManager& limitManager)
+    : ex(ex), limitManager(limitManager) {}
+
+SnapshotString SnapshotWriter::store(const std::string& s) {
+    if (strings.size() + s.size() > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::length_error("snapshot string pool exceeds 4 GiB");
+    }
+    SnapshotString out{static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(s.size())};
+    strings += s;
+    return out;
+}
+
+void SnapshotWriter::addUser(const User& user) {
+    const Wallet& wallet = user.getWallet();
+    SnapshotUser record{store(user.getName()), wallet.getCash().getRaw(), holdings.size(),
+                        static_cast<std::uint32_t>(wallet.getHoldings().size()), 0};
+    for (const auto& holding : wallet.getHoldings()) {
+        holdings.push_back(SnapshotHolding{holding.second.getRaw(), holding.first, 0});
+    }
+    users.push_back(record);
+}
+
+bool SnapshotWriter::write(const std::string& path) {
+    SymbolRegistry& registry = SymbolRegistry::instance();
+    // The symbol table is the whole registry, so a SymbolId is its own index.
+    std::vector<SnapshotString> symbols;
+    for (std::size_t id = 0; id < registry.size(); ++id) symbols.push_back(store(registry.name(static_cast<SymbolId>(id))));
+
+    std::vector<SnapshotListing> listings;
+    for (const auto& c : ex.getListings()) {
+        listings.push_back(SnapshotListing{store(c.getName()), c.getId(), 0, c.getPrice().getRaw(),
+                                           c.getTickSize().getRaw(), c.getLotSize().getRaw()});
+    }
+    std::vector<SnapshotOrder> orders;
+    const OrderPool& pool = limitManager.getOrders();
+    for (OrderHandle handle : pool.handles()) {
+        const LimitOrder& o = pool.at(handle);
+        std::uint64_t id = static_cast<std::uint64_t>(o.orderId);
+        orders.push_back(SnapshotOrder{o.units.getRaw(), o.desiredPrice.getRaw(), store(o.username()),
+                                       static_cast<std::uint32_t>(id), o.symbol, o.isBuy() ? 1u : 0u,
+                                       static_cast<std::uint32_t>(id >> 32)});
+    }
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, StateSnapshot::MAGIC, sizeof(header.magic));
+    header.version = StateSnapshot::VERSION;
+    header.symbolCount = static_cast<std::uint32_t>(symbols.size());
+    header.listingCount = static_cast<std::uint32_t>(listings.size());
+    header.userCount = users.size();
+    header.holdingCount = holdings.size();
+    header.orderCount = orders.size();
+    header.nextOrderId = limitManager.getNextOrderId();
+    header.totalTrades = Exchange::totalTrades;
+
+    std::uint64_t offset = sizeof(SnapshotHeader);
+    auto place = [&offset](std::uint64_t bytes) {
+        std::uint64_t at = offset;
+        offset = (offset + bytes + 7) & ~std::uint64_t(7);
+        return at;
+    };
+    header.symbolsOffset = place(symbols.size() * sizeof(SnapshotString));
+    header.listingsOffset = place(listings.size() * sizeof(SnapshotListing));
+    header.usersOffset = place(users.size() * sizeof(SnapshotUser));
+    header.holdingsOffset = place(holdings.size() * sizeof(SnapshotHolding));
+    header.ordersOffset = place(orders.size() * sizeof(SnapshotOrder));
+    header.stringsOffset = place(strings.size());
+    header.stringsSize = strings.size();
+
+    const std::string tmp_path = path + ".tmp";
+    try {
+        {
+            std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!file) return false;
+            std::uint64_t written = 0;
+            auto emit = [&](std::uint64_t at, const void* data, std::uint64_t bytes) {
+                static const char padding[8] = {};
+                file.write(padding, at - written);
+                file.write(static_cast<const char*>(data), bytes);
+                written = at + bytes;
+            };
+            emit(0, &header, sizeof(header));
+            emit(header.symbolsOffset, symbols.data(), symbols.size() * sizeof(SnapshotString));
+            emit(header.listingsOffset, listings.data(), listings.size() * sizeof(SnapshotListing));
+            emit(header.usersOffset, users.data(), users.size() * sizeof(SnapshotUser));
+            emit(header.holdingsOffset, holdings.data(), holdings.size() * sizeof(SnapshotHolding));
+            emit(header.ordersOffset, orders.data(), orders.size() * sizeof(SnapshotOrder));
+            emit(header.stringsOffset, strings.data(), strings.size());
+            if (!file.flush()) return false;
+        }
+        std::filesystem::rename(tmp_path, path);
+        return true;
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Exception replacing state snapshot: " << e.what() << '\n';
+    } catch (const std::ofstream::failure& e) {
+        std::cerr << "Exception writing state snapshot: " << e.what() << '\n';
+    }
+    return false;
+}
+
+// Folds the wallets saved since the last checkpoint (the wallets.db overlay)
+// and the live order book into a new snapshot, then empties the overlay and
+// the order journal it made redundant.
+bool checkpointState(const std::string& path, const Exchange& ex, AuthManager& auth,
+                     LimitOrderManager& limitManager, const StateSnapshot* base) {
+    try {
+        std::vector<std::string> overlays = auth.storedWallets();
+        SnapshotWriter writer(ex, limitManager);
+        std::uint64_t b = 0, baseUsers = base && base->isOpen() ? base->userCount() : 0;
+        std::size_t o = 0;
+        while (b < baseUsers || o < overlays.size()) {
+            std::string baseName = b < baseUsers ? base->text(base->userAt(b).name) : std::string();
+            if (o < overlays.size() && (b == baseUsers || overlays[o] <= baseName)) {
+                if (overlays[o] == baseName) ++b;
+                User* user = auth.loadUserData(overlays[o++]);
+                if (!user) return false;
+                writer.addUser(*user);
+                auth.releaseUser(user);
+            } else {
+                std::unique_ptr<User> user(base->loadUser(base->userAt(b++)));
+                writer.addUser(*user);
+            }
+        }
+        if (!writer.write(path)) return false;
+
+        if (!auth.clearStoredWallets()) std::cerr << "Warning: wallets.db not emptied after checkpoint.\n";
+        limitManager.checkpointed();
+        return true;
+    } catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Exception checkpointing state: " << e.what() << '\n';
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Exception reading state snapshot: " << e.what() << '\n';
+    } catch (const std::length_error& e) {
+        std::cerr << "Exception building state snapshot: " << e.what() << '\n';
+    }
+    return false;
+}
+
+// Swallows output, for running the engine with console narration off.
+struct NullBuffer : std::streambuf {
+    int overflow(int c) override { return c; }
+};
+
+void clearInput() {
+    std::cin.clear();
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+}
+
+template <typename T>
+T getNumericInput(const std::string& prompt) {
+    T value;
+    std::cout << prompt;
+    while (!(std::cin >> value)) {
+        std::cout << "Wrong input, enter a numeric value: ";
+        clearInput();
+    }
+    return value;
+}
+
+void saveCryptoData(const Exchange& ex) {
+    try {
+        std::ofstream file("crypto_data.csv");
+        if (!file) return;
+
+        for (const auto& crypto : ex.getListings()) {
+            file << crypto.getName() << "," << crypto.getSymbol() << "," << crypto.getPrice()
+                 << "," << crypto.getTickSize() << "," << crypto.getLotSize() << '\n';
+        }
+    } catch (const std::ofstream::failure& e) {
+        std::cerr << "Exception writing to crypto data file: " << e.what() << '\n';
+    }
+}
+
+void loadCryptoData(Exchange& ex) {
+    LATENCY_SCOPE(LatencyProbe::LoadCryptoData);
+    try {
+        std::ifstream file("crypto_data.csv");
+        if (!file) return;
+
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty()) continue;
+            std::stringstream ss(line);
+            std::string name, symbol, price_str, tick_str, lot_str;
+            std::getline(ss, name, ',');
+            std::getline(ss, symbol, ',');
+            std::getline(ss, price_str, ',');
+            std::getline(ss, tick_str, ',');
+            std::getline(ss, lot_str);
+            if (!name.empty() && !symbol.empty() && !price_str.empty()) {
+                Fixed price;
+                Fixed tick = Crypto_currency::DEFAULT_TICK;
+                Fixed lot = Crypto_currency::DEFAULT_LOT;
+                if (!Fixed::parse(price_str, price) ||
+                    (!tick_str.empty() && !Fixed::parse(tick_str, tick)) ||
+                    (!lot_str.empty() && !Fixed::parse(lot_str, lot))) {
+                    std::cerr << "Invalid listing for " << symbol << ": " << line << '\n';
+                    continue;
+                }
+                ex.add_crypto_listing(Crypto_currency(name, symbol, price, tick, lot));
+            }
+        }
+    } catch (const std::ifstream::failure& e) {
+        std::cerr << "Exception reading crypto data file: " << e.what() << '\n';
+    }
+}
+
+void seedExchange(Exchange& ex) {
+    ex.add_crypto_listing(Crypto_currency("Bitcoin", "BTC", Fixed::fromInt(60000)));
+    ex.add_crypto_listing(Crypto_currency("Ether", "ETH", Fixed::fromInt(2500)));
+    ex.add_crypto_listing(Crypto_currency("Solana", "SOL", Fixed::fromInt(150)));
+}
+
+void adminMenu(Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager) {
+    while (true) {
+        EventLog::instance().flush();
+        std::cout << "\n--- Admin Menu ---\n"
+                  << "1) Update Crypto Price\n"
+                  << "2) Wallet Cache Stats\n"
+                  << "3) Latency Stats\n"
+                  << "0) Logout\n> ";
+        int choice = getNumericInput<int>("");
+
+        if (choice == 0) break;
+
+        if (choice == 1) {
+            std::string sym;
+            std::cout << "Update % for which symbol? ";
+            std::cin >> sym;
+            Fixed pct = getNumericInput<Fixed>("Percent change (+/-): ");
+            int inc = getNumericInput<int>("Increase? (1=yes, 0=no): ");
+
+            Crypto_currency* crypto = ex.find(sym);
+            if (crypto) {
+                Fixed p = crypto->getPrice();
+                Fixed delta = (p * pct) / 100;
+                Fixed newPrice = (inc == 1 ? p + delta : p - delta).roundTo(crypto->getTickSize());
+                if (newPrice <= Fixed()) {
+                    std::cout << "[ERR] Price must stay positive\n";
+                    continue;
+                }
+                ex.setPrice(crypto->getId(), newPrice);
+                std::cout << "[OK] " << sym << " is now $" << crypto->getPrice() << "\n";
+
+                std::cout << "Checking pending " << sym << " limit orders against new price...\n";
+                limitManager.checkAndExecuteOrders(crypto->getId(), ex, auth);
+
+            } else {
+                std::cout << "[ERR] Symbol not found\n";
+            }
+        } else if (choice == 2) {
+            auth.printCacheStats();
+        } else if (choice == 3) {
+            LatencyStats::instance().print(std::cout);
+        } else {
+            std::cout << "Unknown option.\n";
+        }
+    }
+}
+
+void userMenu(User& user, Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager) {
+    while (true) {
+        try {
+            limitManager.checkAndExecuteUserOrders(user, ex);
+            EventLog::instance().flush();
+
+            std::cout << "\n=========== USER MENU ============\n"
+                      << "1) List Market\n"
+                      << "2) View Portfolio\n"
+                      << "3) Deposit Funds\n"
+                      << "4) Buy Crypto (Market Order)\n"
+                      << "5) Sell Crypto (Market Order)\n"
+                      << "6) Place Limit Order\n"
+                      << "7) View My Limit Orders\n"
+                      << "8) Cancel Limit Order\n"
+                      << "9) Place Order Book Bid/Ask\n"
+                      << "10) Cancel Order Book Order\n"
+                      << "11) View Order Book\n"
+                      << "12) Submit Basket (Batch Market Orders)\n"
+                      << "13) View Leaderboard\n"
+                      << "14) View Price Candles\n"
+                      << "0) Save & Logout\n> ";
+            int choice = getNumericInput<int>("");
+
+            if (choice == 0) {
+                auth.saveUserData(user);
+                std::cout << "Data saved. Logging out.\n";
+                break;
+            }
+
+            switch (choice) {
+                case 1: ex.print(); break;
+                case 2: user.printSummary(); break;
+                case 3: {
+                    Fixed amt = getNumericInput<Fixed>("Enter amount to deposit: ");
+                    if (user.getWallet().deposit(amt))
+                        std::cout << "[OK] Deposited. New cash: $" << user.getWallet().getCash() << "\n";
+                    else
+                        std::cout << "Error: Deposit must be positive and keep the cash balance in range.\n";
+                    break;
+                }
+                case 4: {
+                    std::string sym;
+                    std::cout << "Enter symbol to BUY (e.g., ETH): ";
+                    std::cin >> sym;
+                    Fixed units = getNumericInput<Fixed>("Enter units to buy: ");
+                    BuyTrade(sym, units).execute(user, ex);
+                    break;
+                }
+                case 5: {
+                    std::string sym;
+                    std::cout << "Enter symbol to SELL (e.g., ETH): ";
+                    std::cin >> sym;
+                    Fixed units = getNumericInput<Fixed>("Enter units to sell: ");
+                    SellTrade(sym, units).execute(user, ex);
+                    break;
+                }
+                case 6: {
+                    std::string sym;
+                    std::cout << "Place a new Limit Order\n";
+                    std::cout << "Enter symbol (e.g., BTC): ";
+                    std::cin >> sym;
+
+                    Crypto_currency* crypto = ex.find(sym);
+                    if (crypto == nullptr) {
+                        std::cout << "Error: Symbol '" << sym << "' is not listed on the market.\n";
+                        continue;
+                    }
+                    Fixed units = getNumericInput<Fixed>("Enter units: ");
+                    Fixed price = getNumericInput<Fixed>("Enter target price: $");
+                    if (!crypto->acceptsLimit(units, price)) {
+                        std::cout << "Units must be a positive multiple of " << crypto->getLotSize().toString()
+                                  << " and the price of " << crypto->getTickSize().toString() << ".\n";
+                        continue;
+                    }
+                    int type = getNumericInput<int>("Is this a BUY or SELL order? (1 for Buy, 2 for Sell): ");
+
+                    if (type == 1 || type == 2) {
+                        limitManager.addOrder(user.getName(), crypto->getId(), units, price, (type == 1));
+                    } else {
+                        std::cout << "Invalid order type.\n";
+                    }
+                    break;
+                }
+                case 7: {
+                    limitManager.displayUserOrders(user.getName());
+                    break;
+                }
+                case 8: {
+                    std::int64_t id = getNumericInput<std::int64_t>("Enter limit order ID to cancel: ");
+                    limitManager.cancelOrder(user.getName(), id);
+                    break;
+                }
+                case 9: {
+                    std::string sym;
+                    std::cout << "Enter symbol (e.g., BTC): ";
+                    std::cin >> sym;
+                    const Crypto_currency* crypto = ex.find(sym);
+                    if (crypto == nullptr) {
+                        std::cout << "Error: Symbol '" << sym << "' is not listed on the market.\n";
+                        continue;
+                    }
+                    Fixed units = getNumericInput<Fixed>("Enter units: ");
+                    Fixed price = getNumericInput<Fixed>("Enter limit price: $");
+                    int type = getNumericInput<int>("Bid or Ask? (1 for Bid, 2 for Ask): ");
+                    if (type == 1 || type == 2) {
+                        ex.placeBookOrder(user, crypto->getId(), type == 1, units, price, auth);
                     } else {
-                        std::cout << "Invalid admin credentials.\n";
+                        std::cout << "Invalid order type.\n";
+                    }
+                    break;
+                }
+                case 10: {
+                    std::uint64_t id = getNumericInput<std::uint64_t>("Enter book order ID to cancel: ");
+                    ex.cancelBookOrder(user, id, auth);
+                    break;
+                }
+                case 11: {
+                    std::string sym;
+                    std::cout << "Enter symbol (e.g., BTC): ";
+                    std::cin >> sym;
+                    const Crypto_currency* crypto = ex.find(sym);
+                    if (crypto) ex.printBook(crypto->getId(), 10);
+                    else std::cout << "Error: Symbol '" << sym << "' is not listed on the market.\n";
+                    break;
+                }
+                case 12: {
+                    std::string line, error;
+                    std::cout << "Enter orders as buy|sell SYM units, space-separated (e.g., sell ETH 1 buy BTC 0.01): ";
+                    std::getline(std::cin >> std::ws, line);
+                    std::istringstream legs(line);
+                    TradeBatch batch;
+                    if (!batch.parse(legs, error) || !batch.execute(user, ex, error)) {
+                        std::cout << "Basket rejected, nothing was traded: " << error << "\n";
+                        break;
+                    }
+                    auth.saveUserData(user);
+                    EventLog::instance().flush();
+                    std::cout << "[OK] Basket of " << batch.size() << " orders filled.\n";
+                    break;
+                }
+                case 13: {
+                    ValuationEngine& valuation = ValuationEngine::instance();
+                    valuation.load(ex, auth);
+                    valuation.update(user);
+                    valuation.printLeaderboard(10);
+                    break;
+                }
+                case 14: {
+                    std::string sym, res;
+                    std::cout << "Enter symbol and resolution (e.g., BTC 1m): ";
+                    std::cin >> sym >> res;
+                    CandleStore::Resolution resolution;
+                    const Crypto_currency* crypto = ex.find(sym);
+                    if (!crypto) std::cout << "Error: Symbol '" << sym << "' is not listed on the market.\n";
+                    else if (!CandleStore::parseResolution(res, resolution)) std::cout << "Resolution must be 1s, 1m or 1h.\n";
+                    else CandleStore::instance().print(crypto->getId(), resolution, 20);
+                    break;
+                }
+                default:
+                    std::cout << "Unknown option.\n";
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "An error occurred in the user menu: " << e.what() << '\n';
+            clearInput(); // Clear any bad input
+        }
+    }
+}
+
+// Lets sessions run commands side by side. A command that can touch any
+// user, order or price holds `engine` exclusively. Market trades, deposits and
+// the read-only views share it and then lock only the stripe of the session's
+// user and of the symbol they touch, so sessions trading as different users
+// in different symbols do not wait for each other.
+struct EngineLocks {
+    static constexpr std::size_t STRIPES = 64;
+    std::shared_mutex engine;
+    std::array<std::mutex, STRIPES> users;
+    std::array<std::mutex, STRIPES> symbols;
+
+    std::mutex& user(UserId id);
+    std::mutex& symbol(SymbolId id);
+};
+
+std::mutex& EngineLocks::user(UserId id) { return users[id % STRIPES]; }
+std::mutex& EngineLocks::symbol(SymbolId id) { return symbols[id % STRIPES]; }
+
+// Runs one text command against the engine on behalf of a single session:
+//   signup|login <user> <password>, logout, deposit <amount>,
+//   buy|sell <SYM> <units>, basket (buy|sell <SYM> <units>)...,
+//   limit buy|sell <SYM> <units> <price>, cancel <id>,
+//   price <SYM> <newPrice> (admin), market, leaderboard [N],
+//   candles <SYM> 1s|1m|1h [N], portfolio, orders
+// A command's narration and the fills it causes go to the stream passed in.
+class CommandProcessor {
+private:
+    Exchange& ex;
+    AuthManager& auth;
+    LimitOrderManager& limitManager;
+    EngineLocks& locks;
+    bool captureFills; // format each command's fills into its output; off when nobody reads it
+    User* user = nullptr;
+
+    static bool isShared(const std::string& cmd);
+    bool run(const std::string& cmd, std::istream& in, std::ostream& out, std::string& error);
+    void endSession();
+
+public:
+    CommandProcessor(Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager, EngineLocks& locks,
+                     bool captureFills);
+    ~CommandProcessor();
+
+    bool execute(const std::string& line, std::ostream& out, std::string& error);
+};
+
+CommandProcessor::CommandProcessor(Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager,
+                                   EngineLocks& locks, bool captureFills)
+    : ex(ex), auth(auth), limitManager(limitManager), locks(locks), captureFills(captureFills) {}
+
+// The last reference to a server connection may drop on any thread, and
+// logging out writes the wallet through the shared cache.
+CommandProcessor::~CommandProcessor() {
+    std::unique_lock<std::shared_mutex> lock(locks.engine);
+    endSession();
+}
+
+void CommandProcessor::endSession() {
+    if (user) {
+        auth.saveUserData(*user);
+        auth.releaseUser(user);
+        user = nullptr;
+    }
+}
+
+// Commands that change nothing beyond the session's own wallet and a
+// symbol's trade statistics. Everything else may move another user's
+// wallet, the order books or prices.
+bool CommandProcessor::isShared(const std::string& cmd) {
+    return cmd == "buy" || cmd == "sell" || cmd == "deposit" || cmd == "portfolio" || cmd == "orders" ||
+           cmd == "market" || cmd == "book" || cmd == "candles";
+}
+
+bool CommandProcessor::execute(const std::string& line, std::ostream& out, std::string& error) {
+    std::istringstream in(line);
+    std::string cmd;
+    if (!(in >> cmd) || cmd[0] == '#') return true;
+
+    std::optional<EventLog::Capture> fills;
+    if (captureFills) fills.emplace(out);
+    if (isShared(cmd)) {
+        std::shared_lock<std::shared_mutex> lock(locks.engine);
+        return run(cmd, in, out, error);
+    }
+    std::unique_lock<std::shared_mutex> lock(locks.engine);
+    return run(cmd, in, out, error);
+}
+
+bool CommandProcessor::run(const std::string& cmd, std::istream& in, std::ostream& out, std::string& error) {
+    if (cmd == "signup" || cmd == "login") {
+        std::string username, password;
+        if (!(in >> username >> password)) { error = "usage: " + cmd + " <user> <password>"; return false; }
+        endSession();
+        user = (cmd == "signup") ? auth.signUp(username, password, out) : auth.login(username, password, out);
+        if (!user) { error = cmd + " failed for " + username; return false; }
+        limitManager.checkAndExecuteUserOrders(*user, ex);
+        return true;
+    }
+    if (cmd == "price") {
+        std::string sym;
+        Fixed newPrice;
+        if (!(in >> sym >> newPrice)) { error = "usage: price <SYM> <newPrice>"; return false; }
+        Crypto_currency* crypto = ex.find(sym);
+        if (!crypto) { error = "unknown symbol " + sym; return false; }
+        if (newPrice <= Fixed() || !newPrice.isMultipleOf(crypto->getTickSize())) {
+            error = "price must be a positive multiple of " + crypto->getTickSize().toString();
+            return false;
+        }
+        ex.setPrice(crypto->getId(), newPrice);
+        limitManager.checkAndExecuteOrders(crypto->getId(), ex, auth);
+        return true;
+    }
+    if (cmd == "market") { ex.print(out); return true; }
+    if (cmd == "leaderboard") {
+        std::size_t n = 10;
+        in >> n;
+        ValuationEngine& valuation = ValuationEngine::instance();
+        valuation.load(ex, auth);
+        if (user) valuation.update(*user);
+        valuation.printLeaderboard(n, out);
+        return true;
+    }
+    if (cmd == "candles") {
+        std::string sym, res;
+        std::size_t n = 10;
+        CandleStore::Resolution resolution;
+        if (!(in >> sym >> res) || !CandleStore::parseResolution(res, resolution)) {
+            error = "usage: candles <SYM> 1s|1m|1h [N]";
+            return false;
+        }
+        in >> n;
+        const Crypto_currency* crypto = ex.find(sym);
+        if (!crypto) { error = "unknown symbol " + sym; return false; }
+        std::lock_guard<std::mutex> series(locks.symbol(crypto->getId()));
+        CandleStore::instance().print(crypto->getId(), resolution, n, out);
+        return true;
+    }
+    if (cmd == "book") {
+        std::string sym;
+        if (!(in >> sym)) { error = "usage: book <SYM>"; return false; }
+        const Crypto_currency* crypto = ex.find(sym);
+        if (!crypto) { error = "unknown symbol " + sym; return false; }
+        ex.printBook(crypto->getId(), 10, out);
+        return true;
+    }
+
+    if (!user) { error = cmd + " requires a logged-in user"; return false; }
+
+    if (cmd == "logout") {
+        endSession();
+        return true;
+    }
+    if (cmd == "portfolio") {
+        std::lock_guard<std::mutex> owner(locks.user(user->getId()));
+        user->printSummary(out);
+        return true;
+    }
+    if (cmd == "orders") { limitManager.displayUserOrders(user->getName(), out); return true; }
+    if (cmd == "deposit") {
+        Fixed amount;
+        if (!(in >> amount) || amount <= Fixed()) { error = "usage: deposit <positive amount>"; return false; }
+        std::lock_guard<std::mutex> owner(locks.user(user->getId()));
+        if (!user->getWallet().deposit(amount)) { error = "deposit would overflow the cash balance"; return false; }
+        return true;
+    }
+    if (cmd == "buy" || cmd == "sell") {
+        std::string sym;
+        Fixed units;
+        if (!(in >> sym >> units)) { error = "usage: " + cmd + " <SYM> <units>"; return false; }
+        const SymbolId symbol = SymbolRegistry::instance().lookup(sym);
+        std::lock_guard<std::mutex> owner(locks.user(user->getId()));
+        std::lock_guard<std::mutex> market(locks.symbol(symbol));
+        bool ok = (cmd == "buy") ? BuyTrade(symbol, units).execute(*user, ex, out)
+                                 : SellTrade(symbol, units).execute(*user, ex, out);
+        if (!ok) error = cmd + " " + sym + " rejected";
+        return ok;
+    }
+    if (cmd == "basket") {
+        TradeBatch batch;
+        if (!batch.parse(in, error) || !batch.execute(*user, ex, error)) {
+            error = "basket rejected: " + error;
+            return false;
+        }
+        auth.saveUserData(*user);
+        return true;
+    }
+    if (cmd == "limit") {
+        std::string side, sym;
+        Fixed units, limitPrice;
+        if (!(in >> side >> sym >> units >> limitPrice) || (side != "buy" && side != "sell")) {
+            error = "usage: limit buy|sell <SYM> <units> <price>";
+            return false;
+        }
+        Crypto_currency* crypto = ex.find(sym);
+        if (!crypto) { error = "unknown symbol " + sym; return false; }
+        if (!crypto->acceptsLimit(units, limitPrice)) {
+            error = "units and price must be positive multiples of the lot and tick size";
+            return false;
+        }
+        limitManager.addOrder(user->getName(), crypto->getId(), units, limitPrice, side == "buy", out);
+        return true;
+    }
+    if (cmd == "bid" || cmd == "ask") {
+        std::string sym;
+        Fixed units, limitPrice;
+        if (!(in >> sym >> units >> limitPrice)) { error = "usage: " + cmd + " <SYM> <units> <price>"; return false; }
+        const Crypto_currency* crypto = ex.find(sym);
+        if (!crypto) { error = "unknown symbol " + sym; return false; }
+        if (!ex.placeBookOrder(*user, crypto->getId(), cmd == "bid", units, limitPrice, auth, out)) {
+            error = cmd + " " + sym + " rejected";
+            return false;
+        }
+        return true;
+    }
+    if (cmd == "bcancel") {
+        std::uint64_t id;
+        if (!(in >> id)) { error = "usage: bcancel <bookOrderId>"; return false; }
+        if (!ex.cancelBookOrder(*user, id, auth, out)) { error = "no such book order"; return false; }
+        return true;
+    }
+    if (cmd == "cancel") {
+        std::int64_t id;
+        if (!(in >> id)) { error = "usage: cancel <orderId>"; return false; }
+        if (!limitManager.cancelOrder(user->getName(), id, out)) { error = "no such order"; return false; }
+        return true;
+    }
+
+    error = "unknown command '" + cmd + "'";
+    return false;
+}
+
+// Headless mode: executes a command stream with prompts and narration off and
+// reports throughput on exit. `path` of "-" reads stdin.
+int runScript(const std::string& path, bool echo, Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager) {
+    std::ifstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file) {
+            std::cerr << "Error: Could not open script " << path << '\n';
+            return 1;
+        }
+    }
+    std::istream& in = (path == "-") ? std::cin : file;
+
+    NullBuffer discard;
+    std::ostream quiet(&discard);
+    std::ostream& out = echo ? std::cout : quiet;
+    EventLog::instance().setEcho(false); // with --echo each command captures its own fills into `out`
+
+    std::size_t commands = 0, failures = 0, lineNo = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+        EngineLocks locks;
+        CommandProcessor processor(ex, auth, limitManager, locks, echo);
+        std::string line, error;
+        while (std::getline(in, line)) {
+            ++lineNo;
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            ++commands;
+            bool ok = processor.execute(line, out, error);
+            if (!ok) {
+                ++failures;
+                std::cerr << "line " << lineNo << ": " << error << '\n';
+            }
+        }
+    }
+    EventLog::instance().flush();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Processed " << commands << " commands (" << failures << " failed) in "
+              << std::fixed << std::setprecision(3) << seconds << " s, "
+              << std::setprecision(0) << (seconds > 0 ? commands / seconds : 0.0) << " commands/s\n";
+    return failures == 0 ? 0 : 2;
+}
+
+#if defined(__linux__)
+// --- Session server ---
+// Serves many sessions over a Unix domain stream socket. A request is one
+// line in the runScript command language; the reply is "OK <n>\n" or
+// "ERR <n>\n" followed by n bytes: the command's console output, or the
+// error text. Each connection keeps its own CommandProcessor, so login state
+// is per session.
+//
+// One epoll thread accepts, reads and frames lines, and a worker pool runs
+// them under the EngineLocks: market trades and views from different sessions
+// run in parallel, while commands that reach other users' wallets, the books
+// or prices run alone. Each request writes its reply into its own stream. A
+// connection is queued to at most one worker at a time, so its requests are
+// answered in order.
+class SessionServer {
+private:
+    struct Connection {
+        int fd;
+        std::unique_ptr<CommandProcessor> processor;
+        std::mutex mutex; // guards everything below
+        std::deque<std::string> pending;
+        std::string out;
+        bool queued = false;
+        bool closed = false;
+
+        Connection(int fd, EngineLocks& locks, Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager);
+        ~Connection();
+    };
+    using ConnectionPtr = std::shared_ptr<Connection>;
+
+    static constexpr std::size_t MAX_LINE = 64 * 1024;
+
+    Exchange& ex;
+    AuthManager& auth;
+    LimitOrderManager& limitManager;
+    EngineLocks locks;
+
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFds[2] = {-1, -1}; // self-pipe written by the SIGINT/SIGTERM handler
+    std::string path;
+
+    static int wakeFd;
+    static void onSignal(int);
+
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<ConnectionPtr> queue;
+    bool stopping = false;
+
+    std::atomic<std::uint64_t> requests{0};
+
+    void workerLoop();
+    void serve(const ConnectionPtr& conn);
+    void flushLocked(Connection& conn); // conn.mutex held
+
+public:
+    SessionServer(Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager);
+    ~SessionServer();
+
+    bool listen(const std::string& socketPath);
+    // Runs until SIGINT or SIGTERM; open sessions are then logged out and saved.
+    void run(unsigned workers);
+    std::uint64_t served() const;
+};
+
+SessionServer::Connection::Connection(int fd, EngineLocks& locks, Exchange& ex, AuthManager& auth,
+                                      LimitOrderManager& limitManager)
+    : fd(fd), processor(new CommandProcessor(ex, auth, limitManager, locks, true)) {}
+
+SessionServer::Connection::~Connection() {
+    processor.reset(); // logs the session out before the descriptor can be reused
+    ::close(fd);
+}
+
+SessionServer::SessionServer(Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager)
+    : ex(ex), auth(auth), limitManager(limitManager) {}
+
+SessionServer::~SessionServer() {
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        ::unlink(path.c_str());
+    }
+    if (epollFd >= 0) ::close(epollFd);
+    if (wakeFd == wakeFds[1] && wakeFd >= 0) {
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        wakeFd = -1;
+    }
+    for (int fd : wakeFds) {
+        if (fd >= 0) ::close(fd);
+    }
+}
+
+int SessionServer::wakeFd = -1;
+
+void SessionServer::onSignal(int) {
+    char byte = 0;
+    if (wakeFd >= 0) (void)!::write(wakeFd, &byte, 1);
+}
+
+bool SessionServer::listen(const std::string& socketPath) {
+    sockaddr_un addr{};
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: socket path too long: " << socketPath << '\n';
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    ::unlink(socketPath.c_str());
+
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listenFd, SOMAXCONN) != 0) {
+        std::cerr << "Error: could not listen on " << socketPath << ": " << std::strerror(errno) << '\n';
+        return false;
+    }
+    path = socketPath;
+
+    // A handler rather than a blocked mask: the event log thread is already
+    // running and may be the one the signal is delivered to.
+    if (::pipe2(wakeFds, O_NONBLOCK | O_CLOEXEC) != 0) {
+        std::cerr << "Error: pipe: " << std::strerror(errno) << '\n';
+        return false;
+    }
+    wakeFd = wakeFds[1];
+    struct sigaction action{};
+    action.sa_handler = &SessionServer::onSignal;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.fd = wakeFds[0];
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFds[0], &ev);
+    return true;
+}
+
+void SessionServer::flushLocked(Connection& conn) {
+    while (!conn.out.empty() && !conn.closed) {
+        ssize_t n = ::send(conn.fd, conn.out.data(), conn.out.size(), MSG_NOSIGNAL);
+        if (n > 0) {
+            conn.out.erase(0, static_cast<std::size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLOUT;
+            ev.data.fd = conn.fd;
+            ::epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.fd, &ev);
+        } else {
+            conn.out.clear(); // peer gone; the epoll thread will see the hangup
+        }
+        return;
+    }
+}
+
+void SessionServer::serve(const ConnectionPtr& conn) {
+    while (true) {
+        std::string line;
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            if (conn->pending.empty() || conn->closed) {
+                conn->queued = false;
+                return;
+            }
+            line = std::move(conn->pending.front());
+            conn->pending.pop_front();
+        }
+
+        std::ostringstream reply;
+        std::string error;
+        bool ok = conn->processor->execute(line, reply, error);
+        requests.fetch_add(1, std::memory_order_relaxed);
+
+        const std::string body = ok ? reply.str() : error;
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        conn->out += (ok ? "OK " : "ERR ") + std::to_string(body.size()) + "\n" + body;
+        flushLocked(*conn);
+    }
+}
+
+void SessionServer::workerLoop() {
+    while (true) {
+        ConnectionPtr conn;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            conn = std::move(queue.front());
+            queue.pop_front();
+        }
+        serve(conn);
+    }
+}
+
+void SessionServer::run(unsigned workers) {
+    for (const Crypto_currency& crypto : ex.getListings()) CandleStore::instance().reserve(crypto.getId());
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < std::max(1u, workers); ++i) pool.emplace_back(&SessionServer::workerLoop, this);
+
+    std::unordered_map<int, ConnectionPtr> connections;
+    std::unordered_map<int, std::string> partial; // bytes after the last newline
+    std::vector<epoll_event> events(256);
+    char buffer[16384];
+    bool running = true;
+
+    auto drop = [&](int fd) {
+        auto it = connections.find(fd);
+        if (it == connections.end()) return;
+        ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        {
+            std::lock_guard<std::mutex> lock(it->second->mutex);
+            it->second->closed = true;
+        }
+        connections.erase(it);
+        partial.erase(fd);
+    };
+
+    while (running) {
+        int ready = ::epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+        if (ready < 0 && errno == EINTR) continue;
+        for (int e = 0; e < ready; ++e) {
+            int fd = events[e].data.fd;
+            if (fd == wakeFds[0]) {
+                running = false;
+                continue;
+            }
+            if (fd == listenFd) {
+                int client;
+                while ((client = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    connections[client] = std::make_shared<Connection>(client, locks, ex, auth, limitManager);
+                    epoll_event ev{};
+                    ev.events = EPOLLIN;
+                    ev.data.fd = client;
+                    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, client, &ev);
+                }
+                continue;
+            }
+
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+            ConnectionPtr conn = it->second;
+            if (events[e].events & EPOLLOUT) {
+                std::lock_guard<std::mutex> lock(conn->mutex);
+                flushLocked(*conn);
+                if (conn->out.empty()) {
+                    epoll_event ev{};
+                    ev.events = EPOLLIN;
+                    ev.data.fd = fd;
+                    ::epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+                }
+            }
+            if (!(events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) continue;
+
+            std::string& data = partial[fd];
+            bool open = true;
+            while (true) {
+                ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+                if (n > 0) {
+                    data.append(buffer, static_cast<std::size_t>(n));
+                    continue;
+                }
+                if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) open = false;
+                if (n < 0 && errno == EINTR) continue;
+                break;
+            }
+
+            std::size_t start = 0, newline;
+            bool wake = false;
+            {
+                std::lock_guard<std::mutex> lock(conn->mutex);
+                while ((newline = data.find('\n', start)) != std::string::npos) {
+                    std::size_t end = (newline > start && data[newline - 1] == '\r') ? newline - 1 : newline;
+                    conn->pending.emplace_back(data, start, end - start);
+                    start = newline + 1;
+                }
+                if (!conn->pending.empty() && !conn->queued) {
+                    conn->queued = true;
+                    wake = true;
+                }
+            }
+            data.erase(0, start);
+            if (wake) {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                queue.push_back(conn);
+                queueReady.notify_one();
+            }
+            if (!open || data.size() > MAX_LINE) drop(fd);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueReady.notify_all();
+    for (auto& thread : pool) thread.join();
+    connections.clear();
+}
+
+std::uint64_t SessionServer::served() const { return requests.load(); }
+
+// Raises the open-file soft limit to the hard limit; a thousand sessions
+// need a descriptor each on both ends.
+void raiseFileLimit() {
+    rlimit limit;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+int runServer(const std::string& socketPath, unsigned workers, Exchange& ex, AuthManager& auth,
+              LimitOrderManager& limitManager) {
+    raiseFileLimit();
+    EventLog::instance().setEcho(false);
+    SessionServer server(ex, auth, limitManager);
+    if (!server.listen(socketPath)) return 1;
+    if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Serving on " << socketPath << " with " << workers << " workers; Ctrl-C to stop.\n";
+    auto start = std::chrono::steady_clock::now();
+    server.run(workers);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Served " << server.served() << " requests in " << std::fixed << std::setprecision(3) << seconds
+              << " s\n";
+    return 0;
+}
+
+// Load client: opens `sessions` connections and drives them concurrently
+// from one epoll loop. Each session signs up (or logs in) as load<N>, then
+// alternates market buys and sells of one SOL lot, then logs out. Latency is
+// measured per request, from send to the end of its reply.
+int runLoadClient(const std::string& socketPath, std::size_t sessions, std::size_t requestsPerSession) {
+    using Clock = std::chrono::steady_clock;
+    struct Session {
+        int fd = -1;
+        std::size_t step = 0; // 0 signup, 1 login fallback, then trades, then logout
+        bool loggedIn = false;
+        Clock::time_point sentAt;
+        std::string in;
+        std::string request;
+    };
+    raiseFileLimit();
+
+    sockaddr_un addr{};
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: socket path too long: " << socketPath << '\n';
+        return 1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Session> all(sessions);
+    std::vector<double> latenciesUs;
+    latenciesUs.reserve(sessions * (requestsPerSession + 2));
+    std::size_t errors = 0, active = 0;
+
+    auto send = [&](Session& s, const std::string& request) {
+        s.request = request;
+        std::string line = request + "\n";
+        s.sentAt = Clock::now();
+        if (::send(s.fd, line.data(), line.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(line.size())) {
+            ::close(s.fd);
+            s.fd = -1;
+            --active;
+            ++errors;
+        }
+    };
+    auto nextRequest = [&](Session& s, std::size_t index) -> std::string {
+        std::string name = "load" + std::to_string(index);
+        if (!s.loggedIn) return s.step == 0 ? "signup " + name + " secret" : "login " + name + " secret";
+        if (s.step < requestsPerSession) return (s.step % 2 == 0 ? "buy SOL 0.001" : "sell SOL 0.001");
+        if (s.step == requestsPerSession) return "logout";
+        return "";
+    };
+
+    auto begin = Clock::now();
+    for (std::size_t i = 0; i < sessions; ++i) {
+        Session& s = all[i];
+        s.fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (s.fd < 0 || ::connect(s.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            std::cerr << "Error: could not connect session " << i << ": " << std::strerror(errno) << '\n';
+            if (s.fd >= 0) ::close(s.fd);
+            s.fd = -1;
+            ++errors;
+            continue;
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = i;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, s.fd, &ev);
+        ++active;
+        send(s, nextRequest(s, i));
+    }
+
+    std::vector<epoll_event> events(1024);
+    char buffer[16384];
+    while (active > 0) {
+        int ready = ::epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 10000);
+        if (ready == 0) {
+            std::cerr << "Error: timed out with " << active << " sessions waiting\n";
+            break;
+        }
+        for (int e = 0; e < ready; ++e) {
+            std::size_t index = events[e].data.u64;
+            Session& s = all[index];
+            if (s.fd < 0) continue;
+            ssize_t n = ::recv(s.fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                ::close(s.fd);
+                s.fd = -1;
+                --active;
+                ++errors;
+                continue;
+            }
+            s.in.append(buffer, static_cast<std::size_t>(n));
+
+            // Consume every complete reply; one request is in flight at a time.
+            std::size_t header;
+            while ((header = s.in.find('\n')) != std::string::npos) {
+                bool ok = s.in.compare(0, 3, "OK ") == 0;
+                std::size_t length = std::strtoul(s.in.c_str() + (ok ? 3 : 4), nullptr, 10);
+                if (s.in.size() < header + 1 + length) break;
+                s.in.erase(0, header + 1 + length);
+                latenciesUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - s.sentAt).count());
+
+                if (!s.loggedIn) {
+                    if (ok) {
+                        s.loggedIn = true;
+                        s.step = 0;
+                    } else if (s.step == 0) {
+                        s.step = 1; // already registered; log in instead
+                    } else {
+                        ++errors;
+                        s.step = requestsPerSession + 1;
                     }
+                } else {
+                    if (!ok) ++errors;
+                    ++s.step;
+                }
+                std::string request = nextRequest(s, index);
+                if (request.empty()) {
+                    ::close(s.fd);
+                    s.fd = -1;
+                    --active;
                     break;
                 }
-                case 2: {
-                    User* currentUser = auth.login();
-                    if (currentUser) {
-                        userMenu(*currentUser, ex, auth, limitManager);
-                        delete currentUser;
-                    }
-                    break;
+                send(s, request);
+                if (s.fd < 0) break;
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    ::close(epollFd);
+
+    std::cout << "Sessions " << sessions << ", requests " << latenciesUs.size() << ", errors " << errors << " in "
+              << std::fixed << std::setprecision(3) << seconds << " s, " << std::setprecision(0)
+              << (seconds > 0 ? latenciesUs.size() / seconds : 0.0) << " requests/s\n";
+    if (!latenciesUs.empty()) {
+        std::sort(latenciesUs.begin(), latenciesUs.end());
+        auto pct = [&](double q) { return latenciesUs[static_cast<std::size_t>(q * (latenciesUs.size() - 1))]; };
+        std::cout << "Request latency (us): p50 " << std::setprecision(1) << pct(0.50) << "  p99 " << pct(0.99)
+                  << "  p99.9 " << pct(0.999) << "  max " << latenciesUs.back() << "\n";
+    }
+    return errors == 0 ? 0 : 2;
+}
+#endif // __linux__
+
+struct Tick {
+    static const std::int64_t UNTIMED = -1;
+
+    std::int64_t timestampMs; // UNTIMED when the feed carries none
+    SymbolId symbol;          // SymbolRegistry::npos for an unregistered ticker
+    Fixed price;
+};
+
+// Reads a recorded price feed from a memory-mapped file in either format:
+//   CSV:    "[timestamp_ms,]SYMBOL,price" per line; lines that don't parse
+//           (headers, comments) are skipped and counted.
+//   Binary: "CTK1", uint32 symbol count, int64 base timestamp_ms, per symbol
+//           a uint8 length and the ticker, then 16-byte records of int64 raw
+//           Fixed price, uint32 symbol index and uint32 milliseconds since
+//           the previous tick (little-endian).
+// Tickers are only looked up unless the reader is opened to intern them, so
+// replaying a feed never registers symbols the exchange does not list.
+class TickReader {
+private:
+    MappedFile file;
+    const char* cursor = nullptr;
+    const char* end = nullptr;
+    bool binary = false;
+    std::vector<SymbolId> binarySymbols;
+    bool internSymbols = false;
+    std::int64_t lastTimestampMs = 0;
+    std::size_t skippedLines = 0;
+
+    SymbolId resolve(const std::string& ticker) const;
+    bool nextCsv(Tick& tick);
+    bool nextBinary(Tick& tick);
+
+public:
+    static const char MAGIC[4];
+    static const std::size_t HEADER_SIZE = 16;
+    static const std::size_t RECORD_SIZE = 16;
+
+    bool open(const std::string& path, bool intern = false);
+    bool next(Tick& tick);
+    std::size_t skipped() const;
+};
+
+const char TickReader::MAGIC[4] = {'C', 'T', 'K', '1'};
+
+bool TickReader::open(const std::string& path, bool intern) {
+    internSymbols = intern;
+    if (!file.open(path)) return false;
+    cursor = file.data();
+    end = cursor + file.size();
+    binary = file.size() >= HEADER_SIZE && std::memcmp(cursor, MAGIC, 4) == 0;
+    if (!binary) return true;
+
+    std::uint32_t count;
+    std::memcpy(&count, cursor + 4, 4);
+    std::memcpy(&lastTimestampMs, cursor + 8, 8);
+    cursor += HEADER_SIZE;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        if (cursor >= end) return false;
+        std::size_t len = static_cast<unsigned char>(*cursor++);
+        if (static_cast<std::size_t>(end - cursor) < len) return false;
+        binarySymbols.push_back(resolve(std::string(cursor, len)));
+        cursor += len;
+    }
+    return true;
+}
+
+bool TickReader::next(Tick& tick) { return binary ? nextBinary(tick) : nextCsv(tick); }
+
+SymbolId TickReader::resolve(const std::string& ticker) const {
+    return internSymbols ? SymbolRegistry::instance().intern(ticker) : SymbolRegistry::instance().lookup(ticker);
+}
+
+bool TickReader::nextBinary(Tick& tick) {
+    while (static_cast<std::size_t>(end - cursor) >= RECORD_SIZE) {
+        std::int64_t raw;
+        std::uint32_t index, deltaMs;
+        std::memcpy(&raw, cursor, 8);
+        std::memcpy(&index, cursor + 8, 4);
+        std::memcpy(&deltaMs, cursor + 12, 4);
+        cursor += RECORD_SIZE;
+        lastTimestampMs += deltaMs;
+        if (index >= binarySymbols.size()) {
+            ++skippedLines;
+            continue;
+        }
+        tick.timestampMs = lastTimestampMs;
+        tick.symbol = binarySymbols[index];
+        tick.price = Fixed::fromRaw(raw);
+        return true;
+    }
+    return false;
+}
+
+bool TickReader::nextCsv(Tick& tick) {
+    while (cursor < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+        if (!lineEnd) lineEnd = end;
+        const char* line = cursor;
+        cursor = (lineEnd < end) ? lineEnd + 1 : end;
+
+        const char* stop = lineEnd;
+        if (stop > line && stop[-1] == '\r') --stop;
+        if (stop == line) continue;
+
+        const char* fields[3];
+        const char* fieldEnds[3];
+        int count = 0;
+        const char* p = line;
+        while (count < 3) {
+            const char* comma = static_cast<const char*>(std::memchr(p, ',', stop - p));
+            fields[count] = p;
+            fieldEnds[count] = comma ? comma : stop;
+            ++count;
+            if (!comma) break;
+            p = comma + 1;
+        }
+
+        int sym = (count == 3) ? 1 : 0;
+        if (count < 2 || fieldEnds[sym] == fields[sym] ||
+            !Fixed::parse(fields[sym + 1], fieldEnds[sym + 1], tick.price)) {
+            ++skippedLines;
+            continue;
+        }
+        if (count == 3) {
+            std::int64_t ts = 0;
+            const char* d = fields[0];
+            for (; d < fieldEnds[0] && std::isdigit(static_cast<unsigned char>(*d)); ++d) ts = ts * 10 + (*d - '0');
+            if (d != fieldEnds[0] || d == fields[0]) {
+                ++skippedLines;
+                continue;
+            }
+            tick.timestampMs = ts;
+        } else {
+            tick.timestampMs = Tick::UNTIMED;
+        }
+        tick.symbol = resolve(std::string(fields[sym], fieldEnds[sym]));
+        return true;
+    }
+    return false;
+}
+
+std::size_t TickReader::skipped() const { return skippedLines; }
+
+// Rewrites any readable tick file in the compact binary format. Untimed
+// ticks stay untimed: every delta is zero from an UNTIMED base.
+bool convertTicks(const std::string& inPath, const std::string& outPath) {
+    TickReader reader;
+    if (!reader.open(inPath, true)) {
+        std::cerr << "Error: Could not open tick file " << inPath << '\n';
+        return false;
+    }
+    std::vector<Tick> ticks;
+    std::vector<std::uint32_t> indexOf;
+    std::vector<SymbolId> symbols;
+    Tick tick;
+    while (reader.next(tick)) {
+        if (tick.symbol >= indexOf.size()) indexOf.resize(tick.symbol + 1, 0xFFFFFFFFu);
+        if (indexOf[tick.symbol] == 0xFFFFFFFFu) {
+            indexOf[tick.symbol] = static_cast<std::uint32_t>(symbols.size());
+            symbols.push_back(tick.symbol);
+        }
+        ticks.push_back(tick);
+    }
+
+    std::ofstream out(outPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Error: Could not write " << outPath << '\n';
+        return false;
+    }
+    std::uint32_t count = static_cast<std::uint32_t>(symbols.size());
+    std::int64_t previousMs = ticks.empty() ? 0 : ticks.front().timestampMs;
+    out.write(TickReader::MAGIC, 4);
+    out.write(reinterpret_cast<const char*>(&count), 4);
+    out.write(reinterpret_cast<const char*>(&previousMs), 8);
+    for (SymbolId id : symbols) {
+        const std::string& name = symbolName(id);
+        unsigned char len = static_cast<unsigned char>(std::min<std::size_t>(name.size(), 255));
+        out.put(static_cast<char>(len));
+        out.write(name.data(), len);
+    }
+    // Timestamps are delta-coded; a feed that steps backwards is clamped.
+    for (const Tick& t : ticks) {
+        char record[TickReader::RECORD_SIZE];
+        std::int64_t raw = t.price.getRaw();
+        std::int64_t delta = std::max<std::int64_t>(0, std::min<std::int64_t>(t.timestampMs - previousMs, 0xFFFFFFFFll));
+        std::uint32_t deltaMs = static_cast<std::uint32_t>(delta);
+        previousMs += delta;
+        std::memcpy(record, &raw, 8);
+        std::memcpy(record + 8, &indexOf[t.symbol], 4);
+        std::memcpy(record + 12, &deltaMs, 4);
+        out.write(record, sizeof(record));
+    }
+    std::cout << "Wrote " << ticks.size() << " ticks (" << reader.skipped() << " skipped) to " << outPath << "\n";
+    return static_cast<bool>(out);
+}
+
+// Replays a tick file through setPrice and limit-order triggering. With
+// batchSize 1 every tick is followed by a trigger pass; otherwise the symbols
+// touched by a batch are checked once at its end. A tick's latency runs from
+// its decode to the end of the trigger pass that covers it. Untimed ticks
+// are stamped with the wall clock as they are applied.
+int runIngest(const std::string& path, std::size_t batchSize, bool echo,
+              Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager) {
+    using Clock = std::chrono::steady_clock;
+    TickReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Error: Could not open tick file " << path << '\n';
+        return 1;
+    }
+    if (batchSize == 0) batchSize = 1;
+
+    std::ostream& report = std::cout;
+    EventLog::instance().setEcho(echo); // fills are all these modes narrate
+
+    std::vector<double> latenciesNs;
+    std::vector<Clock::time_point> starts;
+    std::vector<SymbolId> dirty;
+    std::vector<char> isDirty;
+    std::size_t applied = 0, unknown = 0;
+    bool more = true;
+    Tick tick;
+
+    auto begin = Clock::now();
+    while (more) {
+        starts.clear();
+        while (starts.size() < batchSize && (more = reader.next(tick))) {
+            Clock::time_point started = Clock::now();
+            Crypto_currency* crypto = ex.find(tick.symbol);
+            Fixed price = crypto ? tick.price.roundTo(crypto->getTickSize()) : Fixed();
+            if (!crypto || price <= Fixed()) {
+                ++unknown;
+                continue;
+            }
+            std::int64_t timeMs = tick.timestampMs == Tick::UNTIMED ? CandleStore::nowMs() : tick.timestampMs;
+            ex.setPrice(tick.symbol, price, timeMs);
+            if (tick.symbol >= isDirty.size()) isDirty.resize(tick.symbol + 1, 0);
+            if (!isDirty[tick.symbol]) {
+                isDirty[tick.symbol] = 1;
+                dirty.push_back(tick.symbol);
+            }
+            starts.push_back(started);
+        }
+        for (SymbolId symbol : dirty) {
+            limitManager.checkAndExecuteOrders(symbol, ex, auth);
+            isDirty[symbol] = 0;
+        }
+        dirty.clear();
+        Clock::time_point finished = Clock::now();
+        for (const auto& started : starts) {
+            latenciesNs.push_back(std::chrono::duration<double, std::nano>(finished - started).count());
+        }
+        applied += starts.size();
+    }
+    EventLog::instance().flush();
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    report << "Applied " << applied << " ticks (" << unknown << " unlisted/invalid, " << reader.skipped()
+           << " unparsable) in " << std::fixed << std::setprecision(3) << seconds << " s, "
+           << std::setprecision(0) << (seconds > 0 ? applied / seconds : 0.0) << " ticks/s\n";
+    if (!latenciesNs.empty()) {
+        std::sort(latenciesNs.begin(), latenciesNs.end());
+        auto pct = [&](double q) { return latenciesNs[static_cast<std::size_t>(q * (latenciesNs.size() - 1))] / 1000.0; };
+        report << "Per-tick latency (us): p50 " << std::setprecision(2) << pct(0.50) << "  p99 " << pct(0.99)
+               << "  p99.9 " << pct(0.999) << "  max " << latenciesNs.back() / 1000.0 << "\n";
+    }
+    return 0;
+}
+
+// --- Synthetic market ---
+// Geometric Brownian motion over every listed symbol, for load-testing the
+// trigger and settlement paths. Per step of dt years each price moves by
+//   exp((drift - vol^2 / 2) dt + vol sqrt(dt) z),
+// where z = sqrt(corr) m + sqrt(1 - corr) e mixes one market-wide factor m
+// with the symbol's own shock e, giving every pair correlation `corr`.
+//
+// Shocks come from Philox4x32-10, a counter-based generator: the normals for
+// (seed, step) are a pure function of those values, so a run is reproducible
+// and any range of steps can be generated independently - and on any thread -
+// without sharing generator state.
+struct GbmConfig {
+    std::uint64_t steps = 10000;
+    double drift = 0.0;        // annualised
+    double volatility = 0.8;   // annualised
+    double correlation = 0.3;  // between every pair of symbols, in [0, 1]
+    double stepSeconds = 1.0;  // simulated time per step
+    double rate = 0.0;         // steps per wall-clock second; 0 runs flat out
+    std::uint64_t seed = 1;
+    unsigned threads = 1;      // shock generation only; prices apply in order
+
+    // "steps=100000,rate=500,drift=0.05,vol=0.9,corr=0.4,dt=1,seed=7,threads=4"
+    static bool parse(const std::string& text, GbmConfig& out, std::string& error);
+};
+
+bool GbmConfig::parse(const std::string& text, GbmConfig& out, std::string& error) {
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        std::size_t eq = item.find('=');
+        std::string key = item.substr(0, eq);
+        char* end = nullptr;
+        const char* value = eq == std::string::npos ? "" : item.c_str() + eq + 1;
+        double number = std::strtod(value, &end);
+        if (eq == std::string::npos || end == value || *end != '\0') {
+            error = "expected key=value, got '" + item + "'";
+            return false;
+        }
+        if (key == "steps" && number >= 1) out.steps = static_cast<std::uint64_t>(number);
+        else if (key == "drift") out.drift = number;
+        else if (key == "vol" && number >= 0) out.volatility = number;
+        else if (key == "corr" && number >= 0 && number <= 1) out.correlation = number;
+        else if (key == "dt" && number > 0) out.stepSeconds = number;
+        else if (key == "rate" && number >= 0) out.rate = number;
+        else if (key == "seed" && number >= 0) out.seed = static_cast<std::uint64_t>(number);
+        else if (key == "threads" && number >= 1) out.threads = static_cast<unsigned>(number);
+        else {
+            error = "bad or out-of-range setting '" + item + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Philox4x32-10 (Salmon et al., SC'11): ten rounds of multiply-xor over a
+// 128-bit counter under a 64-bit key. Runs `Lanes` counters at once, held
+// structure-of-arrays so each round is a fixed-length pass over the lanes that
+// the compiler vectorises (the 32x32->64 multiplies map to pmuludq).
+struct PhiloxBatch {
+    static constexpr std::size_t Lanes = 16;
+    alignas(64) std::uint32_t x0[Lanes];
+    alignas(64) std::uint32_t x1[Lanes];
+    alignas(64) std::uint32_t x2[Lanes];
+    alignas(64) std::uint32_t x3[Lanes];
+
+    void generate(std::uint64_t seed);
+};
+
+void PhiloxBatch::generate(std::uint64_t seed) {
+    std::uint32_t k0 = static_cast<std::uint32_t>(seed), k1 = static_cast<std::uint32_t>(seed >> 32);
+    for (int round = 0; round < 10; ++round) {
+        for (std::size_t i = 0; i < Lanes; ++i) {
+            std::uint64_t p0 = static_cast<std::uint64_t>(0xD2511F53u) * x0[i];
+            std::uint64_t p1 = static_cast<std::uint64_t>(0xCD9E8D57u) * x2[i];
+            std::uint32_t y0 = static_cast<std::uint32_t>(p1 >> 32) ^ x1[i] ^ k0;
+            std::uint32_t y2 = static_cast<std::uint32_t>(p0 >> 32) ^ x3[i] ^ k1;
+            x1[i] = static_cast<std::uint32_t>(p1);
+            x3[i] = static_cast<std::uint32_t>(p0);
+            x0[i] = y0;
+            x2[i] = y2;
+        }
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+}
+
+class PriceGenerator {
+private:
+    GbmConfig config;
+    std::vector<SymbolId> symbols;
+    std::vector<double> level; // unrounded price per symbol
+    std::size_t blocksPerStep; // Philox blocks per step; each yields 4 normals
+
+public:
+    PriceGenerator(const Exchange& ex, const GbmConfig& config);
+
+    std::size_t symbolCount() const;
+    SymbolId symbolAt(std::size_t i) const;
+
+    // Standard normals for steps [first, first + count): per step the market
+    // factor, then one per symbol. `out` holds count * (symbols + 1) values.
+    void shocks(std::uint64_t first, std::size_t count, double* out) const;
+
+    // Moves the prices through steps [first, first + count), writing each
+    // step's prices to `out` (count * symbols values, step-major).
+    void advance(std::uint64_t first, std::size_t count, std::vector<double>& out);
+};
+
+PriceGenerator::PriceGenerator(const Exchange& ex, const GbmConfig& config) : config(config) {
+    for (const auto& crypto : ex.getListings()) {
+        symbols.push_back(crypto.getId());
+        level.push_back(crypto.getPrice().toDouble());
+    }
+    blocksPerStep = (symbols.size() + 1 + 3) / 4;
+}
+
+std::size_t PriceGenerator::symbolCount() const { return symbols.size(); }
+SymbolId PriceGenerator::symbolAt(std::size_t i) const { return symbols[i]; }
+
+// Blocks are numbered step-major, (step, b) for b < blocksPerStep, and
+// generated a batch of lanes at a time; a short final batch repeats its last
+// counter in the unused lanes.
+void PriceGenerator::shocks(std::uint64_t first, std::size_t count, double* out) const {
+    const std::size_t width = symbols.size() + 1;
+    const std::size_t total = count * blocksPerStep;
+    const double twoPi = 6.283185307179586;
+    PhiloxBatch batch;
+    std::uint64_t step = first;
+    std::size_t block = 0;
+    for (std::size_t begin = 0; begin < total; begin += PhiloxBatch::Lanes) {
+        const std::size_t lanes = std::min(PhiloxBatch::Lanes, total - begin);
+        std::uint64_t laneStep = step;
+        std::size_t laneBlock = block;
+        for (std::size_t i = 0; i < PhiloxBatch::Lanes; ++i) {
+            batch.x0[i] = static_cast<std::uint32_t>(laneStep);
+            batch.x1[i] = static_cast<std::uint32_t>(laneStep >> 32);
+            batch.x2[i] = static_cast<std::uint32_t>(laneBlock);
+            batch.x3[i] = 0;
+            if (i + 1 < lanes && ++laneBlock == blocksPerStep) {
+                laneBlock = 0;
+                ++laneStep;
+            }
+        }
+        batch.generate(config.seed);
+
+        for (std::size_t i = 0; i < lanes; ++i) {
+            // Box-Muller on two pairs of uniforms in (0, 1).
+            const std::uint32_t bits[4] = {batch.x0[i], batch.x1[i], batch.x2[i], batch.x3[i]};
+            double normals[4];
+            for (int pair = 0; pair < 2; ++pair) {
+                double u1 = (bits[2 * pair] + 0.5) / 4294967296.0;
+                double u2 = (bits[2 * pair + 1] + 0.5) / 4294967296.0;
+                double radius = std::sqrt(-2.0 * std::log(u1));
+                normals[2 * pair] = radius * std::cos(twoPi * u2);
+                normals[2 * pair + 1] = radius * std::sin(twoPi * u2);
+            }
+            double* row = out + (step - first) * width;
+            for (std::size_t k = 0; k < 4 && block * 4 + k < width; ++k) row[block * 4 + k] = normals[k];
+            if (++block == blocksPerStep) {
+                block = 0;
+                ++step;
+            }
+        }
+    }
+}
+
+void PriceGenerator::advance(std::uint64_t first, std::size_t count, std::vector<double>& out) {
+    const std::size_t n = symbols.size();
+    const std::size_t width = n + 1;
+    std::vector<double> z(count * width);
+    unsigned threads = std::max(1u, std::min<unsigned>(config.threads, static_cast<unsigned>(count)));
+    if (threads == 1) {
+        shocks(first, count, z.data());
+    } else {
+        std::vector<std::thread> pool;
+        std::size_t chunk = (count + threads - 1) / threads;
+        for (std::size_t begin = 0; begin < count; begin += chunk) {
+            std::size_t len = std::min(chunk, count - begin);
+            pool.emplace_back([this, &z, first, begin, len, width]() { shocks(first + begin, len, &z[begin * width]); });
+        }
+        for (auto& thread : pool) thread.join();
+    }
+
+    const double dt = config.stepSeconds / (365.0 * 24 * 3600);
+    const double driftTerm = (config.drift - 0.5 * config.volatility * config.volatility) * dt;
+    const double diffusion = config.volatility * std::sqrt(dt);
+    const double common = std::sqrt(config.correlation);
+    const double own = std::sqrt(1.0 - config.correlation);
+    out.resize(count * n);
+    for (std::size_t s = 0; s < count; ++s) {
+        const double* row = &z[s * width];
+        double* prices = &out[s * n];
+        for (std::size_t i = 0; i < n; ++i) {
+            level[i] *= std::exp(driftTerm + diffusion * (common * row[0] + own * row[i + 1]));
+            prices[i] = level[i];
+        }
+    }
+}
+
+// Simulation mode: drives every listing from a PriceGenerator through
+// setPrice and the limit-order trigger pass, optionally paced to `rate`
+// steps per second, then reports throughput and the closing prices.
+int runSimulation(const GbmConfig& config, bool echo, Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager) {
+    using Clock = std::chrono::steady_clock;
+    std::ostream& report = std::cout;
+    EventLog::instance().setEcho(echo); // fills are all these modes narrate
+
+    PriceGenerator generator(ex, config);
+    const std::size_t n = generator.symbolCount();
+    const std::size_t batch = 1024;
+    const int tradesBefore = Exchange::totalTrades;
+    std::vector<double> prices;
+    std::size_t updates = 0;
+
+    auto begin = Clock::now();
+    for (std::uint64_t first = 0; first < config.steps; first += batch) {
+        std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(batch, config.steps - first));
+        generator.advance(first, count, prices);
+        for (std::size_t s = 0; s < count; ++s) {
+            if (config.rate > 0) {
+                std::this_thread::sleep_until(begin + std::chrono::duration_cast<Clock::duration>(
+                                                          std::chrono::duration<double>((first + s) / config.rate)));
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                SymbolId symbol = generator.symbolAt(i);
+                const Crypto_currency* crypto = ex.find(symbol);
+                Fixed price = Fixed::fromDouble(prices[s * n + i]).roundTo(crypto->getTickSize());
+                if (price <= Fixed()) price = crypto->getTickSize();
+                ex.setPrice(symbol, price);
+                limitManager.checkAndExecuteOrders(symbol, ex, auth);
+                ++updates;
+            }
+        }
+    }
+    EventLog::instance().flush();
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    report << "Simulated " << config.steps << " steps (" << updates << " price updates, "
+           << Exchange::totalTrades - tradesBefore << " fills) in " << std::fixed << std::setprecision(3) << seconds
+           << " s, " << std::setprecision(0) << (seconds > 0 ? updates / seconds : 0.0) << " updates/s\n";
+    for (std::size_t i = 0; i < n; ++i) {
+        report << "  " << symbolName(generator.symbolAt(i)) << " closed at $" << std::setprecision(2)
+               << ex.priceOf(generator.symbolAt(i)) << "\n";
+    }
+    return 0;
+}
+
+// --- Sharded engine ---
+// Each shard owns a subset of symbols (id % shards) on its own thread: their
+// listings, prices and resting limit orders, which sit in an OrderPool with a
+// TriggerBook per symbol as in LimitOrderManager. Orders reach a shard through
+// a lock-free MPSC ring. A shard settles its own fills through
+// MarketTrade::settle, under the owner's EngineLocks stripe because a user may
+// trade on several shards at once. Funds are checked there, as in
+// BuyTrade/SellTrade, so a fill without cover is rejected, and a triggered
+// limit order that cannot be covered stays resting.
+struct EngineOrder {
+    enum Type : std::uint8_t { PriceUpdate, Market, Limit };
+    Type type = Market;
+    bool isBuy = false;
+    SymbolId symbol = 0;
+    UserId user = 0;          // registered with ShardedEngine::addUser
+    std::int64_t orderId = 0; // limit orders only; positive and unique
+    Fixed units;
+    Fixed price; // new reference price, or the limit price
+};
+
+class ShardedEngine {
+private:
+    static constexpr std::uint32_t npos = 0xFFFFFFFFu;
+
+    struct Shard {
+        std::vector<Crypto_currency> listings; // this shard's symbols only
+        std::vector<std::uint32_t> slotOf;     // SymbolId -> index into listings and books
+        std::vector<TriggerBook> books;
+        OrderPool orders;
+        std::vector<OrderHandle> triggered;
+        std::vector<std::int64_t> filled; // resting orders that filled, by id
+        MpscQueue<EngineOrder> ingress;
+        std::thread worker;
+        std::uint64_t processed = 0;
+        std::uint64_t settled = 0;
+        std::uint64_t rejected = 0;
+
+        explicit Shard(std::size_t capacity) : ingress(capacity) {}
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<User*> users; // indexed by UserId
+    EngineLocks locks;
+    std::atomic<bool> stopping{false};
+    bool running = false;
+
+    Crypto_currency* listingOf(Shard& shard, SymbolId symbol);
+    void runShard(Shard& shard);
+    void process(Shard& shard, const EngineOrder& order);
+    bool settle(Shard& shard, UserId user, SymbolId symbol, bool isBuy, Fixed units, Fixed price);
+
+public:
+    ShardedEngine(const Exchange& ex, std::size_t shardCount, std::size_t queueCapacity = 1 << 16);
+    ~ShardedEngine();
+    ShardedEngine(const ShardedEngine&) = delete;
+    ShardedEngine& operator=(const ShardedEngine&) = delete;
+
+    // Before start(). The engine does not own users; resting orders are
+    // copied, and false means the symbol is not listed or the id is taken.
+    UserId addUser(User* user);
+    bool addResting(const LimitOrder& order);
+    std::size_t shardOf(SymbolId symbol) const;
+    void start();
+    bool submit(const EngineOrder& order); // any thread; false when the shard is backed up
+    void stop();                           // after the last submit: drains, settles, joins
+    void publishPrices(Exchange& ex) const;
+    std::vector<LimitOrder> resting() const;       // after stop()
+    std::vector<std::int64_t> filledOrders() const; // after stop()
+    std::uint64_t processed() const;
+    std::uint64_t settled() const;
+    std::uint64_t rejected() const;
+};
+
+ShardedEngine::ShardedEngine(const Exchange& ex, std::size_t shardCount, std::size_t queueCapacity) {
+    if (shardCount == 0) shardCount = 1;
+    for (std::size_t i = 0; i < shardCount; ++i) shards.push_back(std::make_unique<Shard>(queueCapacity));
+    for (const Crypto_currency& crypto : ex.getListings()) {
+        Shard& shard = *shards[shardOf(crypto.getId())];
+        if (crypto.getId() >= shard.slotOf.size()) shard.slotOf.resize(crypto.getId() + 1, npos);
+        shard.slotOf[crypto.getId()] = static_cast<std::uint32_t>(shard.listings.size());
+        shard.listings.push_back(crypto);
+        shard.books.emplace_back();
+        CandleStore::instance().reserve(crypto.getId());
+    }
+}
+
+ShardedEngine::~ShardedEngine() { stop(); }
+
+UserId ShardedEngine::addUser(User* user) {
+    UserId id = user->getId(); // interned here, before any shard reads it
+    if (id >= users.size()) users.resize(id + 1, nullptr);
+    users[id] = user;
+    return id;
+}
+
+bool ShardedEngine::addResting(const LimitOrder& order) {
+    Shard& shard = *shards[shardOf(order.symbol)];
+    if (!listingOf(shard, order.symbol)) return false;
+    OrderHandle handle = shard.orders.insert(
+        LimitOrder(order.orderId, order.user, order.symbol, order.units, order.desiredPrice, order.isBuy()));
+    if (handle == OrderPool::npos) return false;
+    shard.books[shard.slotOf[order.symbol]].add(shard.orders, handle);
+    return true;
+}
+
+std::size_t ShardedEngine::shardOf(SymbolId symbol) const { return symbol % shards.size(); }
+
+Crypto_currency* ShardedEngine::listingOf(Shard& shard, SymbolId symbol) {
+    if (symbol >= shard.slotOf.size() || shard.slotOf[symbol] == npos) return nullptr;
+    return &shard.listings[shard.slotOf[symbol]];
+}
+
+void ShardedEngine::start() {
+    if (running) return;
+    running = true;
+    stopping.store(false, std::memory_order_relaxed);
+    for (auto& shard : shards) {
+        Shard* s = shard.get();
+        shard->worker = std::thread([this, s] { runShard(*s); });
+    }
+}
+
+bool ShardedEngine::submit(const EngineOrder& order) {
+    return shards[shardOf(order.symbol)]->ingress.tryPush(order);
+}
+
+void ShardedEngine::stop() {
+    if (!running) return;
+    stopping.store(true, std::memory_order_release);
+    for (auto& shard : shards) shard->worker.join();
+    running = false;
+}
+
+void ShardedEngine::runShard(Shard& shard) {
+    EngineOrder order;
+    while (true) {
+        if (shard.ingress.tryPop(order)) {
+            process(shard, order);
+            ++shard.processed;
+        } else if (stopping.load(std::memory_order_acquire)) {
+            // Producers are finished once stop() is called, so one more empty
+            // pop means the ring is drained.
+            if (!shard.ingress.tryPop(order)) break;
+            process(shard, order);
+            ++shard.processed;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ShardedEngine::process(Shard& shard, const EngineOrder& order) {
+    Crypto_currency* crypto = listingOf(shard, order.symbol);
+    if (!crypto) return;
+    TriggerBook& book = shard.books[shard.slotOf[order.symbol]];
+
+    switch (order.type) {
+        case EngineOrder::PriceUpdate: {
+            Fixed price = order.price.roundTo(crypto->getTickSize());
+            if (price <= Fixed()) return;
+            crypto->setPrice(price);
+            shard.triggered.clear();
+            book.triggered(shard.orders, price, shard.triggered);
+            for (OrderHandle handle : shard.triggered) {
+                const LimitOrder& resting = shard.orders.at(handle);
+                if (!settle(shard, resting.user, resting.symbol, resting.isBuy(), resting.units, price)) continue;
+                shard.filled.push_back(resting.orderId);
+                book.remove(shard.orders, handle);
+                shard.orders.erase(handle);
+            }
+            break;
+        }
+        case EngineOrder::Market:
+            if (crypto->acceptsUnits(order.units)) {
+                settle(shard, order.user, order.symbol, order.isBuy, order.units, crypto->getPrice());
+            }
+            break;
+        case EngineOrder::Limit: {
+            if (!crypto->acceptsLimit(order.units, order.price)) return;
+            Fixed price = crypto->getPrice();
+            if ((order.isBuy ? price <= order.price : price >= order.price) &&
+                settle(shard, order.user, order.symbol, order.isBuy, order.units, price)) {
+                return;
+            }
+            OrderHandle handle = shard.orders.insert(
+                LimitOrder(order.orderId, order.user, order.symbol, order.units, order.price, order.isBuy));
+            if (handle == OrderPool::npos) {
+                ++shard.rejected;
+                return;
+            }
+            book.add(shard.orders, handle);
+            break;
+        }
+    }
+}
+
+// Runs on the shard's thread. Only the wallet is shared with other shards;
+// the symbol's trade statistics and candles belong to this shard.
+bool ShardedEngine::settle(Shard& shard, UserId user, SymbolId symbol, bool isBuy, Fixed units, Fixed price) {
+    User* owner = user < users.size() ? users[user] : nullptr;
+    if (!owner) {
+        ++shard.rejected;
+        return false;
+    }
+    Fixed value;
+    if (!Fixed::checkedMul(price, units, value)) {
+        ++shard.rejected;
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(locks.user(user));
+        bool ok = isBuy ? BuyTrade::settle(owner->getWallet(), symbol, units, value)
+                        : SellTrade::settle(owner->getWallet(), symbol, units, value);
+        if (!ok) {
+            ++shard.rejected;
+            return false;
+        }
+    }
+    if (isBuy) BuyTrade::report(*owner, symbol, units, price, value);
+    else SellTrade::report(*owner, symbol, units, price, value);
+    ++shard.settled;
+    return true;
+}
+
+void ShardedEngine::publishPrices(Exchange& ex) const {
+    for (const auto& shard : shards) {
+        for (const Crypto_currency& crypto : shard->listings) ex.setPrice(crypto.getId(), crypto.getPrice());
+    }
+}
+
+std::vector<LimitOrder> ShardedEngine::resting() const {
+    std::vector<LimitOrder> out;
+    for (const auto& shard : shards) {
+        shard->orders.forEach([&out](OrderHandle, const LimitOrder& order) { out.push_back(order); });
+    }
+    return out;
+}
+
+std::vector<std::int64_t> ShardedEngine::filledOrders() const {
+    std::vector<std::int64_t> out;
+    for (const auto& shard : shards) out.insert(out.end(), shard->filled.begin(), shard->filled.end());
+    return out;
+}
+
+std::uint64_t ShardedEngine::processed() const {
+    std::uint64_t total = 0;
+    for (auto& shard : shards) total += shard->processed;
+    return total;
+}
+
+std::uint64_t ShardedEngine::settled() const {
+    std::uint64_t total = 0;
+    for (auto& shard : shards) total += shard->settled;
+    return total;
+}
+
+std::uint64_t ShardedEngine::rejected() const {
+    std::uint64_t total = 0;
+    for (auto& shard : shards) total += shard->rejected;
+    return total;
+}
+
+// Engine mode: replays an order file through a ShardedEngine with `shards`
+// worker threads. Lines are "price <SYM> <price>",
+// "<user> buy|sell <SYM> <units>" and "<user> limit buy|sell <SYM> <units>
+// <price>". Traders must have signed up. Their wallets come from the
+// AuthManager and are saved back after the run. The LimitOrderManager's resting
+// orders trade in the engine and its book then takes the fills and the new
+// resting orders.
+int runEngine(const std::string& path, unsigned shards, Exchange& ex, AuthManager& auth,
+              LimitOrderManager& limitManager) {
+    using Clock = std::chrono::steady_clock;
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error: Could not open order file " << path << '\n';
+        return 1;
+    }
+    if (shards == 0) shards = std::max(1u, std::thread::hardware_concurrency());
+    ShardedEngine engine(ex, shards);
+
+    std::unordered_map<std::string, User*> traders;
+    auto trader = [&](const std::string& name) -> User* {
+        auto it = traders.find(name);
+        if (it != traders.end()) return it->second;
+        User* user = auth.userExists(name) ? auth.loadUserData(name) : nullptr;
+        if (user) engine.addUser(user);
+        traders.emplace(name, user);
+        return user;
+    };
+    limitManager.getOrders().forEach([&](OrderHandle, const LimitOrder& order) {
+        if (trader(order.username())) engine.addResting(order);
+    });
+
+    std::vector<EngineOrder> orders;
+    std::size_t lineNo = 0, failures = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        ++lineNo;
+        std::istringstream in(line);
+        std::string first, side, sym;
+        if (!(in >> first) || first[0] == '#') continue;
+        EngineOrder order;
+        bool ok;
+        if (first == "price") {
+            order.type = EngineOrder::PriceUpdate;
+            ok = static_cast<bool>(in >> sym >> order.price);
+        } else {
+            User* user = trader(first);
+            order.type = EngineOrder::Market;
+            if (in >> side && side == "limit") {
+                order.type = EngineOrder::Limit;
+                in >> side;
+            }
+            ok = user && (side == "buy" || side == "sell") && (in >> sym >> order.units);
+            if (ok && order.type == EngineOrder::Limit) ok = static_cast<bool>(in >> order.price);
+            if (ok) {
+                order.user = user->getId();
+                order.isBuy = side == "buy";
+                if (order.type == EngineOrder::Limit) order.orderId = limitManager.allocateOrderId();
+            }
+        }
+        order.symbol = SymbolRegistry::instance().lookup(sym);
+        if (!ok || !ex.find(order.symbol)) {
+            ++failures;
+            std::cerr << "line " << lineNo << ": skipped '" << line << "'\n";
+            continue;
+        }
+        orders.push_back(order);
+    }
+
+    const int tradesBefore = Exchange::totalTrades;
+    auto begin = Clock::now();
+    engine.start();
+    for (const EngineOrder& order : orders) {
+        while (!engine.submit(order)) std::this_thread::yield();
+    }
+    engine.stop();
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    engine.publishPrices(ex);
+    limitManager.syncResting(engine.filledOrders(), engine.resting());
+    for (auto& entry : traders) {
+        if (!entry.second) continue;
+        auth.saveUserData(*entry.second);
+        auth.releaseUser(entry.second);
+    }
+    EventLog::instance().flush();
+
+    std::cout << "Engine ran " << engine.processed() << " orders on " << shards << " shards ("
+              << Exchange::totalTrades - tradesBefore << " fills, " << engine.rejected() << " rejected, "
+              << failures << " skipped) in " << std::fixed << std::setprecision(3) << seconds << " s, "
+              << std::setprecision(0) << (seconds > 0 ? engine.processed() / seconds : 0.0) << " orders/s\n";
+    return failures == 0 ? 0 : 2;
+}
+
+// --- Backtesting ---
+// Replays a price history through independent strategy runs. Each run owns a
+// copy of the Exchange listings and an in-memory wallet, so nothing reads or
+// writes the user, wallet or order files. Resting orders follow
+// LimitOrderManager: a buy fires once the price is at or below its limit, a
+// sell at or above, the fill settles as a market trade at the triggering
+// price, and an order that cannot be covered stays resting. Workers take runs
+// off a shared counter, one run at a time.
+
+// One run. Strategy parameters, by kind:
+//   grid   <SYM> <levels> <spacing%> <units>   buys every spacing below the
+//          open price; each fill re-arms one step the other way
+//   dca    <SYM> <everyTicks> <cash>            buys `cash` worth every N ticks
+//   ladder <SYM> <rungs> <step%> <units>        buy rungs below the open; each
+//          fill arms one take-profit sell a step above, never re-armed
+struct BacktestSpec {
+    enum Kind { Grid, Dca, Ladder };
+    Kind kind;
+    SymbolId symbol;
+    Fixed params[3];
+
+    std::string describe() const;
+};
+
+struct BacktestResult {
+    std::size_t fills = 0;
+    std::size_t rejected = 0; // trigger attempts the wallet could not cover
+    Fixed cash;
+    Fixed units;
+    Fixed lastPrice;
+    Fixed equity;
+};
+
+std::string BacktestSpec::describe() const {
+    static const char* names[] = {"grid", "dca", "ladder"};
+    std::string text = std::string(names[kind]) + " " + symbolName(symbol);
+    int count = kind == Dca ? 2 : 3;
+    for (int i = 0; i < count; ++i) text += " " + params[i].toString();
+    return text;
+}
+
+class Backtester {
+private:
+    Exchange market; // listings only; each run copies it
+    Fixed startingCash;
+    std::vector<Tick> ticks;
+
+public:
+    Backtester(const Exchange& listings, Fixed startingCash);
+
+    bool load(const std::string& path);
+    std::size_t tickCount() const;
+
+    // Reads one spec per line; any numeric field may be a "lo:hi:step" sweep,
+    // and a line expands to every combination of its sweeps.
+    bool parseSpecs(std::istream& in, std::vector<BacktestSpec>& out, std::string& error) const;
+
+    BacktestResult run(const BacktestSpec& spec) const;
+    std::vector<BacktestResult> runAll(const std::vector<BacktestSpec>& specs, unsigned threads) const;
+};
+
+Backtester::Backtester(const Exchange& listings, Fixed startingCash) : startingCash(startingCash) {
+    for (const auto& crypto : listings.getListings()) market.add_crypto_listing(crypto);
+}
+
+bool Backtester::load(const std::string& path) {
+    TickReader reader;
+    if (!reader.open(path)) return false;
+    Tick tick;
+    while (reader.next(tick)) {
+        if (market.find(tick.symbol)) ticks.push_back(tick);
+    }
+    return true;
+}
+
+std::size_t Backtester::tickCount() const { return ticks.size(); }
+
+bool Backtester::parseSpecs(std::istream& in, std::vector<BacktestSpec>& out, std::string& error) const {
+    std::string line;
+    std::size_t lineNo = 0;
+    while (std::getline(in, line)) {
+        ++lineNo;
+        std::istringstream fields(line);
+        std::string kind, sym;
+        if (!(fields >> kind) || kind[0] == '#') continue;
+
+        BacktestSpec spec{};
+        if (kind == "grid") spec.kind = BacktestSpec::Grid;
+        else if (kind == "dca") spec.kind = BacktestSpec::Dca;
+        else if (kind == "ladder") spec.kind = BacktestSpec::Ladder;
+        else {
+            error = "line " + std::to_string(lineNo) + ": unknown strategy '" + kind + "'";
+            return false;
+        }
+        const Crypto_currency* crypto = (fields >> sym) ? market.find(sym) : nullptr;
+        if (!crypto) {
+            error = "line " + std::to_string(lineNo) + ": unknown symbol '" + sym + "'";
+            return false;
+        }
+        spec.symbol = crypto->getId();
+
+        // Each parameter as its list of values.
+        std::vector<Fixed> values[3];
+        int count = spec.kind == BacktestSpec::Dca ? 2 : 3;
+        for (int i = 0; i < count; ++i) {
+            std::string field;
+            Fixed lo, hi, step;
+            std::size_t colon = std::string::npos;
+            bool ok = static_cast<bool>(fields >> field);
+            if (ok && (colon = field.find(':')) == std::string::npos) {
+                ok = Fixed::parse(field, lo);
+                hi = lo;
+                step = Fixed::fromInt(1);
+            } else if (ok) {
+                std::size_t second = field.find(':', colon + 1);
+                ok = second != std::string::npos && Fixed::parse(field.substr(0, colon), lo) &&
+                     Fixed::parse(field.substr(colon + 1, second - colon - 1), hi) &&
+                     Fixed::parse(field.substr(second + 1), step) && step > Fixed() && lo <= hi;
+            }
+            if (!ok || lo <= Fixed()) {
+                error = "line " + std::to_string(lineNo) + ": parameter " + std::to_string(i + 1) +
+                        " must be a positive number or lo:hi:step";
+                return false;
+            }
+            for (Fixed v = lo; v <= hi; v += step) values[i].push_back(v);
+        }
+        for (Fixed a : values[0]) {
+            for (Fixed b : values[1]) {
+                if (count == 2) {
+                    spec.params[0] = a;
+                    spec.params[1] = b;
+                    out.push_back(spec);
+                    continue;
+                }
+                for (Fixed c : values[2]) {
+                    spec.params[0] = a;
+                    spec.params[1] = b;
+                    spec.params[2] = c;
+                    out.push_back(spec);
                 }
-                case 3: {
-                    User* newUser = auth.signUp();
-                    if (newUser) {
-                        userMenu(*newUser, ex, auth, limitManager);
-                        delete newUser;
-                    }
-                    break;
+            }
+        }
+    }
+    return true;
+}
+
+BacktestResult Backtester::run(const BacktestSpec& spec) const {
+    Exchange ex = market;
+    Crypto_currency* crypto = ex.find(spec.symbol);
+    BacktestResult result;
+    Wallet wallet(startingCash);
+    if (!crypto) return result;
+    const Fixed tick = crypto->getTickSize();
+    const Fixed lot = crypto->getLotSize();
+
+    std::multimap<Fixed, Fixed, std::greater<Fixed>> buys; // limit -> units, highest first
+    std::multimap<Fixed, Fixed> sells;                      // limit -> units, lowest first
+    std::vector<std::pair<Fixed, Fixed>> fired;
+    Fixed step;
+    std::size_t seen = 0;
+
+    auto fill = [&](bool isBuy, Fixed units, Fixed price) {
+        Fixed value;
+        bool ok = Fixed::checkedMul(price, units, value) &&
+                  (isBuy ? BuyTrade::settle(wallet, spec.symbol, units, value)
+                         : SellTrade::settle(wallet, spec.symbol, units, value));
+        ++(ok ? result.fills : result.rejected);
+        return ok;
+    };
+
+    for (const Tick& t : ticks) {
+        if (t.symbol != spec.symbol) continue;
+        Fixed price = t.price.roundTo(tick);
+        if (price <= Fixed()) continue;
+        crypto->setPrice(price);
+
+        if (seen++ == 0 && spec.kind != BacktestSpec::Dca) {
+            step = std::max(((price * spec.params[1]) / 100).roundTo(tick), tick);
+            Fixed units = spec.params[2].roundTo(lot);
+            if (units <= Fixed()) units = lot;
+            for (std::int64_t k = 1; k <= spec.params[0].getRaw() / Fixed::SCALE; ++k) {
+                Fixed limit = price - Fixed::fromRaw(step.getRaw() * k);
+                if (limit > Fixed()) buys.emplace(limit, units);
+            }
+        }
+
+        if (spec.kind == BacktestSpec::Dca) {
+            std::int64_t every = std::max<std::int64_t>(1, spec.params[0].getRaw() / Fixed::SCALE);
+            if (seen % static_cast<std::size_t>(every) != 0) continue;
+            Fixed budget = std::min(spec.params[1], wallet.getCash());
+            Fixed lotValue = price * lot;
+            std::int64_t lots = static_cast<std::int64_t>(budget.toDouble() / lotValue.toDouble());
+            while (lots > 0 && Fixed::fromRaw(lotValue.getRaw() * lots) > budget) --lots;
+            if (lots > 0) fill(true, Fixed::fromRaw(lot.getRaw() * lots), price);
+            continue;
+        }
+
+        fired.clear();
+        for (auto it = buys.begin(); it != buys.end() && it->first >= price;) {
+            if (fill(true, it->second, price)) {
+                fired.emplace_back(it->first, it->second);
+                it = buys.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (const auto& order : fired) sells.emplace(order.first + step, order.second);
+
+        fired.clear();
+        for (auto it = sells.begin(); it != sells.end() && it->first <= price;) {
+            if (fill(false, it->second, price)) {
+                fired.emplace_back(it->first, it->second);
+                it = sells.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (spec.kind == BacktestSpec::Grid) {
+            for (const auto& order : fired) {
+                if (order.first - step > Fixed()) buys.emplace(order.first - step, order.second);
+            }
+        }
+    }
+
+    result.cash = wallet.getCash();
+    result.units = wallet.getQty(spec.symbol);
+    result.lastPrice = crypto->getPrice();
+    result.equity = result.cash + result.units * result.lastPrice;
+    return result;
+}
+
+std::vector<BacktestResult> Backtester::runAll(const std::vector<BacktestSpec>& specs, unsigned threads) const {
+    std::vector<BacktestResult> results(specs.size());
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]() {
+        while (true) {
+            std::size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= specs.size()) break;
+            results[i] = run(specs[i]);
+        }
+    };
+    threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(specs.size())));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool) thread.join();
+    return results;
+}
+
+// Backtest mode: prints one line per run, then the run rate.
+int runBacktest(const std::string& ticksPath, const std::string& specsPath, unsigned threads, const Exchange& ex) {
+    std::ifstream specFile(specsPath);
+    if (!specFile) {
+        std::cerr << "Error: Could not open strategy file " << specsPath << '\n';
+        return 1;
+    }
+    Backtester backtester(ex, AuthManager::STARTING_CASH);
+    std::vector<BacktestSpec> specs;
+    std::string error;
+    if (!backtester.parseSpecs(specFile, specs, error)) {
+        std::cerr << "Error: " << specsPath << ": " << error << '\n';
+        return 1;
+    }
+    if (!backtester.load(ticksPath)) {
+        std::cerr << "Error: Could not open tick file " << ticksPath << '\n';
+        return 1;
+    }
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BacktestResult> results = backtester.runAll(specs, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::left << std::setw(6) << "run" << std::setw(40) << "strategy" << std::right << std::setw(8)
+              << "fills" << std::setw(10) << "rejected" << std::setw(16) << "equity" << std::setw(14) << "P&L" << "\n";
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        const BacktestResult& r = results[i];
+        std::cout << std::left << std::setw(6) << i + 1 << std::setw(40) << specs[i].describe() << std::right
+                  << std::setw(8) << r.fills << std::setw(10) << r.rejected << std::fixed << std::setprecision(2)
+                  << std::setw(16) << r.equity << std::setw(14) << (r.equity - AuthManager::STARTING_CASH) << "\n";
+    }
+    std::cout << "Backtested " << specs.size() << " runs over " << backtester.tickCount() << " ticks on " << threads
+              << " threads in " << std::setprecision(3) << seconds << " s\n";
+    return 0;
+}
+
+void runInteractive(Exchange& ex, AuthManager& auth, LimitOrderManager& limitManager) {
+    std::cout << "====== Crypto Trading Simulator ======\n";
+
+    while (true) {
+        EventLog::instance().flush();
+        std::cout << "\n--- Welcome ---\n"
+                  << "1. Admin Login\n"
+                  << "2. User Login\n"
+                  << "3. User Sign Up\n"
+                  << "0. Exit\n> ";
+        int choice;
+
+        if (!(std::cin >> choice)) {
+            std::cout << "Invalid input. Please enter a number.\n";
+            clearInput();
+            continue;
+        }
+
+        if (choice == 0) {
+            break;
+        }
+
+        switch(choice) {
+            case 1: {
+                std::string user, pass;
+                std::cout << "--- Admin Login ---\n";
+                std::cout << "Username: "; std::cin >> user;
+                std::cout << "Password: "; std::cin >> pass;
+                if (user == "admin" && pass == "letmein") {
+                    std::cout << "Admin login successful.\n";
+                    adminMenu(ex, auth, limitManager);
+                } else {
+                    std::cout << "Invalid admin credentials.\n";
                 }
-                default:
-                    std::cout << "Invalid choice.\n";
+                break;
+            }
+            case 2: {
+                User* currentUser = auth.login();
+                if (currentUser) {
+                    userMenu(*currentUser, ex, auth, limitManager);
+                    auth.releaseUser(currentUser);
+                }
+                break;
+            }
+            case 3: {
+                User* newUser = auth.signUp();
+                if (newUser) {
+                    userMenu(*newUser, ex, auth, limitManager);
+                    auth.releaseUser(newUser);
+                }
+                break;
+            }
+            default:
+                std::cout << "Invalid choice.\n";
+        }
+    }
+}
+
+// --- Main Application ---
+#ifndef CRYPTO_SIM_NO_MAIN
+int main(int argc, char* argv[]) {
+    const std::string snapshotPath = "state.snap";
+    std::string scriptPath, ingestPath, enginePath, eventLogPath, backtestTicks, backtestSpecs, servePath, statsPath;
+    unsigned statsInterval = 10;
+    GbmConfig simulation;
+    WalletCacheConfig walletCache;
+    bool simulate = false;
+    std::size_t batchSize = 1;
+    unsigned threads = 0;
+    bool echo = false, quiet = false, importText = false, exportText = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--script" && i + 1 < argc) scriptPath = argv[++i];
+        else if (arg == "--ingest" && i + 1 < argc) ingestPath = argv[++i];
+        else if (arg == "--batch" && i + 1 < argc) batchSize = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--engine" && i + 1 < argc) enginePath = argv[++i];
+        else if (arg == "--convert-ticks" && i + 2 < argc) return convertTicks(argv[i + 1], argv[i + 2]) ? 0 : 1;
+        else if (arg == "--import-text") importText = true;
+        else if (arg == "--export-text") exportText = true;
+        else if (arg == "--event-log" && i + 1 < argc) eventLogPath = argv[++i];
+        else if (arg == "--backtest" && i + 2 < argc) {
+            backtestTicks = argv[++i];
+            backtestSpecs = argv[++i];
+        } else if (arg == "--simulate" && i + 1 < argc) {
+            std::string error;
+            if (!GbmConfig::parse(argv[++i], simulation, error)) {
+                std::cerr << "Error: --simulate: " << error << '\n';
+                return 1;
+            }
+            simulate = true;
+        }
+#if defined(__linux__)
+        else if (arg == "--serve" && i + 1 < argc) servePath = argv[++i];
+        else if (arg == "--load-client" && i + 2 < argc) {
+            // Load options: "sessions=1000,requests=20"
+            std::size_t sessions = 1000, requests = 20;
+            std::string path = argv[++i], options = argv[++i];
+            std::sscanf(options.c_str(), "sessions=%zu,requests=%zu", &sessions, &requests);
+            return runLoadClient(path, sessions, requests);
+        }
+#endif
+        else if (arg == "--threads" && i + 1 < argc) threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--quiet") quiet = true;
+        else if (arg == "--echo") echo = true;
+        else if (arg == "--candles" && i + 1 < argc) {
+            // Candles kept per symbol at 1s,1m,1h, e.g. "3600,1440,720".
+            std::size_t perSecond = 0, perMinute = 0, perHour = 0;
+            if (std::sscanf(argv[++i], "%zu,%zu,%zu", &perSecond, &perMinute, &perHour) != 3) {
+                std::cerr << "Error: --candles expects <1s>,<1m>,<1h> capacities\n";
+                return 1;
+            }
+            CandleStore::instance().configure(perSecond, perMinute, perHour);
+        } else if (arg == "--stats-file" && i + 1 < argc) statsPath = argv[++i];
+        else if (arg == "--stats-interval" && i + 1 < argc) {
+            statsInterval = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+            if (statsInterval == 0) {
+                std::cerr << "Error: --stats-interval expects a positive number of seconds\n";
+                return 1;
+            }
+        } else if (arg == "--wallet-cache" && i + 1 < argc) {
+            if (!WalletCacheConfig::parse(argv[++i], walletCache)) {
+                std::cerr << "Error: --wallet-cache expects <MB>,<flush ms>,<pending threshold>\n";
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--script <file|->] [--ingest <ticks> [--batch N]] [--echo]\n"
+                      << "       " << argv[0] << " [--quiet] [--event-log <file>] [--candles <1s>,<1m>,<1h>]\n"
+                      << "       " << argv[0] << " [--wallet-cache <MB>,<flush ms>,<pending threshold>]\n"
+                      << "       " << argv[0] << " [--stats-file <file> [--stats-interval <seconds>]]\n"
+                      << "       " << argv[0] << " --convert-ticks <in.csv> <out.bin>\n"
+                      << "       " << argv[0] << " --import-text | --export-text\n"
+                      << "       " << argv[0] << " --backtest <ticks> <strategies> [--threads N]\n"
+                      << "       " << argv[0] << " --engine <orders> [--threads N] [--echo]\n"
+                      << "       " << argv[0] << " --simulate steps=N,rate=R,drift=D,vol=V,corr=C,dt=S,seed=K,threads=T [--echo]\n"
+                      << "       " << argv[0] << " --serve <socket> [--threads N]\n"
+                      << "       " << argv[0] << " --load-client <socket> sessions=N,requests=R\n";
+            return 1;
+        }
+    }
+
+    try {
+        // While state.snap exists it is the source of truth; wallets.db and the
+        // order journal only hold what changed since the last checkpoint.
+        StateSnapshot snapshot;
+        bool snapshotMode = snapshot.open(snapshotPath);
+        if (importText && snapshotMode) {
+            std::cerr << "Error: " << snapshotPath << " already exists; run --export-text first.\n";
+            return 1;
+        }
+        if (exportText && !snapshotMode) {
+            std::cerr << "Error: no " << snapshotPath << " to export.\n";
+            return 1;
+        }
+
+        Exchange ex;
+        if (snapshotMode) {
+            snapshot.restoreListings(ex);
+            Exchange::totalTrades = static_cast<int>(snapshot.totalTrades());
+        } else {
+            loadCryptoData(ex);
+        }
+        if (ex.isListingsEmpty()) {
+            seedExchange(ex);
+        }
+        // Backtests only read the listings; no user or order state is opened.
+        if (!backtestTicks.empty()) return runBacktest(backtestTicks, backtestSpecs, threads, ex);
+
+        AuthManager auth;
+        auth.configureCache(walletCache);
+        if (snapshotMode) auth.attachSnapshot(&snapshot);
+        LimitOrderManager limitManager(&snapshot);
+        ex.recoverBooks(auth);
+
+        if (importText) {
+            if (!checkpointState(snapshotPath, ex, auth, limitManager, nullptr)) return 1;
+            std::cout << "Imported text files and wallets.db into " << snapshotPath << ".\n";
+            return 0;
+        }
+        if (exportText) {
+            saveCryptoData(ex);
+            for (std::uint64_t i = 0; i < snapshot.userCount(); ++i) {
+                const SnapshotUser& record = snapshot.userAt(i);
+                if (auth.hasStoredWallet(snapshot.text(record.name))) continue;
+                User* user = snapshot.loadUser(record);
+                auth.saveUserData(*user);
+                delete user;
             }
+            limitManager.detachSnapshot();
+            std::filesystem::remove(snapshotPath);
+            std::cout << "Exported " << snapshotPath << " to text files and wallets.db.\n";
+            return 0;
         }
 
-        saveCryptoData(ex);
-        std::cout << "Crypto market data saved. Goodbye!\n";
+        EventLog& events = EventLog::instance();
+        events.setEcho(!quiet);
+        events.start(eventLogPath);
+        if (!statsPath.empty()) LatencyStats::instance().startDump(statsPath, std::chrono::seconds(statsInterval));
+
+        int status = 0;
+        if (!scriptPath.empty()) {
+            status = runScript(scriptPath, echo, ex, auth, limitManager);
+        } else if (!ingestPath.empty()) {
+            status = runIngest(ingestPath, batchSize, echo, ex, auth, limitManager);
+        } else if (!enginePath.empty()) {
+            events.setEcho(echo);
+            status = runEngine(enginePath, threads, ex, auth, limitManager);
+        } else if (simulate) {
+            status = runSimulation(simulation, echo, ex, auth, limitManager);
+        }
+#if defined(__linux__)
+        else if (!servePath.empty()) {
+            status = runServer(servePath, threads, ex, auth, limitManager);
+        }
+#endif
+        else {
+            runInteractive(ex, auth, limitManager);
+        }
+        ex.closeBooks(auth);
+        auth.flushWallets();
+        events.stop();
+        LatencyStats::instance().stopDump();
+
+        if (snapshotMode) {
+            if (!checkpointState(snapshotPath, ex, auth, limitManager, &snapshot)) {
+                std::cerr << "Warning: state kept in text overlay; " << snapshotPath << " not updated.\n";
+            }
+        } else {
+            saveCryptoData(ex);
+        }
+        if (scriptPath.empty() && ingestPath.empty() && enginePath.empty() && !simulate && servePath.empty()) {
+            std::cout << "Crypto market data saved. Goodbye!\n";
+        }
+        return status;
     } catch (const std::exception& e) {
         std::cerr << "A critical error occurred: " << e.what() << std::endl;
         return 1;
     }
     return 0;
-}
\ No newline at end of file
+}
+#endif // CRYPTO_SIM_NO_MAIN